@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+// Gains of the averages below, as shifts: 1/16 for the mean, and for the
+// deviation 1/4 when it grows and 1/64 when it shrinks.
+const uint8_t CADENCE_MEAN_SHIFT = 4;
+const uint8_t CADENCE_RISE_SHIFT = 2;
+const uint8_t CADENCE_FALL_SHIFT = 6;
+
+// Fixed point: values are kept in 1/16 ms.
+const uint8_t CADENCE_FRACTION = 4;
+
+// Gaps seen before the estimate is used.
+const uint8_t CADENCE_MIN_SAMPLES = 32;
+
+// Deviations above the mean, in 1/16ths, for the timeout. The mean absolute
+// deviation of a normal distribution is 0.8 sigma, so 75/16 = 4.7 of them is
+// 3.7 sigma, which one gap in 10^4 outlasts.
+const uint8_t CADENCE_DEVIATIONS_X16 = 75;
+
+/*
+ * Running estimate of the gap between tool-running codes, for the adaptive
+ * quiet timeout. This is Jacobson's estimator, which TCP uses for its
+ * retransmit timeout: an EWMA of the gap and one of its absolute deviation
+ * from that mean, giving a timeout of the mean plus a multiple of the
+ * deviation. Integer only, with no multiply or square root per sample.
+ *
+ * The deviation rises quickly and falls slowly, so a burst of lost frames
+ * lengthens the timeout at once, and a quiet spell shortens it only over a
+ * few minutes. 9 bytes.
+ */
+struct CadenceEstimator {
+  uint32_t mean = 0;        // 1/16 ms
+  uint32_t deviation = 0;   // 1/16 ms
+  uint8_t samples = 0;
+
+  void add(uint32_t gap) {
+    int32_t x = (int32_t)(gap << CADENCE_FRACTION);
+    if (samples == 0) {
+      mean = x;
+      deviation = x / 2;
+    }
+    else {
+      int32_t d = x - (int32_t)mean;
+      mean += d / (1 << CADENCE_MEAN_SHIFT);
+      int32_t a = (d < 0 ? -d : d) - (int32_t)deviation;
+      deviation += a / (1 << (a > 0 ? CADENCE_RISE_SHIFT : CADENCE_FALL_SHIFT));
+    }
+    if (samples < UINT8_MAX)
+      samples++;
+  }
+
+  // The mean plus CADENCE_DEVIATIONS_X16 / 16 deviations, within min and
+  // max; max until there have been CADENCE_MIN_SAMPLES gaps.
+  uint32_t timeout(uint32_t min, uint32_t max) const {
+    if (samples < CADENCE_MIN_SAMPLES)
+      return max;
+    uint32_t t = (mean + ((deviation * CADENCE_DEVIATIONS_X16) >> 4)) >> CADENCE_FRACTION;
+    return t < min ? min : t > max ? max : t;
+  }
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+
+// One sample of the RF receiver inputs, taken by the pin change interrupt.
+struct CodeSample {
+  uint8_t bits;
+  uint32_t time;
+};
+
+/*
+ * Single-producer/single-consumer ring buffer of input samples. The pin change
+ * ISR is the only producer and loop() the only consumer, so no locking is
+ * needed around the data: each side owns one index, the indexes are single
+ * bytes (atomic on AVR), and a slot is only published by advancing head after
+ * it has been written. When the buffer is full the new sample is dropped and
+ * counted.
+ */
+template <uint8_t SIZE>
+class CodeQueue {
+    static_assert((SIZE & (SIZE - 1)) == 0, "CodeQueue size must be a power of 2");
+
+  public:
+    // Producer side. Call from the ISR only.
+    void push(uint8_t bits, uint32_t time) {
+      uint8_t h = head;
+      if ((uint8_t)(h - tail) == SIZE) {
+        if (overflowCount != UINT16_MAX)
+          overflowCount++;
+        return;
+      }
+      volatile CodeSample &s = samples[h & (SIZE - 1)];
+      s.bits = bits;
+      s.time = time;
+      head = h + 1;
+    }
+
+    // Consumer side. Call from loop() only.
+    bool pop(CodeSample &out) {
+      uint8_t t = tail;
+      if (t == head)
+        return false;
+      volatile CodeSample &s = samples[t & (SIZE - 1)];
+      out.bits = s.bits;
+      out.time = s.time;
+      tail = t + 1;
+      return true;
+    }
+
+    bool isEmpty() const { return tail == head; }
+
+    // Samples dropped because the queue was full. Saturates.
+    uint16_t overflows() const {
+      InterruptLock lock;
+      return overflowCount;
+    }
+
+  private:
+    volatile CodeSample samples[SIZE];
+    volatile uint8_t head = 0;
+    volatile uint8_t tail = 0;
+    volatile uint16_t overflowCount = 0;
+};
@@ -1,16 +1,18 @@
 #include "codes.h"
 
-bool isValidCode(Code c) {
-    switch (c) {
-        //case Code::NONE:
-        case Code::TOOL_STARTING:
-        case Code::TOOL_RUNNING:
-        case Code::START:
-        case Code::STOP:
-        case Code::CODE_SEQ_TIMEOUT:
-        case Code::TOOL_QUIET_TIMEOUT:
-        case Code::SHUTOFF_TIMEOUT:
-            return true;
+static const Code ID_SYMBOLS[8] = {
+    Code::ID_0, Code::ID_1, Code::ID_2, Code::ID_3,
+    Code::ID_4, Code::ID_5, Code::ID_6, Code::ID_7,
+};
+
+Code idSymbol(unsigned char value) {
+    return ID_SYMBOLS[value & 0b111];
+}
+
+signed char idSymbolValue(Code c) {
+    for (signed char i = 0; i < 8; i++) {
+        if (ID_SYMBOLS[i] == c)
+            return i;
     }
-    return false;
-}
\ No newline at end of file
+    return -1;
+}
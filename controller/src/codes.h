@@ -1,3 +1,5 @@
+#pragma once
+
 
 enum class Code : unsigned char {
 
@@ -9,14 +11,81 @@ enum class Code : unsigned char {
     STOP          = 0b0010,
     BUTTON_C      = 0b0100,  // Keyfob button C
     BUTTON_D      = 0b1000,  // Keyfob button D
-    TOOL_STARTING = 0b1011,  // Tool starting to run
-    TOOL_RUNNING  = 0b1010,  // Tool continuing to run
+    TOOL_STARTING = 0b1001,  // Tool starting to run
+    TOOL_RUNNING  = 0b1011,  // Tool continuing to run
+    TOOL_STOPPED  = 0b1000,  // Tool switched off. Shares keyfob button D;
+                             // a single bit can't come from ORed collisions,
+                             // and no 4-bit code is left. Pressing D therefore
+                             // stops the collector early, as a tool would.
     MASK          = 0b1111,  
 
+    // Transmitter ID symbols, 3 bits each. A transmitter with an ID follows
+    // each STARTING, RUNNING or STOPPED code with two of these, high bits first.
+    // With at most 32 tools only ID_0 to ID_3 are ever high symbols.
+    //
+    // The multi-bit codes are placed (env:codescore) so that collisions, which
+    // reach the receiver as the OR of the codes, land on one of the codes sent
+    // or on a code that is eaten rather than on another valid code. STOPPED is
+    // within STARTING and RUNNING, and STARTING within RUNNING, so no collision
+    // of tool codes alone is misread; RUNNING ORed with a high symbol is
+    // RUNNING or 0b1111, where it used to be misread as STARTING or an ID. The
+    // complements of STARTING and RUNNING are neither keyfob nor tool codes,
+    // for complement frames.
+    ID_0          = 0b0111,
+    ID_1          = 0b1010,
+    ID_2          = 0b1101,
+    ID_3          = 0b1110,
+    ID_4          = 0b0011,
+    ID_5          = 0b0101,
+    ID_6          = 0b0110,
+    ID_7          = 0b1100,
+
     // Pseudo-codes corresponding to timer events
     CODE_SEQ_TIMEOUT   = 0b00010000, // No code received for a short interval
     TOOL_QUIET_TIMEOUT = 0b00010001, // No STARTING or RUNNING code received for a while
     SHUTOFF_TIMEOUT    = 0b00010010, // Motor has been running a long time
 };
 
-bool isValidCode(Code c);
\ No newline at end of file
+// Transmitter IDs are two ID symbols; only the low 5 bits are used.
+const unsigned char MAX_TOOLS = 32;
+
+// Codes the receiver acts on, as a bitmask indexed by code value. Codes
+// that fall outside it are eaten.
+constexpr unsigned long codeBit(Code c) { return 1UL << (unsigned char)c; }
+
+constexpr unsigned long ID_SYMBOL_CODES =
+    codeBit(Code::ID_0) | codeBit(Code::ID_1) | codeBit(Code::ID_2) | codeBit(Code::ID_3) |
+    codeBit(Code::ID_4) | codeBit(Code::ID_5) | codeBit(Code::ID_6) | codeBit(Code::ID_7);
+
+constexpr unsigned long VALID_CODES =
+    codeBit(Code::TOOL_STARTING) | codeBit(Code::TOOL_RUNNING) | codeBit(Code::TOOL_STOPPED) |
+    codeBit(Code::START) | codeBit(Code::STOP) | ID_SYMBOL_CODES |
+    codeBit(Code::CODE_SEQ_TIMEOUT) | codeBit(Code::TOOL_QUIET_TIMEOUT) |
+    codeBit(Code::SHUTOFF_TIMEOUT);
+
+// Code values run up to the last pseudo-code.
+const unsigned char CODE_COUNT = (unsigned char)Code::SHUTOFF_TIMEOUT + 1;
+
+constexpr bool isValidCode(Code c) {
+    return (unsigned char)c < CODE_COUNT && (VALID_CODES & codeBit(c)) != 0;
+}
+
+constexpr bool isIdSymbol(Code c) {
+    return (unsigned char)c < CODE_COUNT && (ID_SYMBOL_CODES & codeBit(c)) != 0;
+}
+
+// Complement frames: the codes a collision can forge (STARTING and RUNNING;
+// no OR of two different codes is a single bit) are confirmed by a second
+// frame holding their complement. The OR of two frame pairs can't pass the
+// check unless both pairs carried the same code.
+constexpr bool isComplemented(Code c) {
+    return c == Code::TOOL_STARTING || c == Code::TOOL_RUNNING;
+}
+
+constexpr Code complementOf(Code c) {
+    return (Code)(~(unsigned char)c & (unsigned char)Code::MASK);
+}
+
+// ID symbol for a 3-bit value, and the value of an ID symbol (-1 if c isn't one).
+Code idSymbol(unsigned char value);
+signed char idSymbolValue(Code c);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+// Consecutive samples a line must differ from its debounced level before it
+// changes: the 2-bit vertical counter below rolling over. At the receiver's
+// 2.048 ms tick, a glitch shorter than 3 ticks (6.1 ms) can't span 4
+// samples, so it never changes a line.
+const uint8_t DEBOUNCE_SAMPLES = 4;
+
+// Ticks the debounced lines must then go unchanged before they count as a
+// code, so lines that settle apart don't show the code half-changed: a tick
+// for lines settling a tick apart, and DEBOUNCE_SAMPLES for a one-sample
+// glitch on a line that is changing, which restarts its counter.
+const uint8_t DEBOUNCE_HOLD_TICKS = DEBOUNCE_SAMPLES + 1;
+
+// Longest from a frame starting to its code being reported, in milliseconds:
+// the first sample up to a tick late, DEBOUNCE_SAMPLES to change the lines
+// and DEBOUNCE_HOLD_TICKS to hold them, at 2.048 ms a tick, rounded up. A
+// frame shorter than this has ended by the time its code counts, with no
+// margin for a glitch restarting the hold.
+const uint8_t DEBOUNCE_LATENCY_MS = ((1 + DEBOUNCE_SAMPLES + DEBOUNCE_HOLD_TICKS) * 2048 + 999) / 1000;
+
+/*
+ * Debounces the four code inputs together, one sample per timer tick, with
+ * vertical counters: bit n of count0 and count1 is a 2-bit counter for line
+ * n, of the samples in a row that line has differed from its debounced level.
+ * A sample equal to the level clears its counter, so each line is debounced
+ * on its own, but all of them are updated with a handful of byte-wide
+ * operations and no loop over the lines. Counters start at 3 and count down;
+ * the line changes as its counter wraps from 0.
+ *
+ * The code is then the debounced lines once they have held for
+ * DEBOUNCE_HOLD_TICKS, and sample() returns true when it changes. 5 bytes.
+ */
+struct InputDebouncer {
+  uint8_t lines = 0;     // Debounced levels
+  uint8_t count0 = 0xFF; // Low and high bits of the per-line counters
+  uint8_t count1 = 0xFF;
+  uint8_t hold = 0;      // Ticks the lines have held since they last changed
+  uint8_t code = 0;      // Last code reported
+
+  bool sample(uint8_t raw) {
+    uint8_t differs = raw ^ lines;
+    count0 = ~(count0 & differs);
+    count1 = count0 ^ (count1 & differs);
+    uint8_t toggle = differs & count0 & count1;
+    if (toggle) {
+      lines ^= toggle;
+      hold = 0;
+      return false;
+    }
+    if (hold < DEBOUNCE_HOLD_TICKS)
+      hold++;
+    if (hold < DEBOUNCE_HOLD_TICKS || lines == code)
+      return false;
+    code = lines;
+    return true;
+  }
+
+  // True when a sample of raw would change nothing, nor would any after it
+  // until raw changes, so sampling can stop until then.
+  bool isSettled(uint8_t raw) const {
+    return raw == lines && count0 == 0xFF && count1 == 0xFF &&
+           hold >= DEBOUNCE_HOLD_TICKS && code == lines;
+  }
+};
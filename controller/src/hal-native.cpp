@@ -0,0 +1,110 @@
+#include "hal.h"
+
+/*
+ * Native (host) implementation of the HAL. There is no real time here: the
+ * clock only moves when the simulation advances it, so a host program can
+ * skip straight from one event to the next.
+ */
+
+static thread_local uint32_t simMillis = 0;
+static thread_local uint8_t simCodeInputs = 0;
+static thread_local bool simTrigger = false;
+static thread_local bool simOutput = false;
+static thread_local uint8_t simCodeOutputs = 0;
+
+struct SimEeprom {
+  uint8_t cells[HAL_SIM_EEPROM_SIZE];
+  uint32_t writes[HAL_SIM_EEPROM_SIZE] = {};
+  uint32_t busyUntil = 0;
+  uint16_t lastWrite = 0;
+
+  SimEeprom() {
+    for (uint8_t &c : cells)
+      c = 0xFF;
+  }
+};
+static thread_local SimEeprom simEeprom;
+
+uint32_t halMillis() {
+  return simMillis;
+}
+
+// A blocking delay simply lets simulated time pass.
+void halDelay(uint16_t ms) {
+  simMillis += ms;
+}
+
+uint8_t halReadCodeInputs() {
+  return simCodeInputs;
+}
+
+void halOutputOn() {
+  simOutput = true;
+}
+
+void halOutputOff() {
+  simOutput = false;
+}
+
+bool halReadTrigger() {
+  return simTrigger;
+}
+
+void halWriteCodeOutputs(uint8_t portBits) {
+  simCodeOutputs = portBits;
+}
+
+bool halEepromReady() {
+  return (int32_t)(simMillis - simEeprom.busyUntil) >= 0;
+}
+
+uint8_t halEepromRead(uint16_t addr) {
+  return simEeprom.cells[addr % HAL_SIM_EEPROM_SIZE];
+}
+
+void halEepromWrite(uint16_t addr, uint8_t b) {
+  addr %= HAL_SIM_EEPROM_SIZE;
+  simEeprom.cells[addr] = b;
+  simEeprom.writes[addr]++;
+  simEeprom.lastWrite = addr;
+  simEeprom.busyUntil = simMillis + HAL_SIM_EEPROM_WRITE_MS;
+}
+
+void halSimSetMillis(uint32_t ms) {
+  simMillis = ms;
+}
+
+void halSimAdvance(uint32_t ms) {
+  simMillis += ms;
+}
+
+void halSimSetCodeInputs(uint8_t bits) {
+  simCodeInputs = bits & 0b00001111;
+}
+
+void halSimSetTrigger(bool triggered) {
+  simTrigger = triggered;
+}
+
+bool halSimOutput() {
+  return simOutput;
+}
+
+uint8_t halSimCodeOutputs() {
+  return simCodeOutputs;
+}
+
+uint8_t *halSimEeprom() {
+  return simEeprom.cells;
+}
+
+const uint32_t *halSimEepromWrites() {
+  return simEeprom.writes;
+}
+
+void halSimEepromPowerCut(uint8_t garbage) {
+  if (!halEepromReady()) {
+    simEeprom.cells[simEeprom.lastWrite] = garbage;
+    simEeprom.busyUntil = simMillis;
+  }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+/*
+ * Thin hardware abstraction layer shared by the receiver and transmitter logic.
+ *
+ * On the AVR targets everything here is an inline wrapper around the port
+ * registers and the Arduino core, so the firmware compiles to the same code as
+ * when it touched the registers directly. On the native (Linux) build the same
+ * calls are backed by hal-native.cpp, where time is a simulated clock that the
+ * host program advances explicitly.
+ */
+
+#include <stdint.h>
+
+#if defined(__AVR__)
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+// Constant tables stay in flash and are read back a byte at a time.
+#define HAL_FLASH PROGMEM
+inline uint8_t halReadFlashByte(const uint8_t *p) { return pgm_read_byte(p); }
+
+#if defined(__AVR_ATtiny84__)
+// The receiver keeps its own time on Timer1, to sleep until it is needed.
+#include "rxclock.h"
+inline uint32_t halMillis() { return rxClockMillis(); }
+inline void halDelay(uint16_t ms) { rxClockDelay(ms); }
+#else
+inline uint32_t halMillis() { return millis(); }
+inline void halDelay(uint16_t ms) { delay(ms); }
+#endif
+
+// Disables interrupts for the lifetime of the object, restoring SREG after.
+class InterruptLock {
+  public:
+    InterruptLock() : sreg(SREG) { cli(); }
+    ~InterruptLock() { SREG = sreg; }
+  private:
+    uint8_t sreg;
+};
+
+// EEPROM by address. A write only starts the 3.4 ms programming cycle;
+// until halEepromReady() the next read or write would wait for it.
+inline bool halEepromReady() { return eeprom_is_ready(); }
+inline uint8_t halEepromRead(uint16_t addr) { return eeprom_read_byte((const uint8_t *)addr); }
+inline void halEepromWrite(uint16_t addr, uint8_t b) { eeprom_write_byte((uint8_t *)addr, b); }
+
+#if defined(__AVR_ATtiny84__)
+// Receiver: PA0-PA3 are the RF module outputs, PB0 drives the collector relay.
+inline uint8_t halReadCodeInputs() { return PINA & 0b00001111; }
+inline void halOutputOn() { PORTB |= _BV(PINB0); }
+inline void halOutputOff() { PORTB &= ~_BV(PINB0); }
+#endif
+
+#if defined(__AVR_ATtiny85__)
+// Transmitter: PB0 is the trigger input (active low), PB1-PB4 drive the
+// transmitter module (active low).
+inline bool halReadTrigger() { return (PINB & _BV(PINB0)) == 0; }
+inline void halWriteCodeOutputs(uint8_t portBits) { PORTB = portBits; }
+#endif
+
+#else // native
+
+#define HAL_FLASH
+inline uint8_t halReadFlashByte(const uint8_t *p) { return *p; }
+
+uint32_t halMillis();
+void halDelay(uint16_t ms);
+
+class InterruptLock {
+  public:
+    InterruptLock() {}
+};
+
+uint8_t halReadCodeInputs();
+void halOutputOn();
+void halOutputOff();
+
+bool halReadTrigger();
+void halWriteCodeOutputs(uint8_t portBits);
+
+bool halEepromReady();
+uint8_t halEepromRead(uint16_t addr);
+void halEepromWrite(uint16_t addr, uint8_t b);
+
+// Simulation controls, native only. State is per thread so independent
+// simulations can run in parallel.
+void halSimSetMillis(uint32_t ms);
+void halSimAdvance(uint32_t ms);
+void halSimSetCodeInputs(uint8_t bits);
+void halSimSetTrigger(bool triggered);
+bool halSimOutput();
+uint8_t halSimCodeOutputs();
+
+// Simulated EEPROM: erased at start, busy for HAL_SIM_EEPROM_WRITE_MS of
+// simulated time after each write, with a count of writes per cell. A power
+// cut during a write leaves that cell holding garbage.
+const uint16_t HAL_SIM_EEPROM_SIZE = 512;
+const uint32_t HAL_SIM_EEPROM_WRITE_MS = 4;
+uint8_t *halSimEeprom();
+const uint32_t *halSimEepromWrites();
+void halSimEepromPowerCut(uint8_t garbage);
+
+#endif
@@ -0,0 +1,147 @@
+#include "hvsp.h"
+
+#if defined(__AVR_ATmega328P__)
+
+void hvspBegin() {
+  DDRB |= HVSP_VCC | HVSP_RST | HVSP_SDI | HVSP_SII | HVSP_SCI | HVSP_SDO;
+  PORTB = (PORTB & ~(HVSP_VCC | HVSP_SDI | HVSP_SII | HVSP_SCI | HVSP_SDO)) | HVSP_RST;
+}
+
+// SDI, SII and SDO are held low through power-up to select HVSP, then SDO
+// becomes the target's output. Only a power-up enters HVSP mode, so a target
+// still powered from a previous session goes off first.
+void hvspEnter() {
+  if (PORTB & HVSP_VCC) {
+    hvspExit();
+    delay(HVSP_POWER_OFF_MS);
+  }
+  DDRB |= HVSP_SDO;
+  PORTB &= ~(HVSP_SDI | HVSP_SII | HVSP_SDO | HVSP_SCI);
+  PORTB |= HVSP_RST;       // 12 V off
+  PORTB |= HVSP_VCC;       // Vcc on
+  delayMicroseconds(20);
+  PORTB &= ~HVSP_RST;      // 12 V on
+  delayMicroseconds(10);
+  DDRB &= ~HVSP_SDO;
+  delayMicroseconds(300);
+}
+
+void hvspExit() {
+  PORTB &= ~(HVSP_SCI | HVSP_VCC);
+  PORTB |= HVSP_RST;
+}
+
+bool hvspReadSignature(uint16_t &sig) {
+  sig = 0;
+  for (uint8_t addr = 1; addr < 3; addr++) {
+    uint8_t val;
+    if (!hvspTransfer(HVSP_CMD_READ_SIGNATURE, HVSP_LOAD_COMMAND) ||
+        !hvspTransfer(addr, 0x0C) ||
+        !hvspTransfer(0x00, 0x68) ||
+        !hvspTransfer(0x00, 0x6C, val))
+      return false;
+    sig = (sig << 8) | val;
+  }
+  return true;
+}
+
+bool hvspReadFuse(HvspFuse fuse, uint8_t &val) {
+  return hvspTransfer(HVSP_CMD_READ_FUSE, HVSP_LOAD_COMMAND) &&
+         hvspTransfer(0x00, HVSP_READ_FUSE_INSTR[fuse][0]) &&
+         hvspTransfer(0x00, HVSP_READ_FUSE_INSTR[fuse][1], val);
+}
+
+bool hvspWriteFuse(HvspFuse fuse, uint8_t val) {
+  return hvspTransfer(HVSP_CMD_WRITE_FUSE, HVSP_LOAD_COMMAND) &&
+         hvspTransfer(val, 0x2C) &&
+         hvspTransfer(0x00, HVSP_WRITE_FUSE_INSTR[fuse][0]) &&
+         hvspTransfer(0x00, HVSP_WRITE_FUSE_INSTR[fuse][1]) &&
+         hvspWaitReady();
+}
+
+bool hvspReadLock(uint8_t &val) {
+  return hvspTransfer(HVSP_CMD_READ_FUSE, HVSP_LOAD_COMMAND) &&
+         hvspTransfer(0x00, 0x78) &&
+         hvspTransfer(0x00, 0x7C, val);
+}
+
+bool hvspChipErase() {
+  return hvspTransfer(HVSP_CMD_CHIP_ERASE, HVSP_LOAD_COMMAND) &&
+         hvspTransfer(0x00, 0x64) &&
+         hvspTransfer(0x00, 0x6C) &&
+         hvspWaitReady();
+}
+
+// Each word is loaded into the page buffer by its low address bits and
+// latched; the high address byte goes in once, before the page is written.
+bool hvspWriteFlashPage(uint16_t addr, const uint8_t *data, uint8_t words) {
+  if (!hvspTransfer(HVSP_CMD_WRITE_FLASH, HVSP_LOAD_COMMAND))
+    return false;
+  for (uint8_t i = 0; i < words; i++) {
+    if (!hvspTransfer((uint8_t)(addr + i), 0x0C) ||
+        !hvspTransfer(data[2 * i], 0x2C) ||
+        !hvspTransfer(data[2 * i + 1], 0x3C) ||
+        !hvspTransfer(0x00, 0x7D) ||
+        !hvspTransfer(0x00, 0x7C))
+      return false;
+  }
+  return hvspTransfer(addr >> 8, 0x1C) &&
+         hvspTransfer(0x00, 0x64) &&
+         hvspTransfer(0x00, 0x6C) &&
+         hvspWaitReady() &&
+         hvspTransfer(HVSP_CMD_NOP, HVSP_LOAD_COMMAND);
+}
+
+// The high address byte is only reloaded when it changes.
+bool hvspReadFlash(uint16_t addr, uint8_t *data, uint8_t words) {
+  if (!hvspTransfer(HVSP_CMD_READ_FLASH, HVSP_LOAD_COMMAND))
+    return false;
+  for (uint8_t i = 0; i < words; i++) {
+    uint16_t a = addr + i;
+    if (i == 0 || (uint8_t)a == 0) {
+      if (!hvspTransfer(a >> 8, 0x1C))
+        return false;
+    }
+    if (!hvspTransfer((uint8_t)a, 0x0C) ||
+        !hvspTransfer(0x00, 0x68) ||
+        !hvspTransfer(0x00, 0x6C, data[2 * i]) ||
+        !hvspTransfer(0x00, 0x78) ||
+        !hvspTransfer(0x00, 0x7C, data[2 * i + 1]))
+      return false;
+  }
+  return true;
+}
+
+bool hvspWriteEepromPage(uint16_t addr, const uint8_t *data, uint8_t len) {
+  if (!hvspTransfer(HVSP_CMD_WRITE_EEPROM, HVSP_LOAD_COMMAND))
+    return false;
+  for (uint8_t i = 0; i < len; i++) {
+    uint16_t a = addr + i;
+    if (!hvspTransfer((uint8_t)a, 0x0C) ||
+        !hvspTransfer(a >> 8, 0x1C) ||
+        !hvspTransfer(data[i], 0x2C) ||
+        !hvspTransfer(0x00, 0x6D) ||
+        !hvspTransfer(0x00, 0x6C))
+      return false;
+  }
+  return hvspTransfer(0x00, 0x64) &&
+         hvspTransfer(0x00, 0x6C) &&
+         hvspWaitReady() &&
+         hvspTransfer(HVSP_CMD_NOP, HVSP_LOAD_COMMAND);
+}
+
+bool hvspReadEeprom(uint16_t addr, uint8_t *data, uint8_t len) {
+  if (!hvspTransfer(HVSP_CMD_READ_EEPROM, HVSP_LOAD_COMMAND))
+    return false;
+  for (uint8_t i = 0; i < len; i++) {
+    uint16_t a = addr + i;
+    if (!hvspTransfer((uint8_t)a, 0x0C) ||
+        !hvspTransfer(a >> 8, 0x1C) ||
+        !hvspTransfer(0x00, 0x68) ||
+        !hvspTransfer(0x00, 0x6C, data[i]))
+      return false;
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#pragma once
+
+/*
+ * High-voltage serial programming (HVSP) of an ATtiny25/45/85 or 24/44/84 from
+ * an Arduino Uno, using the pins and level shifter of the fuse tools.
+ *
+ * Every line is on PORTB, so one instruction is eleven clocks of direct
+ * register writes with the pin masks known at compile time, instead of
+ * digitalWrite()/digitalRead() and their pin table lookups. SCI timing is
+ * held to the datasheet minimums (ATtiny25/45/85 and 24/44/84 "High-voltage
+ * Serial Programming Characteristics"), and the wait for the target to raise
+ * SDO before each instruction gives up after HVSP_READY_TIMEOUT_US, so a
+ * missing or dead target can't hang the programmer.
+ *
+ * Uno only.
+ */
+
+#include <stdint.h>
+
+#if defined(__AVR_ATmega328P__)
+
+#include <Arduino.h>
+
+// Arduino pins 8-13, all on PORTB.
+const uint8_t HVSP_VCC = _BV(PB0);  // Pin 8: target VCC
+const uint8_t HVSP_SDI = _BV(PB1);  // Pin 9: target data input
+const uint8_t HVSP_SII = _BV(PB2);  // Pin 10: target instruction input
+const uint8_t HVSP_SDO = _BV(PB3);  // Pin 11: target data output
+const uint8_t HVSP_SCI = _BV(PB4);  // Pin 12: target clock input
+const uint8_t HVSP_RST = _BV(PB5);  // Pin 13: 12 V on !RESET, through an inverting level shifter
+
+// Datasheet minimums, in nanoseconds.
+const uint16_t HVSP_SCI_HIGH_NS = 125;  // tSHSL
+const uint16_t HVSP_SCI_LOW_NS = 125;   // tSLSH
+const uint16_t HVSP_SETUP_NS = 50;      // tIVSH, SDI and SII valid to SCI high
+
+// Time with the target's power off before entering HVSP mode again, for its
+// supply to fall well below the power-on reset threshold.
+const uint8_t HVSP_POWER_OFF_MS = 50;
+
+// Longest the target may hold SDO low after an instruction. Chip erase is the
+// slowest at under 10 ms; anything beyond this is a fault.
+const uint32_t HVSP_READY_TIMEOUT_US = 25000;
+
+// Whole CPU cycles covering ns nanoseconds.
+constexpr uint32_t hvspCycles(uint16_t ns) {
+  return ((uint32_t)ns * (F_CPU / 1000000) + 999) / 1000;
+}
+
+constexpr uint32_t HVSP_SCI_HIGH_CYCLES = hvspCycles(HVSP_SCI_HIGH_NS);
+constexpr uint32_t HVSP_SCI_LOW_CYCLES = hvspCycles(HVSP_SCI_LOW_NS);
+constexpr uint32_t HVSP_SETUP_CYCLES = hvspCycles(HVSP_SETUP_NS);
+
+// Loading a command is an instruction with SII 0x4C; 0x00 is a no-op.
+const uint8_t HVSP_LOAD_COMMAND = 0x4C;
+const uint8_t HVSP_CMD_NOP = 0x00;
+const uint8_t HVSP_CMD_WRITE_FUSE = 0x40;
+const uint8_t HVSP_CMD_READ_SIGNATURE = 0x08;
+const uint8_t HVSP_CMD_READ_FUSE = 0x04;
+const uint8_t HVSP_CMD_CHIP_ERASE = 0x80;
+const uint8_t HVSP_CMD_WRITE_FLASH = 0x10;
+const uint8_t HVSP_CMD_READ_FLASH = 0x02;
+const uint8_t HVSP_CMD_WRITE_EEPROM = 0x11;
+const uint8_t HVSP_CMD_READ_EEPROM = 0x03;
+
+enum HvspFuse : uint8_t { HVSP_LFUSE, HVSP_HFUSE, HVSP_EFUSE, HVSP_FUSES };
+
+// Instruction pairs that finish reading and writing each fuse, in
+// HvspFuse order.
+const uint8_t HVSP_READ_FUSE_INSTR[HVSP_FUSES][2] = {
+  {0x68, 0x6C}, {0x7A, 0x7E}, {0x6A, 0x6E},
+};
+const uint8_t HVSP_WRITE_FUSE_INSTR[HVSP_FUSES][2] = {
+  {0x64, 0x6C}, {0x74, 0x7C}, {0x66, 0x6E},
+};
+
+// Wait for the target to raise SDO, ready for the next instruction. False if
+// it didn't within HVSP_READY_TIMEOUT_US.
+inline bool hvspWaitReady() {
+  if (PINB & HVSP_SDO)
+    return true;
+  uint32_t start = micros();
+  while (!(PINB & HVSP_SDO)) {
+    if (micros() - start > HVSP_READY_TIMEOUT_US)
+      return false;
+  }
+  return true;
+}
+
+// One instruction: data on SDI and the instruction on SII, each framed as a 0
+// start bit, eight bits MSB first and two 0 stop bits, with SDO read back in
+// the same frame. False if the target wasn't ready for it.
+inline bool hvspTransfer(uint8_t data, uint8_t instr, uint8_t &out) {
+  if (!hvspWaitReady())
+    return false;
+
+  uint16_t dout = (uint16_t)data << 2;
+  uint16_t iout = (uint16_t)instr << 2;
+  uint16_t in = 0;
+  uint8_t idle = PORTB & ~(HVSP_SDI | HVSP_SII | HVSP_SCI);
+  for (uint16_t bit = 1 << 10; bit != 0; bit >>= 1) {
+    uint8_t p = idle;
+    if (dout & bit)
+      p |= HVSP_SDI;
+    if (iout & bit)
+      p |= HVSP_SII;
+    PORTB = p;
+    __builtin_avr_delay_cycles(HVSP_SETUP_CYCLES);
+    in = (in << 1) | ((PINB & HVSP_SDO) ? 1 : 0);
+    PORTB = p | HVSP_SCI;
+    __builtin_avr_delay_cycles(HVSP_SCI_HIGH_CYCLES);
+    PORTB = p;
+    __builtin_avr_delay_cycles(HVSP_SCI_LOW_CYCLES);
+  }
+  out = in >> 2;
+  return true;
+}
+
+inline bool hvspTransfer(uint8_t data, uint8_t instr) {
+  uint8_t ignored;
+  return hvspTransfer(data, instr, ignored);
+}
+
+// Set up the pins with the target powered off.
+void hvspBegin();
+
+// Power the target up into HVSP mode, and back off again. Entering while
+// the target is powered turns it off first, so it always starts from a
+// power-on reset.
+void hvspEnter();
+void hvspExit();
+
+// The two-byte signature (bytes 1 and 2; byte 0 is always 0x1E).
+bool hvspReadSignature(uint16_t &sig);
+
+bool hvspReadFuse(HvspFuse fuse, uint8_t &val);
+
+// Write a fuse and wait for the write to complete.
+bool hvspWriteFuse(HvspFuse fuse, uint8_t val);
+
+bool hvspReadLock(uint8_t &val);
+
+// Erase flash, EEPROM (unless EESAVE is programmed) and the lock bits.
+bool hvspChipErase();
+
+// Program one flash page of words words, low byte first, at page-aligned
+// word address addr. Flash must have been erased.
+bool hvspWriteFlashPage(uint16_t addr, const uint8_t *data, uint8_t words);
+bool hvspReadFlash(uint16_t addr, uint8_t *data, uint8_t words);
+
+// Program one EEPROM page of len bytes at page-aligned address addr.
+bool hvspWriteEepromPage(uint16_t addr, const uint8_t *data, uint8_t len);
+bool hvspReadEeprom(uint16_t addr, uint8_t *data, uint8_t len);
+
+#endif
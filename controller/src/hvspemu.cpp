@@ -0,0 +1,357 @@
+#include "hvspemu.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+// HFUSE bit 6: EEPROM is kept through chip erase while programmed (0).
+static const uint8_t EESAVE = 0x40;
+
+void HvspTarget::chipErase() {
+  std::fill(flash.begin(), flash.end(), 0xFF & ~stuck);
+  if (fuses[1] & EESAVE)
+    std::fill(eeprom.begin(), eeprom.end(), 0xFF);
+  lock = 0xFF;
+}
+
+// The firmware's payload checks. Gang reads name a socket after the count.
+// Page writes must stay within a page of the part, pageWords of flash.
+static bool validRequest(uint8_t code, const uint8_t *p, uint8_t n, bool gang, uint8_t sockets,
+                         uint8_t pageWords) {
+  switch (code) {
+    case HVSP_WRITE_FUSE:
+      return n == 2 && p[0] < 3;
+    case HVSP_WRITE_FLASH:
+      return n >= 4 && !(n & 1) && hvspWithinPage(hvspGet16(p), (n - 2) / 2, pageWords);
+    case HVSP_WRITE_EEPROM:
+      return n >= 3 && hvspWithinPage(hvspGet16(p), n - 2, pageWords ? HVSP_EEPROM_PAGE : 0);
+    case HVSP_READ_FLASH:
+    case HVSP_READ_EEPROM: {
+      uint8_t most = code == HVSP_READ_FLASH ? HVSP_MAX_PAYLOAD / 2 : HVSP_MAX_PAYLOAD;
+      if (p[2] == 0 || p[2] > most)
+        return false;
+      return gang ? n == 4 && p[3] < sockets : n == 3;
+    }
+  }
+  return true;
+}
+
+// How long a checked request keeps the firmware busy, apart from the
+// response: its HVSP instructions and programming waits, which are the same
+// for one socket or a gang.
+double HvspEmulator::busyMicros(uint8_t code, const uint8_t *p, uint8_t n) const {
+  double instructions = 0;
+  double wait = 0;
+  switch (code) {
+    case HVSP_ENTER:
+      wait = timing.enterMicros;
+      instructions = 8;
+      break;
+    case HVSP_READ_SIGNATURE:
+      instructions = 8;
+      break;
+    case HVSP_READ_FUSES:
+      instructions = 12;
+      break;
+    case HVSP_WRITE_FUSE:
+      instructions = 7;
+      wait = timing.fuseWriteMicros;
+      break;
+    case HVSP_CHIP_ERASE:
+      instructions = 3;
+      wait = timing.eraseMicros;
+      break;
+    case HVSP_WRITE_FLASH: {
+      uint8_t words = (n - 2) / 2;
+      instructions = 5 + 5 * words + 2 + 5 * words;
+      wait = timing.flashWriteMicros;
+      break;
+    }
+    case HVSP_READ_FLASH:
+      instructions = 2 + 5 * p[2];
+      break;
+    case HVSP_WRITE_EEPROM:
+      instructions = 4 + 5 * (n - 2) + 1 + 4 * (n - 2);
+      wait = timing.eepromWriteMicros;
+      break;
+    case HVSP_READ_EEPROM:
+      instructions = 1 + 4 * p[2];
+      break;
+  }
+  return instructions * timing.instructionMicros + wait;
+}
+
+// Run a checked request on one target. Returns its status, with any data in
+// out.
+uint8_t HvspEmulator::apply(HvspTarget &target, uint8_t code, const uint8_t *p, uint8_t n, uint8_t *out, uint8_t &length) {
+  size_t flashMask = target.flash.size() - 1;
+  size_t eepromMask = target.eeprom.size() - 1;
+  length = 0;
+
+  switch (code) {
+    case HVSP_ENTER:
+    case HVSP_READ_SIGNATURE:
+      hvspPut16(out, target.part->signature);
+      length = 2;
+      break;
+
+    case HVSP_READ_FUSES:
+      memcpy(out, target.fuses, 3);
+      out[3] = target.lock;
+      length = 4;
+      break;
+
+    case HVSP_WRITE_FUSE:
+      target.fuses[p[0]] = p[1];
+      break;
+
+    case HVSP_CHIP_ERASE:
+      target.chipErase();
+      break;
+
+    case HVSP_WRITE_FLASH: {
+      size_t addr = (size_t)hvspGet16(p) * 2;
+      for (uint8_t i = 0; i < n - 2; i++)
+        target.flash[(addr + i) & flashMask] &= p[2 + i];
+      for (uint8_t i = 0; i < n - 2; i++) {
+        if (target.flash[(addr + i) & flashMask] != p[2 + i])
+          return HVSP_VERIFY_FAILED;
+      }
+      break;
+    }
+
+    case HVSP_READ_FLASH: {
+      size_t addr = (size_t)hvspGet16(p) * 2;
+      length = p[2] * 2;
+      for (uint8_t i = 0; i < length; i++)
+        out[i] = target.flash[(addr + i) & flashMask];
+      break;
+    }
+
+    case HVSP_WRITE_EEPROM: {
+      size_t addr = hvspGet16(p);
+      for (uint8_t i = 0; i < n - 2; i++)
+        target.eeprom[(addr + i) & eepromMask] = p[2 + i];
+      break;
+    }
+
+    case HVSP_READ_EEPROM: {
+      size_t addr = hvspGet16(p);
+      length = p[2];
+      for (uint8_t i = 0; i < length; i++)
+        out[i] = target.eeprom[(addr + i) & eepromMask];
+      break;
+    }
+  }
+  return HVSP_OK;
+}
+
+uint8_t HvspEmulator::execute(const HvspFrameParser &request, HvspFeed feed, uint8_t *out, double &micros) {
+  uint8_t reply[HVSP_MAX_PAYLOAD];
+  uint8_t length = 0;
+  uint8_t status = HVSP_OK;
+  uint8_t code = request.code;
+  const uint8_t *p = request.payload;
+  uint8_t n = request.length;
+  uint8_t sockets = targets.size();
+  bool gang = sockets > 1;
+  micros = 0;
+
+  if (feed == HVSP_FEED_BAD) {
+    status = HVSP_BAD_FRAME;
+  }
+  else if (code == HVSP_INFO) {
+    reply[0] = HVSP_PROTOCOL_VERSION;
+    hvspPut16(reply + 1, rxBuffer);
+    reply[3] = HVSP_MAX_PAYLOAD;
+    reply[4] = sockets;
+    length = 5;
+  }
+  else if (code == HVSP_EXIT) {
+    entered = false;
+    if (gang) {
+      memcpy(reply, socketStatus.data(), sockets);
+      length = sockets;
+    }
+  }
+  else if (code < HVSP_ENTER || code > HVSP_READ_EEPROM) {
+    status = HVSP_BAD_COMMAND;
+  }
+  else if (code != HVSP_ENTER && !entered) {
+    status = HVSP_NOT_ENTERED;
+  }
+  else if (!validRequest(code, p, n, gang, sockets, hvspFlashPageWords(targets[0].part->signature))) {
+    status = HVSP_BAD_LENGTH;
+  }
+  else {
+    // An empty socket costs a ready timeout: once for a gang, which drops
+    // it, and on every request for env:hvsp.
+    bool waited = false;
+    bool powerCycle = code == HVSP_ENTER && entered;
+    if (code == HVSP_ENTER) {
+      entered = true;
+      for (uint8_t s = 0; s < sockets; s++) {
+        socketStatus[s] = targets[s].present ? HVSP_OK : HVSP_TIMEOUT;
+        waited = waited || !targets[s].present;
+      }
+    }
+    else if (!gang) {
+      waited = !targets[0].present;
+    }
+    micros += busyMicros(code, p, n) + (waited ? timing.readyTimeoutMicros : 0) +
+              (powerCycle ? timing.powerOffMicros : 0);
+
+    if (!gang || code == HVSP_READ_FLASH || code == HVSP_READ_EEPROM) {
+      uint8_t s = gang ? p[3] : 0;
+      status = socketStatus[s];
+      if (status == HVSP_OK)
+        status = apply(targets[s], code, p, n, reply, length);
+    }
+    else {
+      // Statuses, then each socket's signature or fuses.
+      uint8_t each = code == HVSP_READ_FUSES ? 4 : code == HVSP_WRITE_FUSE || code == HVSP_CHIP_ERASE ||
+                     code == HVSP_WRITE_FLASH || code == HVSP_WRITE_EEPROM ? 0 : 2;
+      length = sockets;
+      for (uint8_t s = 0; s < sockets; s++, length += each) {
+        uint8_t *data = reply + sockets + s * each;
+        uint8_t got;
+        memset(data, 0xFF, each);
+        if (socketStatus[s] == HVSP_OK)
+          socketStatus[s] = apply(targets[s], code, p, n, data, got);
+      }
+      memcpy(reply, socketStatus.data(), sockets);
+    }
+  }
+
+  if (status != HVSP_OK)
+    length = 0;
+  uint8_t size = hvspEncode(out, request.seq, status, reply, length);
+  micros += size * 10e6 / timing.baud;
+  return size;
+}
+
+bool HvspEmulator::start(std::string &path, std::string &error) {
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    error = std::string("pty: ") + strerror(errno);
+    return false;
+  }
+  path = ptsname(master);
+
+  // Hold the slave open so the master doesn't see a hangup between clients,
+  // and make it raw so nothing is echoed or translated.
+  slave = open(path.c_str(), O_RDWR | O_NOCTTY);
+  if (slave < 0) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  struct termios t;
+  tcgetattr(slave, &t);
+  cfmakeraw(&t);
+  tcsetattr(slave, TCSANOW, &t);
+
+  running = true;
+  reader = std::thread(&HvspEmulator::readLoop, this);
+  processor = std::thread(&HvspEmulator::processLoop, this);
+  return true;
+}
+
+void HvspEmulator::stop() {
+  if (!running)
+    return;
+  running = false;
+  ready.notify_all();
+  reader.join();
+  processor.join();
+  close(slave);
+  close(master);
+  slave = master = -1;
+}
+
+// Receives bytes as the UART would: each one arrives a byte time after the
+// last, and is dropped if the receive buffer is full while the firmware is
+// busy with an earlier request.
+void HvspEmulator::readLoop() {
+  HvspFrameParser parser;
+  Clock::duration byteTime = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double, std::micro>(10e6 / timing.baud));
+  Clock::time_point lineFree = Clock::now();
+  uint8_t partial = 0;
+  uint8_t buffer[256];
+
+  while (running) {
+    struct pollfd p = {master, POLLIN, 0};
+    if (poll(&p, 1, 50) <= 0)
+      continue;
+    ssize_t got = read(master, buffer, sizeof(buffer));
+    if (got <= 0)
+      continue;
+
+    Clock::time_point now = Clock::now();
+    for (ssize_t i = 0; i < got; i++) {
+      Clock::time_point arrival = now;
+      if (paced) {
+        lineFree = (lineFree > now ? lineFree : now) + byteTime;
+        arrival = lineFree;
+      }
+
+      std::lock_guard<std::mutex> guard(lock);
+      if (paced && busy && queuedBytes + partial >= rxBuffer) {
+        overflowCount++;
+        continue;
+      }
+      partial++;
+      HvspFeed f = parser.feed(buffer[i]);
+      if (f == HVSP_FEED_MORE)
+        continue;
+      queue.push_back(Item{parser, f, partial, arrival});
+      queuedBytes += partial;
+      partial = 0;
+      ready.notify_one();
+    }
+  }
+}
+
+// Runs requests in order, taking as long as the firmware would.
+void HvspEmulator::processLoop() {
+  uint8_t frame[HVSP_MAX_FRAME];
+
+  while (running) {
+    Item item;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      ready.wait(guard, [this] { return !queue.empty() || !running; });
+      if (!running)
+        return;
+      item = queue.front();
+      queue.pop_front();
+      queuedBytes -= item.size;
+      busy = true;
+    }
+
+    if (paced)
+      std::this_thread::sleep_until(item.arrival);
+    Clock::time_point start = Clock::now();
+    double micros;
+    uint8_t size = execute(item.request, item.feed, frame, micros);
+    requestCount++;
+    if (paced)
+      std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::micro>(micros)));
+
+    for (uint8_t done = 0; done < size; ) {
+      ssize_t w = write(master, frame + done, size - done);
+      if (w <= 0)
+        break;
+      done += w;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    busy = false;
+  }
+}
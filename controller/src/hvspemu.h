@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+ * Software stand-in for the HVSP programmer (main-hvsp.cpp) with an ATtiny in
+ * its socket, served on a pseudo-terminal, so the host tools can be tested
+ * and benchmarked without hardware. Host (Linux) only.
+ *
+ * Requests are answered as the firmware would answer them, against a model
+ * of the target's memories: programming flash can only clear bits, chip
+ * erase sets flash (and EEPROM, unless EESAVE is programmed) back to 0xFF,
+ * and addresses wrap at the end of each memory. With more than one socket it
+ * is the gang programmer (main-hvspgang.cpp) instead, every request taking
+ * one pass for all the sockets; sockets can be left empty or hold a faulty
+ * part, to see the others carry on without them.
+ *
+ * When paced, the emulator also takes as long as the hardware would: bytes
+ * arrive no faster than the serial line carries them, each HVSP instruction
+ * and programming wait takes its time from HvspTiming, and bytes that arrive
+ * while the firmware's receive buffer is full are dropped, as the UART would
+ * drop them. Throughput measured against it is then an estimate of the real
+ * thing, and a host that overruns the window finds out.
+ */
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hvspproto.h"
+#include "hvsphost.h"
+
+struct HvspTiming {
+  double baud = HVSP_BAUD;
+  double instructionMicros = 12;     // One hvspTransfer() on a 16 MHz Uno
+  double enterMicros = 330;          // hvspEnter()
+  double powerOffMicros = 50000;     // HVSP_POWER_OFF_MS, entering while entered
+  double flashWriteMicros = 4500;    // tWD_FLASH
+  double eepromWriteMicros = 4000;   // tWD_EEPROM
+  double eraseMicros = 9000;         // tWD_ERASE
+  double fuseWriteMicros = 4500;     // tWD_FUSE
+  double readyTimeoutMicros = 25000; // HVSP_READY_TIMEOUT_US, for an empty socket
+};
+
+struct HvspTarget {
+  const HvspPart *part;
+  std::vector<uint8_t> flash;
+  std::vector<uint8_t> eeprom;
+  uint8_t fuses[3] = {0x62, 0xDF, 0xFF};  // Factory settings
+  uint8_t lock = 0xFF;
+  bool present = true;   // False for an empty socket, which never answers
+  uint8_t stuck = 0;     // Flash bits that read 0 whatever is written
+
+  explicit HvspTarget(const HvspPart &p)
+    : part(&p), flash(p.flashSize, 0xFF), eeprom(p.eepromSize, 0xFF) {}
+
+  void chipErase();
+};
+
+class HvspEmulator {
+  public:
+    HvspEmulator(const HvspPart &part, uint8_t sockets = 1)
+      : targets(sockets, HvspTarget(part)), socketStatus(sockets, HVSP_OK) {}
+    ~HvspEmulator() { stop(); }
+
+    // One per socket; a single socket is env:hvsp.
+    std::vector<HvspTarget> targets;
+    HvspTiming timing;
+    bool paced = true;
+    uint16_t rxBuffer = 512;   // SERIAL_RX_BUFFER_SIZE in env:hvsp
+
+    // Run one request as the firmware does. Writes the response frame to out
+    // and returns its size; micros is how long the firmware would be busy.
+    uint8_t execute(const HvspFrameParser &request, HvspFeed feed, uint8_t *out, double &micros);
+
+    // Open a pty and serve it from two threads until stop(). path is the
+    // device for the client to open.
+    bool start(std::string &path, std::string &error);
+    void stop();
+
+    uint64_t requests() const { return requestCount; }
+    uint64_t overflows() const { return overflowCount; }
+
+  private:
+    bool entered = false;
+    std::vector<uint8_t> socketStatus;
+
+    double busyMicros(uint8_t code, const uint8_t *p, uint8_t n) const;
+    uint8_t apply(HvspTarget &target, uint8_t code, const uint8_t *p, uint8_t n, uint8_t *out, uint8_t &length);
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Item {
+      HvspFrameParser request;
+      HvspFeed feed;
+      uint8_t size;
+      Clock::time_point arrival;
+    };
+
+    int master = -1;
+    int slave = -1;
+    std::atomic<bool> running{false};
+    std::thread reader;
+    std::thread processor;
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<Item> queue;
+    size_t queuedBytes = 0;
+    bool busy = false;
+    std::atomic<uint64_t> requestCount{0};
+    std::atomic<uint64_t> overflowCount{0};
+
+    void readLoop();
+    void processLoop();
+};
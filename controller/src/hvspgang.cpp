@@ -0,0 +1,163 @@
+#include "hvspgang.h"
+
+#if defined(__AVR_ATmega328P__)
+
+uint8_t hvspGangActive = 0;
+
+void hvspGangBegin() {
+  hvspBegin();
+  DDRC |= HVSP_GANG_SDO;
+  PORTC &= ~HVSP_GANG_SDO;
+}
+
+// As hvspEnter(), with every socket's SDO held low through power-up.
+void hvspGangEnter() {
+  if (PORTB & HVSP_VCC) {
+    hvspExit();
+    delay(HVSP_POWER_OFF_MS);
+  }
+  DDRC |= HVSP_GANG_SDO;
+  PORTC &= ~HVSP_GANG_SDO;
+  PORTB &= ~(HVSP_SDI | HVSP_SII | HVSP_SCI);
+  PORTB |= HVSP_RST;       // 12 V off
+  PORTB |= HVSP_VCC;       // Vcc on
+  delayMicroseconds(20);
+  PORTB &= ~HVSP_RST;      // 12 V on
+  delayMicroseconds(10);
+  DDRC &= ~HVSP_GANG_SDO;
+  delayMicroseconds(300);
+  hvspGangActive = HVSP_GANG_SDO;
+}
+
+void hvspGangExit() {
+  hvspExit();
+  hvspGangActive = 0;
+}
+
+bool hvspGangReadSignature(uint16_t *sig) {
+  HvspGangByte b[2];
+  for (uint8_t addr = 1; addr < 3; addr++) {
+    if (!hvspGangTransfer(HVSP_CMD_READ_SIGNATURE, HVSP_LOAD_COMMAND) ||
+        !hvspGangTransfer(addr, 0x0C) ||
+        !hvspGangTransfer(0x00, 0x68) ||
+        !hvspGangTransfer(0x00, 0x6C, &b[addr - 1]))
+      return false;
+  }
+  for (uint8_t n = 0; n < HVSP_GANG_SOCKETS; n++)
+    sig[n] = (b[0].socket(n) << 8) | b[1].socket(n);
+  return true;
+}
+
+bool hvspGangReadFuse(HvspFuse fuse, uint8_t *val) {
+  HvspGangByte b;
+  if (!hvspGangTransfer(HVSP_CMD_READ_FUSE, HVSP_LOAD_COMMAND) ||
+      !hvspGangTransfer(0x00, HVSP_READ_FUSE_INSTR[fuse][0]) ||
+      !hvspGangTransfer(0x00, HVSP_READ_FUSE_INSTR[fuse][1], &b))
+    return false;
+  for (uint8_t n = 0; n < HVSP_GANG_SOCKETS; n++)
+    val[n] = b.socket(n);
+  return true;
+}
+
+bool hvspGangReadLock(uint8_t *val) {
+  HvspGangByte b;
+  if (!hvspGangTransfer(HVSP_CMD_READ_FUSE, HVSP_LOAD_COMMAND) ||
+      !hvspGangTransfer(0x00, 0x78) ||
+      !hvspGangTransfer(0x00, 0x7C, &b))
+    return false;
+  for (uint8_t n = 0; n < HVSP_GANG_SOCKETS; n++)
+    val[n] = b.socket(n);
+  return true;
+}
+
+bool hvspGangWriteFuse(HvspFuse fuse, uint8_t val) {
+  return hvspGangTransfer(HVSP_CMD_WRITE_FUSE, HVSP_LOAD_COMMAND) &&
+         hvspGangTransfer(val, 0x2C) &&
+         hvspGangTransfer(0x00, HVSP_WRITE_FUSE_INSTR[fuse][0]) &&
+         hvspGangTransfer(0x00, HVSP_WRITE_FUSE_INSTR[fuse][1]) &&
+         hvspGangWaitReady();
+}
+
+bool hvspGangChipErase() {
+  return hvspGangTransfer(HVSP_CMD_CHIP_ERASE, HVSP_LOAD_COMMAND) &&
+         hvspGangTransfer(0x00, 0x64) &&
+         hvspGangTransfer(0x00, 0x6C) &&
+         hvspGangWaitReady();
+}
+
+// The sequences below are hvsp.cpp's, instruction for instruction.
+bool hvspGangWriteFlashPage(uint16_t addr, const uint8_t *data, uint8_t words) {
+  if (!hvspGangTransfer(HVSP_CMD_WRITE_FLASH, HVSP_LOAD_COMMAND))
+    return false;
+  for (uint8_t i = 0; i < words; i++) {
+    if (!hvspGangTransfer((uint8_t)(addr + i), 0x0C) ||
+        !hvspGangTransfer(data[2 * i], 0x2C) ||
+        !hvspGangTransfer(data[2 * i + 1], 0x3C) ||
+        !hvspGangTransfer(0x00, 0x7D) ||
+        !hvspGangTransfer(0x00, 0x7C))
+      return false;
+  }
+  return hvspGangTransfer(addr >> 8, 0x1C) &&
+         hvspGangTransfer(0x00, 0x64) &&
+         hvspGangTransfer(0x00, 0x6C) &&
+         hvspGangWaitReady() &&
+         hvspGangTransfer(HVSP_CMD_NOP, HVSP_LOAD_COMMAND);
+}
+
+bool hvspGangReadFlash(uint16_t addr, uint8_t words, HvspGangRead &read) {
+  if (!hvspGangTransfer(HVSP_CMD_READ_FLASH, HVSP_LOAD_COMMAND))
+    return false;
+  HvspGangByte lo, hi;
+  for (uint8_t i = 0; i < words; i++) {
+    uint16_t a = addr + i;
+    if (i == 0 || (uint8_t)a == 0) {
+      if (!hvspGangTransfer(a >> 8, 0x1C))
+        return false;
+    }
+    if (!hvspGangTransfer((uint8_t)a, 0x0C) ||
+        !hvspGangTransfer(0x00, 0x68) ||
+        !hvspGangTransfer(0x00, 0x6C, &lo) ||
+        !hvspGangTransfer(0x00, 0x78) ||
+        !hvspGangTransfer(0x00, 0x7C, &hi))
+      return false;
+    read.take(lo, 2 * i);
+    read.take(hi, 2 * i + 1);
+  }
+  return true;
+}
+
+bool hvspGangWriteEepromPage(uint16_t addr, const uint8_t *data, uint8_t len) {
+  if (!hvspGangTransfer(HVSP_CMD_WRITE_EEPROM, HVSP_LOAD_COMMAND))
+    return false;
+  for (uint8_t i = 0; i < len; i++) {
+    uint16_t a = addr + i;
+    if (!hvspGangTransfer((uint8_t)a, 0x0C) ||
+        !hvspGangTransfer(a >> 8, 0x1C) ||
+        !hvspGangTransfer(data[i], 0x2C) ||
+        !hvspGangTransfer(0x00, 0x6D) ||
+        !hvspGangTransfer(0x00, 0x6C))
+      return false;
+  }
+  return hvspGangTransfer(0x00, 0x64) &&
+         hvspGangTransfer(0x00, 0x6C) &&
+         hvspGangWaitReady() &&
+         hvspGangTransfer(HVSP_CMD_NOP, HVSP_LOAD_COMMAND);
+}
+
+bool hvspGangReadEeprom(uint16_t addr, uint8_t len, HvspGangRead &read) {
+  if (!hvspGangTransfer(HVSP_CMD_READ_EEPROM, HVSP_LOAD_COMMAND))
+    return false;
+  HvspGangByte b;
+  for (uint8_t i = 0; i < len; i++) {
+    uint16_t a = addr + i;
+    if (!hvspGangTransfer((uint8_t)a, 0x0C) ||
+        !hvspGangTransfer(a >> 8, 0x1C) ||
+        !hvspGangTransfer(0x00, 0x68) ||
+        !hvspGangTransfer(0x00, 0x6C, &b))
+      return false;
+    read.take(b, i);
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,149 @@
+#pragma once
+
+/*
+ * Gang HVSP: the same instruction stream clocked into several ATtiny targets
+ * at once, in lockstep, from an Arduino Uno.
+ *
+ * SDI, SII, SCI, VCC and 12 V on !RESET are shared by every socket and stay
+ * on PORTB where hvsp.h has them (PB3, the single-target SDO, is unused).
+ * Each socket's SDO has its own pin on PORTC, socket n on PCn (A0-A5), so one
+ * PINC read samples every target: the ready wait is a single compare against
+ * the mask of sockets in play, and a data bit from every target lands in one
+ * byte. Reads are kept in that bit-sliced form (HvspGangByte), so verifying
+ * against expected data is a few XORs per byte whatever the socket count,
+ * and only a byte asked for by socket is unpacked.
+ *
+ * Each SDO line has a pull-down, so an empty socket never raises SDO. A
+ * socket that misses the ready wait (HVSP_READY_TIMEOUT_US, from hvsp.h) is
+ * dropped from hvspGangActive and the others carry on without it; the
+ * programming functions return false only when no socket is left.
+ *
+ * Uno only.
+ */
+
+#include <stdint.h>
+
+#if defined(__AVR_ATmega328P__)
+
+#include <Arduino.h>
+#include "hvsp.h"
+
+// Sockets wired on the board, at most one per PORTC pin.
+#ifndef HVSP_GANG_SOCKETS
+#define HVSP_GANG_SOCKETS 6
+#endif
+
+const uint8_t HVSP_GANG_MAX = 6;
+static_assert(HVSP_GANG_SOCKETS >= 1 && HVSP_GANG_SOCKETS <= HVSP_GANG_MAX,
+              "One socket per PORTC pin PC0-PC5");
+const uint8_t HVSP_GANG_SDO = (1 << HVSP_GANG_SOCKETS) - 1;
+
+// Sockets still being programmed, as PORTC bits. Set by hvspGangEnter().
+extern uint8_t hvspGangActive;
+
+// One byte read from every socket: bit n of bits[i] is bit 7 - i of socket
+// n's byte.
+struct HvspGangByte {
+  uint8_t bits[8];
+
+  uint8_t socket(uint8_t n) const {
+    uint8_t v = 0;
+    for (uint8_t i = 0; i < 8; i++)
+      v = (v << 1) | ((bits[i] >> n) & 1);
+    return v;
+  }
+
+  // Sockets whose byte isn't expected.
+  uint8_t mismatch(uint8_t expected) const {
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < 8; i++, expected <<= 1)
+      diff |= bits[i] ^ ((expected & 0x80) ? 0xFF : 0x00);
+    return diff & HVSP_GANG_SDO;
+  }
+};
+
+// Wait for every active socket to raise SDO. Those that haven't within
+// HVSP_READY_TIMEOUT_US are dropped; false if none is left.
+inline bool hvspGangWaitReady() {
+  uint8_t mask = hvspGangActive;
+  if ((PINC & mask) == mask)
+    return mask != 0;
+  uint32_t start = micros();
+  while ((PINC & mask) != mask) {
+    if (micros() - start > HVSP_READY_TIMEOUT_US) {
+      hvspGangActive = mask & PINC;
+      break;
+    }
+  }
+  return hvspGangActive != 0;
+}
+
+// One instruction into every active socket, framed as in hvspTransfer(), with
+// all the SDOs sampled in the same frame into out when it's given.
+inline bool hvspGangTransfer(uint8_t data, uint8_t instr, HvspGangByte *out = NULL) {
+  if (!hvspGangWaitReady())
+    return false;
+
+  uint16_t dout = (uint16_t)data << 2;
+  uint16_t iout = (uint16_t)instr << 2;
+  uint8_t samples[11];
+  uint8_t k = 0;
+  uint8_t idle = PORTB & ~(HVSP_SDI | HVSP_SII | HVSP_SCI);
+  for (uint16_t bit = 1 << 10; bit != 0; bit >>= 1) {
+    uint8_t p = idle;
+    if (dout & bit)
+      p |= HVSP_SDI;
+    if (iout & bit)
+      p |= HVSP_SII;
+    PORTB = p;
+    __builtin_avr_delay_cycles(HVSP_SETUP_CYCLES);
+    samples[k++] = PINC;
+    PORTB = p | HVSP_SCI;
+    __builtin_avr_delay_cycles(HVSP_SCI_HIGH_CYCLES);
+    PORTB = p;
+    __builtin_avr_delay_cycles(HVSP_SCI_LOW_CYCLES);
+  }
+  if (out)
+    memcpy(out->bits, samples + 1, 8);   // After the start bit
+  return true;
+}
+
+// Where the bytes of a gang read go: one socket's into data, and every
+// socket's compared with expect, the sockets that differ collected in bad.
+// Either may be left out.
+struct HvspGangRead {
+  uint8_t socket = 0;
+  uint8_t *data = NULL;
+  const uint8_t *expect = NULL;
+  uint8_t bad = 0;
+
+  void take(const HvspGangByte &b, uint8_t i) {
+    if (data)
+      data[i] = b.socket(socket);
+    if (expect)
+      bad |= b.mismatch(expect[i]);
+  }
+};
+
+// Set up the shared pins as hvspBegin() does, with every SDO held low.
+void hvspGangBegin();
+
+// Power every socket up into HVSP mode together and make them all active.
+void hvspGangEnter();
+void hvspGangExit();
+
+// Per-socket results are indexed by socket; dropped sockets' are garbage.
+bool hvspGangReadSignature(uint16_t *sig);
+bool hvspGangReadFuse(HvspFuse fuse, uint8_t *val);
+bool hvspGangReadLock(uint8_t *val);
+
+// The same value, erase or page goes to every active socket.
+bool hvspGangWriteFuse(HvspFuse fuse, uint8_t val);
+bool hvspGangChipErase();
+bool hvspGangWriteFlashPage(uint16_t addr, const uint8_t *data, uint8_t words);
+bool hvspGangWriteEepromPage(uint16_t addr, const uint8_t *data, uint8_t len);
+
+bool hvspGangReadFlash(uint16_t addr, uint8_t words, HvspGangRead &read);
+bool hvspGangReadEeprom(uint16_t addr, uint8_t len, HvspGangRead &read);
+
+#endif
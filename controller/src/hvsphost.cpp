@@ -0,0 +1,165 @@
+#include "hvsphost.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+const HvspPart HVSP_PARTS[] = {
+  {"attiny24", 0x910B, 2048, 32, 128, 4},
+  {"attiny25", 0x9108, 2048, 32, 128, 4},
+  {"attiny44", 0x9207, 4096, 64, 256, 4},
+  {"attiny45", 0x9206, 4096, 64, 256, 4},
+  {"attiny84", 0x930C, 8192, 64, 512, 4},
+  {"attiny85", 0x930B, 8192, 64, 512, 4},
+};
+const unsigned HVSP_PART_COUNT = sizeof(HVSP_PARTS) / sizeof(HVSP_PARTS[0]);
+
+const HvspPart *hvspFindPart(uint16_t signature) {
+  for (const HvspPart &p : HVSP_PARTS)
+    if (p.signature == signature)
+      return &p;
+  return NULL;
+}
+
+const HvspPart *hvspFindPart(const char *name) {
+  for (const HvspPart &p : HVSP_PARTS)
+    if (strcasecmp(p.name, name) == 0)
+      return &p;
+  return NULL;
+}
+
+const char *hvspStatusName(uint8_t status) {
+  static const char *const names[] = {
+    "ok", "bad frame", "bad command", "bad length", "not entered", "timeout", "verify failed",
+  };
+  return status < sizeof(names) / sizeof(names[0]) ? names[status] : "unknown status";
+}
+
+HvspClient::~HvspClient() {
+  if (fd >= 0)
+    close(fd);
+}
+
+bool HvspClient::open(const char *path, std::string &err) {
+  fd = ::open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    err = std::string(path) + ": " + strerror(errno);
+    return false;
+  }
+
+  struct termios t;
+  if (tcgetattr(fd, &t) == 0) {
+    cfmakeraw(&t);
+    cfsetispeed(&t, B500000);
+    cfsetospeed(&t, B500000);
+    t.c_cflag |= CLOCAL | CREAD;
+    tcsetattr(fd, TCSANOW, &t);
+    tcflush(fd, TCIOFLUSH);
+  }
+  static_assert(HVSP_BAUD == 500000, "Termios speed follows HVSP_BAUD");
+  return true;
+}
+
+bool HvspClient::send(uint8_t code, const uint8_t *payload, uint8_t length) {
+  uint8_t size = length + HVSP_FRAME_OVERHEAD;
+  while (!sent.empty() && outstanding + size > window) {
+    HvspResponse r;
+    if (!readResponse(r))
+      return false;
+    early.push_back(r);
+  }
+
+  uint8_t frame[HVSP_MAX_FRAME];
+  uint8_t seq = nextSeq++;
+  uint8_t n = hvspEncode(frame, seq, code, payload, length);
+  for (uint8_t done = 0; done < n; ) {
+    ssize_t w = write(fd, frame + done, n - done);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      error = std::string("write: ") + strerror(errno);
+      return false;
+    }
+    done += w;
+  }
+  sent.push_back(Sent{seq, size});
+  outstanding += size;
+  return true;
+}
+
+bool HvspClient::receive(HvspResponse &r) {
+  if (!early.empty()) {
+    r = early.front();
+    early.pop_front();
+    return true;
+  }
+  return readResponse(r);
+}
+
+bool HvspClient::transact(uint8_t code, const uint8_t *payload, uint8_t length, HvspResponse &r) {
+  if (!send(code, payload, length))
+    return false;
+  while (pending() > 0 || !early.empty()) {
+    if (!receive(r))
+      return false;
+  }
+  return true;
+}
+
+// Read until a whole frame arrives, and match it to the oldest request.
+bool HvspClient::readResponse(HvspResponse &r) {
+  if (sent.empty()) {
+    error = "no request outstanding";
+    return false;
+  }
+
+  for (;;) {
+    while (rxPos < rxLength) {
+      HvspFeed f = parser.feed(rx[rxPos++]);
+      if (f == HVSP_FEED_MORE)
+        continue;
+
+      Sent s = sent.front();
+      sent.pop_front();
+      outstanding -= s.size;
+      if (f == HVSP_FEED_BAD) {
+        error = "corrupt response";
+        return false;
+      }
+      if (parser.seq != s.seq) {
+        error = "response out of sequence";
+        return false;
+      }
+      r.seq = parser.seq;
+      r.status = parser.code;
+      r.length = parser.length;
+      memcpy(r.payload, parser.payload, parser.length);
+      return true;
+    }
+
+    struct pollfd p = {fd, POLLIN, 0};
+    int n = poll(&p, 1, timeoutMs);
+    if (n == 0) {
+      error = "timed out waiting for the programmer";
+      return false;
+    }
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      error = std::string("poll: ") + strerror(errno);
+      return false;
+    }
+    ssize_t got = read(fd, rx, sizeof(rx));
+    if (got <= 0) {
+      if (got < 0 && errno == EINTR)
+        continue;
+      error = got == 0 ? "programmer closed the connection" : std::string("read: ") + strerror(errno);
+      return false;
+    }
+    rxLength = got;
+    rxPos = 0;
+  }
+}
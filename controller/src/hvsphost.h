@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+ * Host (Linux) side of the HVSP programmer protocol in hvspproto.h: the parts
+ * the programmer handles, and a client that keeps several requests in flight
+ * on the serial port.
+ */
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+
+#include "hvspproto.h"
+
+struct HvspPart {
+  const char *name;
+  uint16_t signature;   // Signature bytes 1 and 2
+  uint16_t flashSize;   // Bytes
+  uint8_t flashPage;    // Bytes
+  uint16_t eepromSize;
+  uint8_t eepromPage;
+};
+
+extern const HvspPart HVSP_PARTS[];
+extern const unsigned HVSP_PART_COUNT;
+
+const HvspPart *hvspFindPart(uint16_t signature);
+const HvspPart *hvspFindPart(const char *name);
+
+const char *hvspStatusName(uint8_t status);
+
+struct HvspResponse {
+  uint8_t seq;
+  uint8_t status;
+  uint8_t length;
+  uint8_t payload[HVSP_MAX_PAYLOAD];
+};
+
+/*
+ * Requests go out as soon as the programmer has room for them: the client
+ * tracks the bytes of requests not yet answered and only waits for a
+ * response when the next request would take that past the window. Responses
+ * come back in request order, and receive() checks each against the request
+ * it answers.
+ */
+class HvspClient {
+  public:
+    ~HvspClient();
+
+    // Open a serial port (or pty) at HVSP_BAUD, raw.
+    bool open(const char *path, std::string &error);
+
+    // Bytes of requests that may be outstanding. At least one frame is
+    // always allowed, which makes the smallest window one request at a time.
+    void setWindow(uint16_t bytes) { window = bytes; }
+
+    // Send a request, first receiving responses until it fits the window.
+    // Those go to the queue read by receive().
+    bool send(uint8_t code, const uint8_t *payload, uint8_t length);
+
+    // The response to the oldest request outstanding. False on timeout, I/O
+    // error, or a response out of step with the requests.
+    bool receive(HvspResponse &r);
+
+    // Send a request and wait for its response, after all earlier ones.
+    bool transact(uint8_t code, const uint8_t *payload, uint8_t length, HvspResponse &r);
+
+    size_t pending() const { return sent.size(); }
+
+    std::string error;
+    unsigned timeoutMs = 3000;
+
+  private:
+    int fd = -1;
+    uint16_t window = HVSP_MAX_FRAME;
+    uint8_t nextSeq = 0;
+
+    struct Sent {
+      uint8_t seq;
+      uint8_t size;
+    };
+    std::deque<Sent> sent;
+    size_t outstanding = 0;
+
+    // Responses received while making room in the window.
+    std::deque<HvspResponse> early;
+
+    HvspFrameParser parser;
+    uint8_t rx[256];
+    size_t rxLength = 0;
+    size_t rxPos = 0;
+
+    bool readResponse(HvspResponse &r);
+};
@@ -0,0 +1,71 @@
+#include "hvspproto.h"
+
+uint8_t hvspEncode(uint8_t *out, uint8_t seq, uint8_t code, const uint8_t *payload, uint8_t length) {
+  uint8_t sum1 = 0, sum2 = 0;
+  uint8_t n = 0;
+  out[n++] = HVSP_SYNC;
+  out[n++] = seq;
+  out[n++] = code;
+  out[n++] = length;
+  for (uint8_t i = 0; i < length; i++)
+    out[n++] = payload[i];
+  for (uint8_t i = 1; i < n; i++) {
+    sum1 += out[i];
+    sum2 += sum1;
+  }
+  out[n++] = sum1;
+  out[n++] = sum2;
+  return n;
+}
+
+HvspFeed HvspFrameParser::feed(uint8_t b) {
+  switch (state) {
+    case SYNC:
+      if (b == HVSP_SYNC) {
+        sum1 = 0;
+        sum2 = 0;
+        state = SEQ;
+      }
+      return HVSP_FEED_MORE;
+
+    case SEQ:
+      seq = b;
+      add(b);
+      state = CODE;
+      return HVSP_FEED_MORE;
+
+    case CODE:
+      code = b;
+      add(b);
+      state = LENGTH;
+      return HVSP_FEED_MORE;
+
+    case LENGTH:
+      length = b;
+      add(b);
+      received = 0;
+      if (length > HVSP_MAX_PAYLOAD) {
+        state = SYNC;
+        return HVSP_FEED_BAD;
+      }
+      state = length == 0 ? SUM1 : PAYLOAD;
+      return HVSP_FEED_MORE;
+
+    case PAYLOAD:
+      payload[received++] = b;
+      add(b);
+      if (received == length)
+        state = SUM1;
+      return HVSP_FEED_MORE;
+
+    case SUM1:
+      frameSum1 = b;
+      state = SUM2;
+      return HVSP_FEED_MORE;
+
+    case SUM2:
+      state = SYNC;
+      return frameSum1 == sum1 && b == sum2 ? HVSP_FEED_FRAME : HVSP_FEED_BAD;
+  }
+  return HVSP_FEED_MORE;
+}
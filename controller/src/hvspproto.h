@@ -0,0 +1,148 @@
+#pragma once
+
+/*
+ * Framed binary protocol between a host and the HVSP programmer firmware
+ * (main-hvsp.cpp). Shared by both ends, so it has no Arduino dependencies.
+ *
+ *   request:  HVSP_SYNC seq command length payload sum1 sum2
+ *   response: HVSP_SYNC seq status  length payload sum1 sum2
+ *
+ * seq is chosen by the host and echoed in the response, so the host can keep
+ * several requests in flight and match up the answers. Requests are executed
+ * in order. sum1 and sum2 are a mod-256 Fletcher checksum over seq, the
+ * command or status, the length and the payload. Multi-byte fields are
+ * little-endian.
+ *
+ * The firmware's serial receive buffer holds the requests that are waiting,
+ * so a host may have up to rxBuffer bytes of requests outstanding (from
+ * HVSP_INFO) without any being lost while the target is busy programming.
+ *
+ * Requests and their payloads; every response carries a status, and its
+ * payload only on HVSP_OK:
+ *
+ *   HVSP_INFO                      -> version, rxBuffer (2), maxPayload, sockets
+ *   HVSP_ENTER                     -> signature (2)
+ *   HVSP_EXIT
+ *   HVSP_READ_SIGNATURE            -> signature (2)
+ *   HVSP_READ_FUSES                -> lfuse, hfuse, efuse, lock
+ *   HVSP_WRITE_FUSE   fuse, value
+ *   HVSP_CHIP_ERASE
+ *   HVSP_WRITE_FLASH  word address (2), page data   (programs and verifies one page)
+ *   HVSP_READ_FLASH   word address (2), words       -> data
+ *   HVSP_WRITE_EEPROM address (2), page data        (programs and verifies one page)
+ *   HVSP_READ_EEPROM  address (2), bytes            -> data
+ *
+ * A page write must lie within one page of the part HVSP_ENTER found
+ * (hvspFlashPageWords(), HVSP_EEPROM_PAGE), or it fails with
+ * HVSP_BAD_LENGTH: more would wrap around the target's page buffer.
+ *
+ * A gang programmer (main-hvspgang.cpp) reports more than one socket and
+ * runs each request on every socket still in play at once. Its responses
+ * start with one HvspStatus per socket, sticky from the socket's first
+ * failure until the next HVSP_ENTER, and the per-socket results follow in
+ * socket order: two signature bytes each for HVSP_ENTER and
+ * HVSP_READ_SIGNATURE, four fuse bytes each for HVSP_READ_FUSES. The frame
+ * status is then only about the request itself. The reads take a socket
+ * number after the count, and answer with that socket's data alone and its
+ * status as the frame status.
+ */
+
+#include <stdint.h>
+
+const uint8_t HVSP_SYNC = 0xA5;
+const uint32_t HVSP_BAUD = 500000;   // Exact on a 16 MHz Uno with U2X
+const uint8_t HVSP_PROTOCOL_VERSION = 2;
+
+// Two bytes of address and a 64-word flash page.
+const uint8_t HVSP_MAX_PAYLOAD = 130;
+const uint8_t HVSP_FRAME_OVERHEAD = 6;
+const uint8_t HVSP_MAX_FRAME = HVSP_MAX_PAYLOAD + HVSP_FRAME_OVERHEAD;
+
+// Sockets on a gang programmer, one SDO line each.
+const uint8_t HVSP_MAX_SOCKETS = 6;
+
+// Flash page in words of a part the programmer knows, from signature byte 1,
+// which is its flash size: 16 for the 2K parts, 32 for the 4K and 8K ones,
+// and 0 for anything else, which can't be written.
+inline uint8_t hvspFlashPageWords(uint16_t signature) {
+  switch (signature >> 8) {
+    case 0x91: return 16;
+    case 0x92:
+    case 0x93: return 32;
+    default: return 0;
+  }
+}
+
+// EEPROM page in bytes, the same on every part it knows.
+const uint8_t HVSP_EEPROM_PAGE = 4;
+
+// Whether count units from addr stay within one page of page units.
+inline bool hvspWithinPage(uint16_t addr, uint8_t count, uint8_t page) {
+  return page != 0 && count <= page && (addr & (page - 1)) + count <= page;
+}
+
+enum HvspCommand : uint8_t {
+  HVSP_INFO = 1,
+  HVSP_ENTER,
+  HVSP_EXIT,
+  HVSP_READ_SIGNATURE,
+  HVSP_READ_FUSES,
+  HVSP_WRITE_FUSE,
+  HVSP_CHIP_ERASE,
+  HVSP_WRITE_FLASH,
+  HVSP_READ_FLASH,
+  HVSP_WRITE_EEPROM,
+  HVSP_READ_EEPROM,
+};
+
+enum HvspStatus : uint8_t {
+  HVSP_OK,
+  HVSP_BAD_FRAME,     // Checksum failed; seq may be wrong too
+  HVSP_BAD_COMMAND,
+  HVSP_BAD_LENGTH,
+  HVSP_NOT_ENTERED,   // Target isn't powered in programming mode
+  HVSP_TIMEOUT,       // Target never raised SDO
+  HVSP_VERIFY_FAILED,
+};
+
+// Write a frame into out, which must hold length + HVSP_FRAME_OVERHEAD
+// bytes. Returns the frame size.
+uint8_t hvspEncode(uint8_t *out, uint8_t seq, uint8_t code, const uint8_t *payload, uint8_t length);
+
+enum HvspFeed : uint8_t { HVSP_FEED_MORE, HVSP_FEED_FRAME, HVSP_FEED_BAD };
+
+// Reassembles frames from a byte stream, one byte at a time.
+class HvspFrameParser {
+  public:
+    uint8_t seq = 0;
+    uint8_t code = 0;
+    uint8_t length = 0;
+    uint8_t payload[HVSP_MAX_PAYLOAD];
+
+    // HVSP_FEED_FRAME when b completes a good frame, now in the fields above;
+    // HVSP_FEED_BAD when it completes one that fails its checksum or is too
+    // long. Bytes before a sync byte are skipped.
+    HvspFeed feed(uint8_t b);
+
+  private:
+    enum State : uint8_t { SYNC, SEQ, CODE, LENGTH, PAYLOAD, SUM1, SUM2 };
+    State state = SYNC;
+    uint8_t received = 0;
+    uint8_t sum1 = 0;
+    uint8_t sum2 = 0;
+    uint8_t frameSum1 = 0;
+
+    void add(uint8_t b) {
+      sum1 += b;
+      sum2 += sum1;
+    }
+};
+
+inline uint16_t hvspGet16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+inline void hvspPut16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
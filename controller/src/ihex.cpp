@@ -0,0 +1,159 @@
+#include "ihex.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Decode the hex digits of a record after the ':', into bytes.
+static bool decodeRecord(const char *s, std::vector<uint8_t> &bytes) {
+  bytes.clear();
+  while (*s && *s != '\r' && *s != '\n') {
+    int hi = hexDigit(s[0]);
+    int lo = hi < 0 ? -1 : hexDigit(s[1]);
+    if (lo < 0)
+      return false;
+    bytes.push_back((uint8_t)(hi << 4 | lo));
+    s += 2;
+  }
+  return true;
+}
+
+bool HexImage::load(const char *path, std::string &error) {
+  data.clear();
+  used.clear();
+
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    error = std::string(path) + ": " + strerror(errno);
+    return false;
+  }
+
+  char line[600];
+  std::vector<uint8_t> rec;
+  uint32_t base = 0;
+  unsigned lineNo = 0;
+  bool ended = false;
+  char where[64];
+
+  while (!ended && fgets(line, sizeof(line), f)) {
+    lineNo++;
+    snprintf(where, sizeof(where), "%s:%u: ", path, lineNo);
+    if (line[0] == '\r' || line[0] == '\n')
+      continue;
+    if (line[0] != ':' || !decodeRecord(line + 1, rec) || rec.size() < 5 || rec.size() != (size_t)rec[0] + 5) {
+      error = std::string(where) + "malformed record";
+      fclose(f);
+      return false;
+    }
+
+    uint8_t sum = 0;
+    for (uint8_t b : rec)
+      sum += b;
+    if (sum != 0) {
+      error = std::string(where) + "bad checksum";
+      fclose(f);
+      return false;
+    }
+
+    uint8_t count = rec[0];
+    uint16_t offset = rec[1] << 8 | rec[2];
+    const uint8_t *payload = &rec[4];
+    switch (rec[3]) {
+      case 0x00: {
+        uint32_t addr = base + offset;
+        if (data.size() < addr + count) {
+          data.resize(addr + count, 0xFF);
+          used.resize(addr + count, false);
+        }
+        for (uint8_t i = 0; i < count; i++) {
+          data[addr + i] = payload[i];
+          used[addr + i] = true;
+        }
+        break;
+      }
+      case 0x01:
+        ended = true;
+        break;
+      case 0x02:
+        base = (uint32_t)(payload[0] << 8 | payload[1]) << 4;
+        break;
+      case 0x04:
+        base = (uint32_t)(payload[0] << 8 | payload[1]) << 16;
+        break;
+      case 0x03:
+      case 0x05:
+        break;
+      default:
+        error = std::string(where) + "unknown record type";
+        fclose(f);
+        return false;
+    }
+  }
+  fclose(f);
+
+  if (!ended) {
+    error = std::string(path) + ": no end of file record";
+    return false;
+  }
+  return true;
+}
+
+bool HexImage::anyUsed(size_t addr, size_t length) const {
+  for (size_t a = addr; a < addr + length && a < used.size(); a++)
+    if (used[a])
+      return true;
+  return false;
+}
+
+// One record: count, address, type, payload and checksum.
+static void writeRecord(FILE *f, uint8_t type, uint16_t offset, const uint8_t *payload, uint8_t count) {
+  uint8_t sum = count + (offset >> 8) + (offset & 0xFF) + type;
+  fprintf(f, ":%02X%04X%02X", count, offset, type);
+  for (uint8_t i = 0; i < count; i++) {
+    fprintf(f, "%02X", payload[i]);
+    sum += payload[i];
+  }
+  fprintf(f, "%02X\n", (uint8_t)-sum);
+}
+
+bool HexImage::save(const char *path, std::string &error) const {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    error = std::string(path) + ": " + strerror(errno);
+    return false;
+  }
+
+  uint32_t base = 0;
+  for (size_t a = 0; a < data.size();) {
+    if (!used[a]) {
+      a++;
+      continue;
+    }
+    if ((a & ~0xFFFFu) != base) {
+      base = a & ~0xFFFFu;
+      uint8_t upper[2] = {(uint8_t)(base >> 24), (uint8_t)(base >> 16)};
+      writeRecord(f, 0x04, 0, upper, 2);
+    }
+    // Runs of set bytes, not crossing a 16-byte line or a 64K segment.
+    uint8_t count = 0;
+    while (count < 16 && a + count < data.size() && used[a + count] &&
+           ((a + count) & ~0xFFFFu) == base && (count == 0 || (a + count) % 16 != 0))
+      count++;
+    writeRecord(f, 0x00, a & 0xFFFF, &data[a], count);
+    a += count;
+  }
+  writeRecord(f, 0x01, 0, NULL, 0);
+
+  if (fclose(f) != 0) {
+    error = std::string(path) + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
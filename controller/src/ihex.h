@@ -0,0 +1,33 @@
+#pragma once
+
+/*
+ * Intel HEX files, as PlatformIO writes them to .pio/build/<env>/firmware.hex,
+ * and as hvspcli dumps EEPROM. Host only.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// A memory image. Bytes the file doesn't set read as 0xFF, the erased value.
+struct HexImage {
+  std::vector<uint8_t> data;
+  std::vector<bool> used;
+
+  // Read a file, replacing the image. Data, EOF, extended segment and
+  // extended linear address records are understood; start address records
+  // are ignored. On failure error says what and where.
+  bool load(const char *path, std::string &error);
+
+  // Write the bytes the image sets as data records of up to 16 bytes, with
+  // extended linear address records past 64K.
+  bool save(const char *path, std::string &error) const;
+
+  // One past the highest address the file sets.
+  size_t size() const { return data.size(); }
+
+  // True if any byte in [addr, addr + length) is set by the file.
+  bool anyUsed(size_t addr, size_t length) const;
+
+  uint8_t at(size_t addr) const { return addr < data.size() ? data[addr] : 0xFF; }
+};
@@ -0,0 +1,633 @@
+#include "ltspice.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <algorithm>
+#include <set>
+
+namespace {
+
+struct Pin {
+  int x, y;
+};
+
+// Pins in SpiceOrder, for a symbol at R0.
+struct SymbolDef {
+  char prefix;
+  std::vector<Pin> pins;
+  std::string model;       // Subcircuit name, for prefix X
+  std::string modelFile;   // Included from the schematic's directory
+};
+
+struct BuiltIn {
+  const char *name;
+  char prefix;
+  std::vector<Pin> pins;
+};
+
+const BuiltIn BUILT_INS[] = {
+  {"res", 'R', {{16, 16}, {16, 96}}},
+  {"cap", 'C', {{16, 0}, {16, 64}}},
+  {"polcap", 'C', {{16, 0}, {16, 64}}},
+  {"voltage", 'V', {{0, 16}, {0, 96}}},
+  {"bv", 'B', {{0, 16}, {0, 96}}},
+  {"current", 'I', {{0, 0}, {0, 80}}},
+  {"bi", 'B', {{0, 0}, {0, 80}}},
+  {"diode", 'D', {{16, 0}, {16, 64}}},
+};
+
+// LTspice's library comparator: In+, In-, V+, V-, Out, the LM393's order.
+const char *COMPARATOR = "MAX9095";
+const std::vector<Pin> COMPARATOR_PINS = {{-32, 16}, {-32, -16}, {0, -32}, {0, 32}, {32, 0}};
+
+const struct {
+  const char *name;
+  const char *model;
+} DIODE_MODELS[] = {
+  {"1N4148", ".model 1N4148 D(Is=2.52n Rs=.568 N=1.752 Cjo=4p M=.4 tt=20n Bv=100)"},
+};
+
+std::string baseName(const std::string &path) {
+  size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+std::string lower(std::string s) {
+  for (char &c : s)
+    c = tolower((unsigned char)c);
+  return s;
+}
+
+bool readFile(const std::string &path, std::string &text, std::string &error) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  char buffer[4096];
+  size_t n;
+  text.clear();
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    text.append(buffer, n);
+  fclose(f);
+  return true;
+}
+
+std::vector<std::string> splitLines(const std::string &text) {
+  std::vector<std::string> lines;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    if (end == std::string::npos)
+      end = text.size();
+    std::string line = text.substr(start, end - start);
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    lines.push_back(line);
+    start = end + 1;
+  }
+  return lines;
+}
+
+std::vector<std::string> tokens(const std::string &line) {
+  std::vector<std::string> t;
+  size_t i = 0;
+  while (i < line.size()) {
+    while (i < line.size() && isspace((unsigned char)line[i]))
+      i++;
+    size_t start = i;
+    while (i < line.size() && !isspace((unsigned char)line[i]))
+      i++;
+    if (i > start)
+      t.push_back(line.substr(start, i - start));
+  }
+  return t;
+}
+
+// The rest of a line after its first n tokens.
+std::string rest(const std::string &line, int n) {
+  size_t i = 0;
+  for (int k = 0; k < n; k++) {
+    while (i < line.size() && isspace((unsigned char)line[i]))
+      i++;
+    while (i < line.size() && !isspace((unsigned char)line[i]))
+      i++;
+  }
+  while (i < line.size() && isspace((unsigned char)line[i]))
+    i++;
+  return line.substr(i);
+}
+
+// Micro as Latin-1 (as LTspice writes it) or UTF-8, to u.
+std::string spiceValue(const std::string &v) {
+  std::string out;
+  for (size_t i = 0; i < v.size(); i++) {
+    unsigned char c = v[i];
+    if (c == 0xc2 && i + 1 < v.size() && (unsigned char)v[i + 1] == 0xb5) {
+      out += 'u';
+      i++;
+    }
+    else if (c == 0xb5) {
+      out += 'u';
+    }
+    else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+bool isNumber(const std::string &s) {
+  return !s.empty() && (isdigit((unsigned char)s[0]) || s[0] == '.' || s[0] == '-' || s[0] == '+');
+}
+
+// key=value from a SpiceLine, or empty.
+std::string lineParam(const std::string &spiceLine, const char *key) {
+  for (const std::string &t : tokens(spiceLine)) {
+    size_t eq = t.find('=');
+    if (eq != std::string::npos && strcasecmp(t.substr(0, eq).c_str(), key) == 0)
+      return t.substr(eq + 1);
+  }
+  return "";
+}
+
+bool nonZero(const std::string &v) {
+  return !v.empty() && atof(v.c_str()) != 0;
+}
+
+// A file in dir by name, ignoring case as Windows does.
+std::string findFile(const std::string &dir, const std::string &name) {
+  DIR *d = opendir(dir.c_str());
+  if (!d)
+    return "";
+  std::string found;
+  while (struct dirent *e = readdir(d)) {
+    if (strcasecmp(e->d_name, name.c_str()) == 0) {
+      found = e->d_name;
+      break;
+    }
+  }
+  closedir(d);
+  return found;
+}
+
+bool readSymbol(const std::string &dir, const std::string &file, SymbolDef &def, std::string &error) {
+  std::string text;
+  if (!readFile(dir + "/" + file, text, error))
+    return false;
+  struct OrderedPin {
+    Pin pin;
+    int order;
+  };
+  std::vector<OrderedPin> pins;
+  std::string spiceModel;
+  def.prefix = 'X';
+  for (const std::string &line : splitLines(text)) {
+    std::vector<std::string> t = tokens(line);
+    if (t.size() >= 3 && t[0] == "PIN") {
+      pins.push_back(OrderedPin{{atoi(t[1].c_str()), atoi(t[2].c_str())}, 0});
+    }
+    else if (t.size() >= 3 && t[0] == "PINATTR" && t[1] == "SpiceOrder" && !pins.empty()) {
+      pins.back().order = atoi(t[2].c_str());
+    }
+    else if (t.size() >= 3 && t[0] == "SYMATTR") {
+      std::string value = rest(line, 2);
+      if (t[1] == "Prefix")
+        def.prefix = toupper((unsigned char)value[0]);
+      else if (t[1] == "Value")
+        def.model = value;
+      else if (t[1] == "ModelFile")
+        def.modelFile = baseName(value);
+      else if (t[1] == "SpiceModel")
+        spiceModel = value;
+    }
+  }
+  if (def.modelFile.empty() && !spiceModel.empty())
+    def.modelFile = spiceModel;
+  std::sort(pins.begin(), pins.end(),
+            [](const OrderedPin &a, const OrderedPin &b) { return a.order < b.order; });
+  for (const OrderedPin &p : pins)
+    def.pins.push_back(p.pin);
+  return true;
+}
+
+// Symbol coordinates to the schematic's, as LTspice orients them: M mirrors
+// in x, then R turns clockwise on screen (y down).
+Pin orient(Pin p, const std::string &orientation) {
+  if (orientation[0] == 'M')
+    p.x = -p.x;
+  int turns = atoi(orientation.c_str() + 1) / 90;
+  for (int i = 0; i < turns; i++)
+    p = Pin{-p.y, p.x};
+  return p;
+}
+
+struct UnionFind {
+  std::vector<int> parent;
+
+  int add() {
+    parent.push_back(parent.size());
+    return parent.size() - 1;
+  }
+
+  int find(int i) {
+    while (parent[i] != i)
+      i = parent[i] = parent[parent[i]];
+    return i;
+  }
+
+  void join(int a, int b) {
+    parent[find(a)] = find(b);
+  }
+};
+
+}
+
+bool AscSchematic::load(const char *path, std::string &error) {
+  std::string text;
+  if (!readFile(path, text, error))
+    return false;
+  std::string p(path);
+  size_t slash = p.find_last_of('/');
+  directory = slash == std::string::npos ? "." : p.substr(0, slash);
+
+  struct Wire {
+    Pin a, b;
+  };
+  struct Flag {
+    Pin at;
+    std::string name;
+  };
+  struct Placed {
+    std::string symbol;
+    Pin at;
+    std::string orientation;
+    std::map<std::string, std::string> attrs;
+  };
+  std::vector<Wire> wires;
+  std::vector<Flag> flags;
+  std::vector<Placed> placed;
+
+  for (const std::string &line : splitLines(text)) {
+    std::vector<std::string> t = tokens(line);
+    if (t.empty())
+      continue;
+    if (t[0] == "WIRE" && t.size() >= 5) {
+      wires.push_back(Wire{{atoi(t[1].c_str()), atoi(t[2].c_str())},
+                           {atoi(t[3].c_str()), atoi(t[4].c_str())}});
+    }
+    else if (t[0] == "FLAG" && t.size() >= 4) {
+      flags.push_back(Flag{{atoi(t[1].c_str()), atoi(t[2].c_str())}, t[3]});
+    }
+    else if (t[0] == "SYMBOL" && t.size() >= 5) {
+      placed.push_back(Placed{baseName(t[1]), {atoi(t[2].c_str()), atoi(t[3].c_str())}, t[4], {}});
+    }
+    else if (t[0] == "SYMATTR" && t.size() >= 2 && !placed.empty()) {
+      placed.back().attrs[t[1]] = rest(line, 2);
+    }
+    else if (t[0] == "TEXT") {
+      std::string s = rest(line, 5);
+      if (!s.empty() && s[0] == '!')
+        directives.push_back(s.substr(1));
+    }
+  }
+
+  // Every point that can connect, then wires joining them.
+  std::map<std::pair<int, int>, int> points;
+  UnionFind nets;
+  auto point = [&](Pin p) {
+    auto it = points.find({p.x, p.y});
+    if (it != points.end())
+      return it->second;
+    int id = nets.add();
+    points[{p.x, p.y}] = id;
+    return id;
+  };
+  for (const Wire &w : wires)
+    nets.join(point(w.a), point(w.b));
+  for (const Flag &f : flags)
+    point(f.at);
+
+  std::vector<SymbolDef> defs;
+  for (const Placed &s : placed) {
+    SymbolDef def;
+    bool found = false;
+    for (const BuiltIn &b : BUILT_INS) {
+      if (s.symbol == b.name) {
+        def.prefix = b.prefix;
+        def.pins = b.pins;
+        found = true;
+      }
+    }
+    std::string asy = found ? "" : findFile(directory, s.symbol + ".asy");
+    if (!asy.empty()) {
+      if (!readSymbol(directory, asy, def, error))
+        return false;
+      found = true;
+    }
+    if (!found && strcasecmp(s.symbol.c_str(), COMPARATOR) == 0) {
+      def.prefix = 'X';
+      def.pins = COMPARATOR_PINS;
+      def.model = "LM393";
+      def.modelFile = "LM393.cir";
+      found = true;
+    }
+    if (!found) {
+      error = "no symbol for " + s.symbol;
+      return false;
+    }
+    auto value = s.attrs.find("Value");
+    if (def.prefix == 'X' && value != s.attrs.end() && def.model.empty())
+      def.model = value->second;
+    if (!def.modelFile.empty()) {
+      std::string file = findFile(directory, def.modelFile);
+      if (file.empty()) {
+        error = s.symbol + ": no model file " + def.modelFile;
+        return false;
+      }
+      std::string model;
+      if (!readFile(directory + "/" + file, model, error))
+        return false;
+      if (model.find("LTspice Encrypted File") != std::string::npos) {
+        error = file + " is encrypted, which only LTspice reads";
+        return false;
+      }
+      def.modelFile = file;
+    }
+    for (Pin &p : def.pins) {
+      p = orient(p, s.orientation);
+      p.x += s.at.x;
+      p.y += s.at.y;
+      point(p);
+    }
+    defs.push_back(def);
+  }
+
+  // Points on a wire's length join it, as T junctions and pins do.
+  for (const auto &p : points) {
+    int x = p.first.first, y = p.first.second;
+    for (const Wire &w : wires) {
+      long cross = (long)(w.b.x - w.a.x) * (y - w.a.y) - (long)(w.b.y - w.a.y) * (x - w.a.x);
+      if (cross == 0 && x >= std::min(w.a.x, w.b.x) && x <= std::max(w.a.x, w.b.x) &&
+          y >= std::min(w.a.y, w.b.y) && y <= std::max(w.a.y, w.b.y))
+        nets.join(p.second, point(w.a));
+    }
+  }
+
+  // Flags of one name are one net, wherever they are.
+  std::map<std::string, int> named;
+  for (const Flag &f : flags) {
+    auto it = named.find(f.name);
+    if (it == named.end())
+      named[f.name] = point(f.at);
+    else
+      nets.join(point(f.at), it->second);
+  }
+  std::map<int, std::string> netNames;
+  for (const Flag &f : flags)
+    netNames[nets.find(point(f.at))] = f.name;
+
+  unsigned unnamed = 0;
+  for (size_t i = 0; i < placed.size(); i++) {
+    const Placed &s = placed[i];
+    AscComponent c;
+    c.symbol = s.symbol;
+    auto attr = [&](const char *key) {
+      auto it = s.attrs.find(key);
+      return it == s.attrs.end() ? std::string() : it->second;
+    };
+    c.name = attr("InstName");
+    if (toupper((unsigned char)c.name[0]) != defs[i].prefix)
+      c.name = std::string(1, defs[i].prefix) + c.name;
+    c.value = defs[i].prefix == 'X' ? defs[i].model : spiceValue(attr("Value"));
+    c.spiceLine = spiceValue(attr("SpiceLine"));
+    for (Pin p : defs[i].pins) {
+      int root = nets.find(point(p));
+      auto name = netNames.find(root);
+      if (name == netNames.end()) {
+        char n[8];
+        snprintf(n, sizeof(n), "N%03u", ++unnamed);
+        name = netNames.emplace(root, n).first;
+      }
+      c.nets.push_back(name->second);
+    }
+    components.push_back(c);
+    const std::string &file = defs[i].modelFile;
+    if (!file.empty() && std::find(includes.begin(), includes.end(), file) == includes.end())
+      includes.push_back(file);
+  }
+  return true;
+}
+
+const AscComponent *AscSchematic::find(const std::string &name) const {
+  for (const AscComponent &c : components) {
+    if (strcasecmp(c.name.c_str(), name.c_str()) == 0)
+      return &c;
+  }
+  return NULL;
+}
+
+std::string AscSchematic::netlist(const std::map<std::string, std::string> &values,
+                                  bool noise, bool withDirectives,
+                                  const std::string &modelDir) const {
+  // Current sources read by a behavioral source get a series 0 V source.
+  std::set<std::string> sensed;
+  for (const AscComponent &c : components) {
+    if (c.name[0] != 'B' && c.name[0] != 'b')
+      continue;
+    std::string v = lower(c.value);
+    for (size_t i = v.find("i("); i != std::string::npos; i = v.find("i(", i + 1)) {
+      if (i > 0 && isalnum((unsigned char)v[i - 1]))
+        continue;
+      size_t close = v.find(')', i);
+      const AscComponent *source = find(c.value.substr(i + 2, close - i - 2));
+      if (source && toupper((unsigned char)source->name[0]) == 'I')
+        sensed.insert(lower(source->name));
+    }
+  }
+
+  std::string out = "* ngspice netlist of an LTspice schematic\n";
+  std::set<std::string> diodes;
+  char line[512];
+  for (const AscComponent &c : components) {
+    auto override = values.find(c.name);
+    std::string value = override != values.end() ? override->second : c.value;
+    const std::string &a = c.nets[0];
+    const std::string &b = c.nets.size() > 1 ? c.nets[1] : c.nets[0];
+    std::string rser = lineParam(c.spiceLine, "Rser");
+
+    switch (toupper((unsigned char)c.name[0])) {
+      case 'C':
+        if (nonZero(rser)) {
+          snprintf(line, sizeof(line), "%s %s %s_s %s\nR%s_ser %s_s %s %s\n", c.name.c_str(),
+                   a.c_str(), c.name.c_str(), value.c_str(), c.name.c_str(), c.name.c_str(),
+                   b.c_str(), rser.c_str());
+          out += line;
+          break;
+        }
+        out += c.name + " " + a + " " + b + " " + value + "\n";
+        break;
+
+      case 'V': {
+        std::string cpar = lineParam(c.spiceLine, "Cpar");
+        if (nonZero(rser)) {
+          snprintf(line, sizeof(line), "%s %s_s %s %s\nR%s_ser %s %s_s %s\n", c.name.c_str(),
+                   c.name.c_str(), b.c_str(), value.c_str(), c.name.c_str(), a.c_str(),
+                   c.name.c_str(), rser.c_str());
+          out += line;
+        }
+        else {
+          out += c.name + " " + a + " " + b + " " + value + "\n";
+        }
+        if (nonZero(cpar))
+          out += "C" + c.name + "_par " + a + " " + b + " " + cpar + "\n";
+        break;
+      }
+
+      case 'I': {
+        // ngspice spells the sine source SIN.
+        std::string v = value;
+        if (strncasecmp(v.c_str(), "SINE(", 5) == 0)
+          v = "SIN(" + v.substr(5);
+        if (sensed.count(lower(c.name))) {
+          snprintf(line, sizeof(line), "%s %s %s_m %s\nV%s_sense %s_m %s 0\n", c.name.c_str(),
+                   a.c_str(), c.name.c_str(), v.c_str(), c.name.c_str(), c.name.c_str(), b.c_str());
+          out += line;
+        }
+        else {
+          out += c.name + " " + a + " " + b + " " + v + "\n";
+        }
+        break;
+      }
+
+      case 'B': {
+        std::string compact;
+        for (char ch : value)
+          if (!isspace((unsigned char)ch))
+            compact += tolower((unsigned char)ch);
+        double k, d;
+        char tail;
+        if (compact.find("white(") != std::string::npos) {
+          // white() is uniform in +-0.5, new each 1/k s; the RMS of that is
+          // 1/sqrt(12).
+          if (noise && sscanf(compact.c_str(), "v=white(%lf*time)/%lf%c", &k, &d, &tail) == 2) {
+            snprintf(line, sizeof(line), "V%s %s %s TRNOISE(%g %g 0 0)\n", c.name.c_str(),
+                     a.c_str(), b.c_str(), 1 / (sqrt(12.0) * d), 1 / k);
+            out += line;
+          }
+          else {
+            out += "V" + c.name + " " + a + " " + b + " 0\n";
+          }
+          break;
+        }
+        std::string v = value;
+        std::string l = lower(v);
+        for (size_t i = l.find("i("); i != std::string::npos; i = l.find("i(", i + 1)) {
+          size_t close = l.find(')', i);
+          std::string name = l.substr(i + 2, close - i - 2);
+          if (!sensed.count(name) || (i > 0 && isalnum((unsigned char)l[i - 1])))
+            continue;
+          std::string sense = "V" + find(name)->name + "_sense";
+          v.replace(i + 2, close - i - 2, sense);
+          l = lower(v);
+        }
+        out += c.name + " " + a + " " + b + " " + v + "\n";
+        break;
+      }
+
+      case 'D':
+        for (const auto &m : DIODE_MODELS)
+          if (strcasecmp(value.c_str(), m.name) == 0)
+            diodes.insert(m.model);
+        out += c.name + " " + a + " " + b + " " + value + "\n";
+        break;
+
+      case 'X':
+        out += c.name;
+        for (const std::string &n : c.nets)
+          out += " " + n;
+        out += " " + value + "\n";
+        break;
+
+      default:
+        out += c.name + " " + a + " " + b + " " + value + "\n";
+        break;
+    }
+  }
+
+  for (const std::string &m : diodes)
+    out += m + "\n";
+  for (const std::string &file : includes)
+    out += ".include \"" + (modelDir.empty() ? directory : modelDir) + "/" + file + "\"\n";
+  if (withDirectives) {
+    for (std::string d : directives) {
+      // LTspice's startup ramps the supplies; ngspice starts from the
+      // operating point either way.
+      size_t s = lower(d).find(" startup");
+      if (s != std::string::npos)
+        d.erase(s, 8);
+      out += d + "\n";
+    }
+  }
+  return out;
+}
+
+bool AscSchematic::writeModels(const std::string &dir, std::string &error) const {
+  for (const std::string &file : includes) {
+    std::string text;
+    if (!readFile(directory + "/" + file, text, error))
+      return false;
+    std::string out;
+    for (std::string line : splitLines(text)) {
+      size_t semi = line.find(';');
+      if (semi != std::string::npos && line[0] != '*')
+        line.erase(semi);
+      std::vector<std::string> t = tokens(line);
+      char kind = t.empty() ? ' ' : toupper((unsigned char)t[0][0]);
+
+      if (kind == 'B' && t.size() >= 3) {
+        std::string kept, rpar;
+        for (const std::string &w : t) {
+          if (strncasecmp(w.c_str(), "rpar=", 5) == 0)
+            rpar = w.substr(5);
+          else
+            kept += (kept.empty() ? "" : " ") + w;
+        }
+        if (!rpar.empty()) {
+          line = kept + "\nR" + t[0] + "_rpar " + t[1] + " " + t[2] + " " + rpar;
+        }
+      }
+      else if (kind == 'R' && t.size() >= 5) {
+        if (!isNumber(t[3]) && isNumber(t[4]))
+          std::swap(t[3], t[4]);
+        for (size_t i = 4; i < t.size(); i++) {
+          if (strcasecmp(t[i].c_str(), "TC") == 0 && i + 1 < t.size()) {
+            std::string tc = "TC=" + t[i + 1];
+            if (i + 2 < t.size() && isNumber(t[i + 2]))
+              tc += "," + t[i + 2], t.erase(t.begin() + i + 2);
+            t[i] = tc;
+            t.erase(t.begin() + i + 1);
+          }
+        }
+        line.clear();
+        for (const std::string &w : t)
+          line += (line.empty() ? "" : " ") + w;
+      }
+      out += line + "\n";
+    }
+    FILE *f = fopen((dir + "/" + file).c_str(), "w");
+    if (!f || fwrite(out.data(), 1, out.size(), f) != out.size()) {
+      error = dir + "/" + file + ": " + strerror(errno);
+      if (f)
+        fclose(f);
+      return false;
+    }
+    fclose(f);
+  }
+  return true;
+}
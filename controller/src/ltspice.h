@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * LTspice schematics (.asc) turned into ngspice netlists, for the analog
+ * front end in transmitter/LTSpice. Host only.
+ *
+ * Nets are found as LTspice finds them: wire ends, pins and net flags at the
+ * same point are connected, as is any of them lying on a wire. Flag 0 is
+ * ground; other flags name their net, and the rest are N001, N002 and so on.
+ *
+ * Symbols are the built-in passives and sources (res, cap, polcap, voltage,
+ * current, bi, bv, diode), plus any with a .asy file next to the schematic,
+ * whose model file is included from there too. LTspice-only parts of the
+ * schematic are translated:
+ *   Rser/Cpar    on a source or capacitor become a separate R and C
+ *   I(source)    of a current source in a behavioral expression reads an
+ *                0 V source put in series with it
+ *   white()      noise, as V=white(k*time)/d, becomes a TRNOISE source of the
+ *                same RMS and step, or 0 V when noise is off
+ *   MAX9095      (the comparator from LTspice's own library, whose model is
+ *                not shipped) is the LM393 in LM393.cir; the schematic pulls
+ *                its open-collector output up anyway
+ *   1N4148       LTspice's standard.dio parameters
+ * Encrypted model files can't be used, and are reported as errors.
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+
+struct AscComponent {
+  std::string symbol;      // Without its library path
+  std::string name;        // InstName
+  std::string value;
+  std::string spiceLine;   // SpiceLine, e.g. Rser=.2
+  std::vector<std::string> nets;   // In SpiceOrder
+};
+
+class AscSchematic {
+  public:
+    bool load(const char *path, std::string &error);
+
+    // The netlist, with component values replaced from values (by InstName)
+    // and, when withDirectives, the schematic's own .tran and the like.
+    // Included model files are those written by writeModels() into
+    // modelDir, or the originals when modelDir is empty.
+    std::string netlist(const std::map<std::string, std::string> &values,
+                        bool noise, bool withDirectives,
+                        const std::string &modelDir = "") const;
+
+    // Copies of the model files the netlist includes, fixed up for ngspice:
+    // rpar= on a behavioral source becomes a resistor, TC without = gains
+    // one, PSpice's model-before-value resistors are swapped and ; comments
+    // go.
+    bool writeModels(const std::string &dir, std::string &error) const;
+
+    const AscComponent *find(const std::string &name) const;
+
+    std::vector<AscComponent> components;
+    std::vector<std::string> directives;   // TEXT lines starting with !
+
+  private:
+    std::string directory;
+    std::vector<std::string> includes;     // Model file names in directory
+};
@@ -0,0 +1,505 @@
+/*
+ * Discrete-event simulation of N transmitters sharing the RF channel with one
+ * receiver.
+ *
+ * Each tool turns on and off at random (exponentially distributed on and off
+ * times) and runs its own copy of the transmitter logic. Frames that overlap
+ * in time are modelled as the bitwise OR of their codes on the receiver's
+ * four inputs, which is what the receiver's pin change handler then decodes.
+ * Time only advances from event to event, and each N is an independent run,
+ * so the sweep is spread across all cores.
+ *
+ * Reported per N:
+ *   busy      fraction of the time any frame was on the air
+ *   collide   fraction of frames that overlapped another frame
+ *   deliv/min frames that overlapped no other and weren't lost, per minute
+ *             with any tool running: the rate frames actually get through
+ *   corrupt   fraction of decoded codes that no single transmitter sent
+ *   accepted  corrupted codes that isValidCode() let through, and with
+ *             complement frames, that were followed by their complement
+ *   widthrej  codes a transmitter did send that the pulse width check turned
+ *             away: what showed of a frame between other frames' edges
+ *   start     time from a tool starting (collector off) to the output on
+ *   falseoff  TOOL_QUIET_TIMEOUT shutoffs while a tool was running, per day,
+ *             including STOPPED_RUN_ON expiring under another running tool
+ *   shutoff   SHUTOFF_TIMEOUT shutoffs while a tool was running, per day
+ *   uncovered fraction of tool run time with the collector off
+ *   runon     minutes per day the collector ran with no tool on
+ *   overflow  input samples the receiver's code queue dropped
+ *
+ * With ids set, each transmitter sends an ID after every code (tool i has ID
+ * i % MAX_TOOLS), which costs two more frames of airtime per code.
+ *
+ * Each transmitter's interval generator is seeded differently, as the
+ * firmware seeds it per device; with sameSeed they all start from the same
+ * state, as every transmitter did before it was seeded. backoff turns on the
+ * transmitters' slotted backoff after trigger changes. With strip above 1,
+ * tools are switched on and off in groups of that many at once, as tools on
+ * one power strip are, which is where same seeds and the immediate first
+ * frame hurt most. adaptiveQuiet has the receiver adapt its quiet timeout to
+ * the gaps it sees instead of holding it at QUIET_INTERVAL. complement has
+ * every transmitter send complement frames and the receiver require them.
+ * frameTime is every transmitter's frame hold in milliseconds (BIT_ON_TIME
+ * by default), and widthCheck has the receiver check each code's pulse width
+ * against it. Codes are classified as they end, once their width is known.
+ * frameLoss is the probability that the receiver misses any one frame
+ * outright, as it does in a fade or beyond its range; a lost frame still
+ * takes up airtime but never reaches the inputs.
+ *
+ * Usage: program [days] [maxTools] [meanOnSeconds] [meanOffSeconds] [threads] [seed] [ids]
+ *                [sameSeed] [backoff] [strip] [adaptiveQuiet] [complement] [frameTime]
+ *                [widthCheck] [frameLoss]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "hal.h"
+#include "receiver.h"
+#include "transmitter.h"
+#include "sim.h"
+
+struct Params {
+  double days;
+  double meanOn;   // milliseconds
+  double meanOff;  // milliseconds
+  unsigned long seed;
+  bool ids;
+  bool sameSeed;
+  bool backoff;
+  unsigned strip;   // Tools switched together
+  bool adaptiveQuiet;
+  bool complement;
+  uint16_t frameTime;
+  bool widthCheck;
+  double frameLoss;
+};
+
+struct Result {
+  unsigned tools;
+  uint64_t frames;
+  uint64_t collided;
+  uint64_t lost;      // Lost outright without colliding
+  uint64_t decodes;
+  uint64_t corrupted;
+  uint64_t accepted;
+  uint64_t widthRejected;
+  uint64_t falseShutoffs;
+  uint64_t shutoffs;
+  uint64_t toolOnMs;
+  uint64_t uncoveredMs;
+  uint64_t runOnMs;
+  uint64_t busyMs;
+  uint16_t overflows;
+  SimStat startLatency;
+};
+
+enum class EventType : uint8_t { TOOL_ON, TOOL_OFF, STEP };
+
+struct Event {
+  uint64_t time;
+  uint64_t seq;
+  EventType type;
+  uint16_t tool;
+
+  bool operator>(const Event &other) const {
+    return time != other.time ? time > other.time : seq > other.seq;
+  }
+};
+
+struct Tool {
+  Transmitter tx;
+  bool on = false;
+  bool looping = false;  // Transmitter state machine is not idle
+  bool frameOn = false;
+  bool frameCollided = false;
+  bool frameLost = false;  // Never reaches the receiver
+  uint8_t code = 0;
+  bool waiting = false;  // Started while the collector was off
+  uint64_t startTime = 0;
+  uint64_t stepSeq = 0;  // The STEP event still current; others are stale
+};
+
+class ChannelSim {
+  public:
+    ChannelSim(unsigned tools, const Params &p)
+      : tools(tools), params(p), rng(p.seed * 1000003 + tools),
+        onTime(1.0 / p.meanOn), offTime(1.0 / p.meanOff) {}
+
+    Result run(uint64_t endTime);
+
+  private:
+    std::vector<Tool> tools;
+    Params params;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    uint64_t seq = 0;
+    uint64_t now = 0;
+
+    Receiver receiver;
+    uint8_t bitCount[4] = {0, 0, 0, 0};
+    uint8_t inputs = 0;
+    uint64_t inputsTime = 0;     // When the inputs last changed
+    bool inputsSent = false;     // Some transmitter was sending them then
+    Code unconfirmed = Code::NONE;   // Corrupted, awaiting its complement
+    uint64_t unconfirmedTime = 0;
+    unsigned activeFrames = 0;
+    unsigned toolsOn = 0;
+    bool output = false;
+
+    std::mt19937_64 rng;
+    std::exponential_distribution<double> onTime;
+    std::exponential_distribution<double> offTime;
+    std::uniform_real_distribution<double> unit;
+
+    Result r = {};
+
+    uint64_t schedule(uint64_t t, EventType type, uint16_t tool) {
+      events.push(Event{t, seq, type, tool});
+      return seq++;
+    }
+
+    uint8_t channel() const;
+    void step(uint16_t i);
+    void frameStart(Tool &t);
+    void frameEnd(Tool &t);
+    void decode();
+    void classify(uint8_t bits, uint64_t start, bool sent);
+    void advance(uint64_t t);
+    void toolOn(uint16_t i);
+    void toolOff(uint16_t i);
+};
+
+uint8_t ChannelSim::channel() const {
+  uint8_t bits = 0;
+  for (int b = 0; b < 4; b++)
+    if (bitCount[b])
+      bits |= 1 << b;
+  return bits;
+}
+
+// If the channel changed, the receiver sees a pin change. That ends the code
+// on the inputs until now; classify it, as the receiver decodes it.
+void ChannelSim::decode() {
+  uint8_t bits = channel();
+  if (bits == inputs)
+    return;
+  simSetInputs(receiver, (uint32_t)now, bits);
+  if (inputs != 0)
+    classify(inputs, inputsTime, inputsSent);
+
+  inputs = bits;
+  inputsTime = now;
+  inputsSent = false;
+  for (const Tool &t : tools)
+    if (t.frameOn && !t.frameLost && t.code == bits)
+      inputsSent = true;
+}
+
+// A code that was on the inputs from start until now; sent is whether some
+// transmitter was sending it when it started.
+void ChannelSim::classify(uint8_t bits, uint64_t start, bool sent) {
+  if (receiver.frameTime != 0) {
+    if (now - start < receiver.pulseWidthMin()) {
+      if (sent)
+        r.widthRejected++;
+      return;
+    }
+  }
+
+  r.decodes++;
+
+  // A corrupted STARTING or RUNNING gets through the complement check only
+  // if its complement follows in time, as the receiver holds it.
+  if (unconfirmed != Code::NONE && start - unconfirmedTime <= COMPLEMENT_WINDOW &&
+      (Code)bits == complementOf(unconfirmed)) {
+    r.accepted++;
+    unconfirmed = Code::NONE;
+  }
+
+  if (params.complement && isComplemented((Code)bits)) {
+    unconfirmed = sent ? Code::NONE : (Code)bits;
+    unconfirmedTime = start;
+  }
+  if (sent)
+    return;
+  r.corrupted++;
+  if (!params.complement || !isComplemented((Code)bits))
+    if (isValidCode((Code)bits))
+      r.accepted++;
+}
+
+// Run tool i's transmitter state machine and put whatever it sends on the
+// channel.
+void ChannelSim::step(uint16_t i) {
+  Tool &t = tools[i];
+  uint16_t ms = t.tx.step();
+
+  // The transmitter outputs are active low, on PB1-PB4.
+  uint8_t code = (uint8_t)(~halSimCodeOutputs() >> 1) & (uint8_t)Code::MASK;
+  if (t.frameOn)
+    frameEnd(t);
+  if (t.tx.state == TxState::FRAME) {
+    t.code = code;
+    frameStart(t);
+  }
+  decode();
+
+  if (ms == 0)
+    t.looping = false;
+  else
+    t.stepSeq = schedule(now + ms, EventType::STEP, i);
+}
+
+void ChannelSim::frameStart(Tool &t) {
+  t.frameOn = true;
+  t.frameCollided = false;
+  r.frames++;
+
+  if (activeFrames > 0) {
+    t.frameCollided = true;
+    for (Tool &o : tools)
+      if (o.frameOn)
+        o.frameCollided = true;
+  }
+  activeFrames++;
+  t.frameLost = params.frameLoss > 0 && unit(rng) < params.frameLoss;
+  if (t.frameLost)
+    return;
+  for (int b = 0; b < 4; b++)
+    if (t.code & (1 << b))
+      bitCount[b]++;
+}
+
+void ChannelSim::frameEnd(Tool &t) {
+  t.frameOn = false;
+  if (t.frameCollided)
+    r.collided++;
+  else if (t.frameLost)
+    r.lost++;
+  activeFrames--;
+  if (t.frameLost)
+    return;
+  for (int b = 0; b < 4; b++)
+    if (t.code & (1 << b))
+      bitCount[b]--;
+}
+
+// Move time forward to t one receiver deadline at a time, accounting for the
+// collector's state over each step and noting when it starts and stops.
+void ChannelSim::advance(uint64_t t) {
+  while (now < t) {
+    uint64_t step = t;
+    if (receiver.hasDeadline()) {
+      uint32_t untilDeadline = receiver.nextDeadline() - (uint32_t)now;
+      if (untilDeadline < t - now)
+        step = now + untilDeadline;
+    }
+    if (activeFrames > 0)
+      r.busyMs += step - now;
+    if (toolsOn > 0) {
+      r.toolOnMs += step - now;
+      if (!output)
+        r.uncoveredMs += step - now;
+    }
+    else if (output) {
+      r.runOnMs += step - now;
+    }
+    now = step;
+    simAdvanceTo(receiver, (uint32_t)now);
+
+    if (output && !halSimOutput()) {
+      // It was the quiet timeout unless the shutoff deadline came first.
+      uint32_t quiet = receiver.runningCodeReceivedTime + receiver.quietInterval();
+      uint32_t shutoff = receiver.motorStartTime + SHUTOFF_INTERVAL;
+      if (toolsOn > 0) {
+        if (simBefore(quiet, shutoff))
+          r.falseShutoffs++;
+        else
+          r.shutoffs++;
+      }
+    }
+    else if (!output && halSimOutput()) {
+      for (Tool &w : tools) {
+        if (w.waiting) {
+          r.startLatency.add((uint32_t)(now - w.startTime));
+          w.waiting = false;
+        }
+      }
+    }
+    output = halSimOutput();
+  }
+}
+
+void ChannelSim::toolOn(uint16_t i) {
+  Tool &t = tools[i];
+  t.on = true;
+  toolsOn++;
+  halSimSetTrigger(true);
+  t.tx.readTrigger();
+  if (!output) {
+    t.waiting = true;
+    t.startTime = now;
+  }
+  if (!t.looping) {
+    t.looping = true;
+    step(i);
+  }
+}
+
+void ChannelSim::toolOff(uint16_t i) {
+  Tool &t = tools[i];
+  t.on = false;
+  t.waiting = false;
+  toolsOn--;
+  halSimSetTrigger(false);
+  t.tx.readTrigger();
+  // The firmware cuts a running gap short to send its STOPPED codes.
+  if (t.tx.isStopPending())
+    t.stepSeq = schedule(now, EventType::STEP, i);
+}
+
+Result ChannelSim::run(uint64_t endTime) {
+  r.tools = tools.size();
+  halSimSetMillis(0);
+  halSimSetCodeInputs(0);
+  receiver.adaptiveQuiet = params.adaptiveQuiet;
+  receiver.complementFrames = params.complement;
+  receiver.frameTime = params.widthCheck ? params.frameTime : 0;
+  receiver.begin();
+
+  for (uint16_t i = 0; i < tools.size(); i++) {
+    if (params.ids)
+      tools[i].tx.id = i % MAX_TOOLS;
+    if (!params.sameSeed)
+      tools[i].tx.seed((params.seed * 1000003 + i) * 2654435761UL);
+    tools[i].tx.backoff = params.backoff;
+    tools[i].tx.complement = params.complement;
+    tools[i].tx.frameTime = params.frameTime;
+    if (i % params.strip == 0)
+      schedule((uint64_t)offTime(rng), EventType::TOOL_ON, i);
+  }
+
+  while (!events.empty() && events.top().time < endTime) {
+    Event e = events.top();
+    events.pop();
+    advance(e.time);
+
+    // Switching events go to the first tool of a strip, and switch them all.
+    uint16_t last = std::min<size_t>(e.tool + params.strip, tools.size());
+    switch (e.type) {
+      case EventType::TOOL_ON:
+        for (uint16_t i = e.tool; i < last; i++)
+          toolOn(i);
+        schedule(now + 1 + (uint64_t)onTime(rng), EventType::TOOL_OFF, e.tool);
+        break;
+
+      case EventType::TOOL_OFF:
+        for (uint16_t i = e.tool; i < last; i++)
+          toolOff(i);
+        schedule(now + 1 + (uint64_t)offTime(rng), EventType::TOOL_ON, e.tool);
+        break;
+
+      case EventType::STEP:
+        if (e.seq == tools[e.tool].stepSeq)
+          step(e.tool);
+        break;
+    }
+  }
+
+  advance(endTime);
+  r.overflows = receiver.queue.overflows();
+  return r;
+}
+
+int main(int argc, char **argv) {
+  Params p;
+  p.days = argc > 1 ? atof(argv[1]) : 7;
+  unsigned maxTools = argc > 2 ? strtoul(argv[2], NULL, 0) : 64;
+  p.meanOn = (argc > 3 ? atof(argv[3]) : 60) * 1000;
+  p.meanOff = (argc > 4 ? atof(argv[4]) : 900) * 1000;
+  unsigned threads = argc > 5 ? strtoul(argv[5], NULL, 0) : std::thread::hardware_concurrency();
+  p.seed = argc > 6 ? strtoul(argv[6], NULL, 0) : 1;
+  p.ids = argc > 7 ? atoi(argv[7]) != 0 : false;
+  p.sameSeed = argc > 8 ? atoi(argv[8]) != 0 : false;
+  p.backoff = argc > 9 ? atoi(argv[9]) != 0 : false;
+  p.strip = argc > 10 ? strtoul(argv[10], NULL, 0) : 1;
+  if (p.strip == 0)
+    p.strip = 1;
+  p.adaptiveQuiet = argc > 11 ? atoi(argv[11]) != 0 : false;
+  p.complement = argc > 12 ? atoi(argv[12]) != 0 : false;
+  p.frameTime = argc > 13 ? strtoul(argv[13], NULL, 0) : BIT_ON_TIME;
+  if (p.frameTime < BIT_ON_TIME_MIN)
+    p.frameTime = BIT_ON_TIME_MIN;
+  p.widthCheck = argc > 14 ? atoi(argv[14]) != 0 : false;
+  p.frameLoss = argc > 15 ? atof(argv[15]) : 0;
+  if (threads == 0)
+    threads = 1;
+
+  uint64_t endTime = (uint64_t)(p.days * 86400000.0);
+  std::vector<Result> results(maxTools);
+  std::atomic<unsigned> next(0);
+
+  auto wallStart = std::chrono::steady_clock::now();
+
+  // Largest N first, so the long runs don't end up last on one core.
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < threads; i++) {
+    pool.emplace_back([&]() {
+      unsigned k;
+      while ((k = next++) < maxTools) {
+        unsigned n = maxTools - k;
+        ChannelSim sim(n, p);
+        results[n - 1] = sim.run(endTime);
+      }
+    });
+  }
+  for (std::thread &t : pool)
+    t.join();
+
+  auto wallEnd = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(wallEnd - wallStart).count();
+
+  printf("%.1f simulated days per N, mean on %.0f s, mean off %.0f s%s%s%s",
+    p.days, p.meanOn / 1000, p.meanOff / 1000, p.ids ? ", with IDs" : "",
+    p.sameSeed ? ", same seed" : "", p.backoff ? ", backoff" : "");
+  if (p.adaptiveQuiet)
+    printf(", adaptive quiet timeout");
+  if (p.complement)
+    printf(", complement frames");
+  if (p.strip > 1)
+    printf(", switched %u at a time", p.strip);
+  printf(", %u ms frames%s", p.frameTime, p.widthCheck ? ", pulse width check" : "");
+  if (p.frameLoss > 0)
+    printf(", %.1f%% of frames lost", 100 * p.frameLoss);
+  printf("\n%5s %10s %7s %8s %9s %8s %8s %8s %9s %9s %9s %9s %9s %7s %8s\n",
+    "tools", "frames", "busy", "collide", "deliv/min", "corrupt", "accepted", "widthrej",
+    "start", "start max", "falseoff", "shutoff", "uncovered", "runon", "overflow");
+  for (const Result &r : results) {
+    double startMean = r.startLatency.count ? (double)r.startLatency.sum / r.startLatency.count : 0;
+    printf("%5u %10llu %7.4f %8.5f %9.2f %8.5f %8llu %8llu %7.0fms %7ums %9.2f %9.2f %9.5f %7.1f %8u\n",
+      r.tools,
+      (unsigned long long)r.frames,
+      (double)r.busyMs / endTime,
+      r.frames ? (double)r.collided / r.frames : 0,
+      r.toolOnMs ? (r.frames - r.collided - r.lost) * 60000.0 / r.toolOnMs : 0,
+      r.decodes ? (double)r.corrupted / r.decodes : 0,
+      (unsigned long long)r.accepted,
+      (unsigned long long)r.widthRejected,
+      startMean,
+      r.startLatency.count ? r.startLatency.max : 0,
+      r.falseShutoffs / p.days,
+      r.shutoffs / p.days,
+      r.toolOnMs ? (double)r.uncoveredMs / r.toolOnMs : 0,
+      r.runOnMs / 60000.0 / p.days,
+      r.overflows);
+  }
+  printf("wall %.2f s on %u threads\n", seconds, threads);
+  return 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * Scores assignments of the 4-bit codes under the OR-collision model: two
+ * frames on the air together reach the receiver as the bitwise OR of their
+ * codes, since each bit is on if either transmitter keys it. Each collision
+ * ends one of three ways:
+ *   captured  the OR is one of the two codes (the other's bits are a subset),
+ *             so one frame gets through as sent
+ *   lost      the OR is a code the receiver ignores; both frames are lost
+ *   misread   the OR is some other code the receiver acts on: a false
+ *             STARTING or RUNNING that can start the collector or hold it on,
+ *             or a wrong ID symbol that registers a tool that isn't there
+ * A false STARTING or RUNNING only does harm when neither frame came from a
+ * tool that is running (the collector is on for it anyway), so only those
+ * and wrong ID symbols count as harmful. An assignment costs its harmful
+ * misreads plus lostWeight for each frame lost, summed over traffic with IDs
+ * and without, as an installation may run either way.
+ *
+ * Collisions are weighted by traffic: per tool run of meanOn seconds, the
+ * transmitter's STARTUP_CODE_COUNT STARTING frames, a RUNNING frame per mean
+ * interval after them, and STOPPED_CODE_COUNT STOPPED frames; with IDs each
+ * is followed by the two ID symbols of a tool ID drawn evenly from
+ * MAX_TOOLS, so the high symbol is only ever ID_0 to ID_3. Keyfob presses
+ * are too rare to count.
+ *
+ * The keyfob codes are fixed by the keyfob (one bit each, TOOL_STOPPED
+ * sharing button D), and a single bit can't be forged by a collision, so
+ * only STARTING, RUNNING and the ID symbols move. Both codes must leave room
+ * for complement frames: the complement of each must be sendable (not
+ * NONE), and do nothing if it arrives alone (not START, STOP, TOOL_STOPPED
+ * or the other tool code; button C has no function). The ID symbols are searched as the four that can be
+ * high symbols and the four that can't, as symbols within each group
+ * score alike.
+ *
+ * Prints the current assignment (codes.h) and the best found with the
+ * collisions behind most of the traffic with IDs and how each lands, then the
+ * next best. The exit status is 1 if codes.h isn't the best.
+ *
+ * Usage: program [meanOnSeconds] [lostWeight] [top]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "codes.h"
+#include "transmitter.h"
+
+const uint16_t KEYFOB_CODES = (1 << 0b0001) | (1 << 0b0010) | (1 << 0b1000);
+
+enum Role : uint8_t { ROLE_STARTING, ROLE_RUNNING, ROLE_STOPPED, ROLE_ID_0, ROLE_COUNT = ROLE_ID_0 + 8 };
+
+static const char *ROLE_NAMES[ROLE_COUNT] = {
+  "STARTING", "RUNNING", "STOPPED",
+  "ID_0", "ID_1", "ID_2", "ID_3", "ID_4", "ID_5", "ID_6", "ID_7",
+};
+
+struct Assignment {
+  uint8_t code[ROLE_COUNT];
+
+  // Role of each code value, or -1 for codes the receiver ignores.
+  void roles(int8_t (&of)[16]) const {
+    for (int8_t &r : of)
+      r = -1;
+    for (uint8_t r = 0; r < ROLE_COUNT; r++)
+      of[code[r]] = r;
+  }
+};
+
+// Per collision, under one traffic mix.
+struct Score {
+  double misread = 0;    // Fractions of collisions
+  double harmful = 0;    // Misreads that do harm
+  double lost = 0;       // Frames lost, of the two
+  double captured = 0;
+
+  double cost(double lostWeight) const { return harmful + lostWeight * lost / 2; }
+};
+
+// Share of frames by role, and the chance that a frame of each role comes
+// from a tool still running.
+struct Traffic {
+  double share[ROLE_COUNT] = {};
+  double running[ROLE_COUNT] = {};
+};
+
+Traffic traffic(double meanOnMs, bool ids) {
+  Traffic t;
+  double meanInterval = (INTERVAL_MIN + INTERVAL_MAX) / 2.0;
+  double running = meanOnMs / meanInterval - STARTUP_CODE_COUNT;
+  t.share[ROLE_STARTING] = STARTUP_CODE_COUNT;
+  t.share[ROLE_RUNNING] = running > 0 ? running : 0;
+  t.share[ROLE_STOPPED] = STOPPED_CODE_COUNT;
+  double codes = t.share[ROLE_STARTING] + t.share[ROLE_RUNNING] + t.share[ROLE_STOPPED];
+  if (ids) {
+    // High symbols come from ID_0 to ID_3, low ones from all eight.
+    for (uint8_t i = 0; i < 8; i++)
+      t.share[ROLE_ID_0 + i] = codes * ((i < 4 ? 1 / 4.0 : 0) + 1 / 8.0);
+  }
+  t.running[ROLE_STARTING] = 1;
+  t.running[ROLE_RUNNING] = 1;
+  for (uint8_t i = 0; i < 8; i++)
+    t.running[ROLE_ID_0 + i] = 1 - t.share[ROLE_STOPPED] / codes;
+  double total = 0;
+  for (double s : t.share)
+    total += s;
+  for (double &s : t.share)
+    s /= total;
+  return t;
+}
+
+Score score(const Assignment &a, const Traffic &t) {
+  int8_t role[16];
+  a.roles(role);
+  Score s;
+  for (uint8_t i = 0; i < ROLE_COUNT; i++) {
+    for (uint8_t j = 0; j < ROLE_COUNT; j++) {
+      double p = t.share[i] * t.share[j];
+      uint8_t x = a.code[i], y = a.code[j];
+      uint8_t c = x | y;
+      if (x == y) {
+        s.captured += p;
+      }
+      else if (c == x || c == y) {
+        s.captured += p;
+        s.lost += p;
+      }
+      else {
+        s.lost += 2 * p;
+        if (role[c] >= 0) {
+          // A false tool code does no harm while a tool is running anyway.
+          s.misread += p;
+          if (role[c] >= ROLE_ID_0)
+            s.harmful += p;
+          else
+            s.harmful += p * (1 - t.running[i]) * (1 - t.running[j]);
+        }
+      }
+    }
+  }
+  return s;
+}
+
+Assignment current() {
+  Assignment a;
+  a.code[ROLE_STARTING] = (uint8_t)Code::TOOL_STARTING;
+  a.code[ROLE_RUNNING] = (uint8_t)Code::TOOL_RUNNING;
+  a.code[ROLE_STOPPED] = (uint8_t)Code::TOOL_STOPPED;
+  for (uint8_t i = 0; i < 8; i++)
+    a.code[ROLE_ID_0 + i] = (uint8_t)idSymbol(i);
+  return a;
+}
+
+// A tool code whose complement is a frame of its own that means nothing alone.
+bool complementSafe(uint8_t code, uint8_t other) {
+  uint8_t complement = ~code & (uint8_t)Code::MASK;
+  return complement != 0 && !(KEYFOB_CODES & (1 << complement)) && complement != other;
+}
+
+// Each assignment is scored under both traffic mixes, as an installation
+// may run with IDs or without.
+struct Ranked {
+  Assignment a;
+  Score withIds, without;
+  double cost;
+};
+
+Ranked rank(const Assignment &a, const Traffic &withIds, const Traffic &without, double lostWeight) {
+  Ranked r{a, score(a, withIds), score(a, without), 0};
+  r.cost = r.withIds.cost(lostWeight) + r.without.cost(lostWeight);
+  return r;
+}
+
+std::vector<Ranked> search(const Traffic &withIds, const Traffic &without, double lostWeight) {
+  std::vector<Ranked> all;
+  // Codes with two or more bits; collisions can forge nothing else.
+  std::vector<uint8_t> multi;
+  for (uint8_t c = 1; c < 16; c++)
+    if (__builtin_popcount(c) >= 2)
+      multi.push_back(c);
+
+  for (uint8_t starting : multi) {
+    for (uint8_t running : multi) {
+      if (running == starting || !complementSafe(starting, running) || !complementSafe(running, starting))
+        continue;
+      std::vector<uint8_t> rest;
+      for (uint8_t c : multi)
+        if (c != starting && c != running)
+          rest.push_back(c);
+      // Nine codes left: one unused, four high-capable symbols, four others.
+      unsigned n = rest.size();
+      for (unsigned unused = 0; unused < n; unused++) {
+        std::vector<uint8_t> symbols;
+        for (unsigned k = 0; k < n; k++)
+          if (k != unused)
+            symbols.push_back(rest[k]);
+        for (unsigned mask = 0; mask < (1u << symbols.size()); mask++) {
+          if (__builtin_popcount(mask) != 4)
+            continue;
+          Assignment a;
+          a.code[ROLE_STARTING] = starting;
+          a.code[ROLE_RUNNING] = running;
+          a.code[ROLE_STOPPED] = (uint8_t)Code::TOOL_STOPPED;
+          uint8_t high = 0, low = 4;
+          for (unsigned k = 0; k < symbols.size(); k++)
+            a.code[ROLE_ID_0 + ((mask >> k) & 1 ? high++ : low++)] = symbols[k];
+          all.push_back(rank(a, withIds, without, lostWeight));
+        }
+      }
+    }
+  }
+  std::stable_sort(all.begin(), all.end(),
+                   [](const Ranked &x, const Ranked &y) { return x.cost < y.cost - 1e-12; });
+  return all;
+}
+
+void printCode(uint8_t c) {
+  for (int b = 3; b >= 0; b--)
+    putchar(c >> b & 1 ? '1' : '0');
+}
+
+void printScore(const char *mix, const Score &s) {
+  printf("  %-11s misread %.4f (harmful %.4f), frames lost %.4f, captured %.4f\n",
+         mix, s.misread, s.harmful, s.lost / 2, s.captured);
+}
+
+void printAssignment(const char *title, const Ranked &r) {
+  printf("%s: cost %.4f\n", title, r.cost);
+  printScore("with IDs", r.withIds);
+  printScore("without", r.without);
+  for (uint8_t k = 0; k < ROLE_COUNT; k++) {
+    printf("  %-8s ", ROLE_NAMES[k]);
+    printCode(r.a.code[k]);
+    putchar(k % 4 == 2 || k == ROLE_COUNT - 1 ? '\n' : ' ');
+  }
+}
+
+// The collisions behind most of the traffic, and where each lands.
+void printCollisions(const Assignment &a, const Traffic &t) {
+  struct Pair {
+    uint8_t i, j;
+    double p;
+  };
+  std::vector<Pair> pairs;
+  for (uint8_t i = 0; i < ROLE_COUNT; i++)
+    for (uint8_t j = i; j < ROLE_COUNT; j++)
+      if (t.share[i] > 0 && t.share[j] > 0)
+        pairs.push_back(Pair{i, j, t.share[i] * t.share[j] * (i == j ? 1 : 2)});
+  std::sort(pairs.begin(), pairs.end(), [](const Pair &x, const Pair &y) { return x.p > y.p; });
+
+  int8_t role[16];
+  a.roles(role);
+  double shown = 0;
+  for (const Pair &pr : pairs) {
+    if (shown > 0.9)
+      break;
+    shown += pr.p;
+    uint8_t x = a.code[pr.i], y = a.code[pr.j], c = x | y;
+    printf("    %6.2f%%  %-8s | %-8s = ", pr.p * 100, ROLE_NAMES[pr.i], ROLE_NAMES[pr.j]);
+    printCode(c);
+    if (c == x || c == y)
+      printf("  captured\n");
+    else if (role[c] < 0)
+      printf("  lost\n");
+    else
+      printf("  misread as %s\n", ROLE_NAMES[role[c]]);
+  }
+}
+
+int main(int argc, char **argv) {
+  double meanOn = (argc > 1 ? atof(argv[1]) : 60) * 1000;
+  double lostWeight = argc > 2 ? atof(argv[2]) : 0.5;
+  unsigned top = argc > 3 ? strtoul(argv[3], NULL, 0) : 5;
+
+  Traffic withIds = traffic(meanOn, true);
+  Traffic without = traffic(meanOn, false);
+  printf("Tool runs of %.0f s, a lost frame costing %.2f of a harmful misread\n\n",
+         meanOn / 1000, lostWeight);
+
+  Ranked now = rank(current(), withIds, without, lostWeight);
+  printAssignment("codes.h", now);
+  printCollisions(now.a, withIds);
+
+  std::vector<Ranked> ranked = search(withIds, without, lostWeight);
+  printf("\n%zu complement-safe assignments\n\n", ranked.size());
+  printAssignment("best", ranked[0]);
+  printCollisions(ranked[0].a, withIds);
+  for (unsigned k = 1; k < top && k < ranked.size(); k++) {
+    putchar('\n');
+    char title[16];
+    snprintf(title, sizeof(title), "#%u", k + 1);
+    printAssignment(title, ranked[k]);
+  }
+
+  return ranked[0].cost < now.cost - 1e-12 ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * Host check of the receiver's tick debouncer (debounce.h) against the pin
+ * change path it replaces in debounced builds (env:receiverdebounce).
+ *
+ * Glitch rejection: synthetic traces of frames, each a valid multi-bit code
+ * held for BIT_ON_TIME with a random gap after it, each line rising and
+ * falling up to skew late, and glitches on every line (the level flipped for
+ * up to the glitch width) at random, at least GLITCH_SPACING_US apart. The
+ * trace is read both ways:
+ *   pin change  each edge is a sample, decoded once it has held for
+ *               SETTLE_INTERVAL, as Receiver::settle() does
+ *   debounced   sampled every TICK_US by InputDebouncer
+ * and every decoded code is matched against the frames: right (the frame's
+ * own code, first time), wrong (anything else: a glitch, a partial code, a
+ * repeat) or, for frames never decoded, missed.
+ *
+ * Cost: nanoseconds per tick of InputDebouncer::sample() over a noisy
+ * trace, against a debouncer with a counter per line doing the same job.
+ * The firmware's own cycles per tick are TIM1_COMPA in env:simbench, run on
+ * the env:receiverdebounce ELF.
+ *
+ * Exit status is the number of rows where the debouncer got a code wrong or
+ * missed a frame, among those it should handle: lines settling within a tick
+ * of each other, and glitches under a tick, so one touches one sample. Wider
+ * glitches never make a code of their own, but can hold a changing line back
+ * past DEBOUNCE_HOLD_TICKS.
+ *
+ * Usage: program [frames] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "codes.h"
+#include "debounce.h"
+#include "receiver.h"
+#include "transmitter.h"
+
+const uint32_t STEP_US = 50;         // Trace resolution
+const uint32_t TICK_US = 2048;       // RX_CLOCK_TICK_COUNTS of Timer1 at CK/1024
+const uint32_t DECODE_SLACK_MS = 20; // After a frame ends, still its decode
+const uint32_t GLITCH_SPACING_US = 25000;  // Least time between glitches on a line
+
+struct Frame {
+  uint32_t startMs, endMs;
+  uint8_t code;
+  bool decoded;
+};
+
+struct Trace {
+  std::vector<uint8_t> levels;   // Per STEP_US
+  std::vector<Frame> frames;
+};
+
+struct Row {
+  const char *name;
+  double glitchMs;      // Widest glitch
+  double glitchRate;    // Per second per line
+  double skewMs;
+  bool covered;         // Within what the debouncer should get right
+};
+
+struct Tally {
+  unsigned right = 0, wrong = 0, missed = 0;
+};
+
+static const Code FRAME_CODES[] = {
+  Code::TOOL_STARTING, Code::TOOL_RUNNING, Code::TOOL_STOPPED,
+  Code::ID_0, Code::ID_1, Code::ID_2, Code::ID_3,
+  Code::ID_4, Code::ID_5, Code::ID_6, Code::ID_7,
+};
+
+static Trace makeTrace(const Row &row, unsigned frames, std::mt19937 &rng) {
+  std::uniform_int_distribution<unsigned> pick(0, sizeof(FRAME_CODES) / sizeof(FRAME_CODES[0]) - 1);
+  std::uniform_int_distribution<uint32_t> gap(ID_GAP_TIME, INTERVAL_MAX);
+  std::uniform_real_distribution<double> skew(0, row.skewMs * 1000);
+
+  Trace t;
+  uint32_t ms = 100;
+  for (unsigned f = 0; f < frames; f++) {
+    Frame fr{ms, ms + BIT_ON_TIME, (uint8_t)FRAME_CODES[pick(rng)], false};
+    t.frames.push_back(fr);
+    ms = fr.endMs + gap(rng);
+  }
+  size_t steps = (size_t)(ms + 100) * 1000 / STEP_US;
+  t.levels.assign(steps, 0);
+
+  for (const Frame &fr : t.frames) {
+    for (uint8_t b = 0; b < 4; b++) {
+      if (!(fr.code & (1 << b)))
+        continue;
+      size_t on = (size_t)((fr.startMs * 1000.0 + skew(rng)) / STEP_US);
+      size_t off = (size_t)((fr.endMs * 1000.0 + skew(rng)) / STEP_US);
+      for (size_t i = on; i < off && i < steps; i++)
+        t.levels[i] |= 1 << b;
+    }
+  }
+
+  if (row.glitchRate > 0) {
+    std::exponential_distribution<double> between(row.glitchRate / 1e6);
+    std::uniform_real_distribution<double> width(STEP_US, row.glitchMs * 1000);
+    for (uint8_t b = 0; b < 4; b++) {
+      for (double us = between(rng); us < steps * (double)STEP_US; us += GLITCH_SPACING_US + between(rng)) {
+        size_t from = (size_t)(us / STEP_US);
+        size_t to = (size_t)((us + width(rng)) / STEP_US);
+        for (size_t i = from; i < to && i < steps; i++)
+          t.levels[i] ^= 1 << b;
+      }
+    }
+  }
+  return t;
+}
+
+// Credit a decoded code to the frame on the air when it was decoded.
+static void match(Trace &t, size_t &next, uint32_t ms, uint8_t code, Tally &tally) {
+  if (code == 0)
+    return;
+  while (next < t.frames.size() && t.frames[next].endMs + DECODE_SLACK_MS < ms)
+    next++;
+  for (size_t f = next; f < t.frames.size() && t.frames[f].startMs <= ms; f++) {
+    Frame &fr = t.frames[f];
+    if (fr.code == code && !fr.decoded && ms <= fr.endMs + DECODE_SLACK_MS) {
+      fr.decoded = true;
+      tally.right++;
+      return;
+    }
+  }
+  tally.wrong++;
+}
+
+static void countMissed(Trace &t, Tally &tally) {
+  for (Frame &fr : t.frames) {
+    if (!fr.decoded)
+      tally.missed++;
+    fr.decoded = false;
+  }
+}
+
+static Tally pinChange(Trace &t) {
+  Tally tally;
+  size_t next = 0;
+  uint8_t inputs = 0;
+  bool settling = false;
+  CodeSample pending = {0, 0};
+  for (size_t i = 0; i < t.levels.size(); i++) {
+    uint32_t ms = (uint32_t)(i * STEP_US / 1000);
+    if (settling && ms - pending.time >= SETTLE_INTERVAL) {
+      settling = false;
+      match(t, next, ms, pending.bits, tally);
+    }
+    if (t.levels[i] != inputs) {
+      inputs = t.levels[i];
+      settling = true;
+      pending = CodeSample{inputs, ms};
+    }
+  }
+  countMissed(t, tally);
+  return tally;
+}
+
+static Tally debounced(Trace &t) {
+  Tally tally;
+  size_t next = 0;
+  InputDebouncer d;
+  for (uint64_t us = 0; us / STEP_US < t.levels.size(); us += TICK_US)
+    if (d.sample(t.levels[us / STEP_US]))
+      match(t, next, (uint32_t)(us / 1000), d.code, tally);
+  countMissed(t, tally);
+  return tally;
+}
+
+// The same job with a sample counter per line, for the cost comparison.
+struct PerLineDebouncer {
+  uint8_t lines = 0;
+  uint8_t count[4] = {0, 0, 0, 0};
+  uint8_t hold = 0;
+  uint8_t code = 0;
+
+  bool sample(uint8_t raw) {
+    bool toggled = false;
+    for (uint8_t b = 0; b < 4; b++) {
+      uint8_t bit = 1 << b;
+      if ((raw ^ lines) & bit) {
+        if (++count[b] == DEBOUNCE_SAMPLES) {
+          lines ^= bit;
+          count[b] = 0;
+          toggled = true;
+        }
+      }
+      else {
+        count[b] = 0;
+      }
+    }
+    if (toggled) {
+      hold = 0;
+      return false;
+    }
+    if (hold < DEBOUNCE_HOLD_TICKS)
+      hold++;
+    if (hold < DEBOUNCE_HOLD_TICKS || lines == code)
+      return false;
+    code = lines;
+    return true;
+  }
+};
+
+template <typename Debouncer>
+static double nsPerTick(const std::vector<uint8_t> &samples, unsigned &changes) {
+  const unsigned REPEATS = 20;
+  Debouncer d;
+  changes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned r = 0; r < REPEATS; r++)
+    for (uint8_t s : samples)
+      changes += d.sample(s);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / ((double)REPEATS * samples.size());
+}
+
+int main(int argc, char **argv) {
+  unsigned frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000;
+  unsigned long seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+
+  const double TICK_MS = TICK_US / 1000.0;
+  const Row rows[] = {
+    {"clean",          0,   0,   0,   true},
+    {"skew",           0,   0,   0.2, true},
+    {"skew",           0,   0,   1.5, true},
+    {"skew",           0,   0,   4,   false},
+    {"glitch",         0.5, 1,   0.2, true},
+    {"glitch",         1.5, 1,   0.2, true},
+    {"glitch",         5,   1,   0.2, false},
+    {"glitch",         5,   10,  0.2, false},
+    {"glitch",         10,  1,   0.2, false},
+    {"glitch+skew",    1.5, 1,   1.5, true},
+    {"glitch+skew",    1.5, 5,   1.5, true},
+  };
+
+  printf("%u frames per row, tick %.3f ms, %u samples to change, hold %u ticks\n\n",
+         frames, TICK_MS, DEBOUNCE_SAMPLES, DEBOUNCE_HOLD_TICKS);
+  printf("%-12s %7s %7s %6s   %17s   %17s\n", "", "glitch", "per s", "skew",
+         "pin change", "debounced");
+  printf("%-12s %7s %7s %6s   %5s %5s %5s   %5s %5s %5s\n", "", "ms", "", "ms",
+         "right", "wrong", "miss", "right", "wrong", "miss");
+
+  int failures = 0;
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> noisy;
+  for (const Row &row : rows) {
+    Trace t = makeTrace(row, frames, rng);
+    Tally p = pinChange(t);
+    Tally d = debounced(t);
+    bool failed = row.covered && (d.wrong > 0 || d.missed > 0);
+    failures += failed;
+    printf("%-12s %7.1f %7.1f %6.1f   %5u %5u %5u   %5u %5u %5u%s\n",
+           row.name, row.glitchMs, row.glitchRate, row.skewMs,
+           p.right, p.wrong, p.missed, d.right, d.wrong, d.missed,
+           failed ? "  FAIL" : row.covered ? "" : "  (beyond the debouncer)");
+    if (row.glitchRate >= 10)
+      for (uint64_t us = 0; us / STEP_US < t.levels.size(); us += TICK_US)
+        noisy.push_back(t.levels[us / STEP_US]);
+  }
+
+  unsigned vertical, perLine;
+  double v = nsPerTick<InputDebouncer>(noisy, vertical);
+  double l = nsPerTick<PerLineDebouncer>(noisy, perLine);
+  printf("\nper tick, %zu noisy samples: vertical counters %.2f ns, per-line counters %.2f ns%s\n",
+         noisy.size(), v, l, vertical == perLine ? "" : " (DISAGREE)");
+  if (vertical != perLine)
+    failures++;
+  return failures;
+}
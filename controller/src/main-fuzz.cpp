@@ -0,0 +1,308 @@
+/*
+ * Coverage-guided fuzzing harness for the receiver state machine, its
+ * timeouts and the input paths in front of it.
+ *
+ * An input is a flags byte, then pairs of an operation and its argument:
+ * inputs set to a 4-bit value, the clock advanced by up to 261 s, or frames
+ * played as a transmitter would (a code alone, a code and its ID, a code and
+ * its complement), or a tool code given to the state machine up to 16 times,
+ * 1.5 to 4.5 s apart, so runs can reach SHUTOFF_INTERVAL in three
+ * operations. The flags choose complement frames, the adaptive quiet
+ * timeout, tick-debounced inputs (onTick()) instead of pin changes, a clock
+ * that wraps during the run, the pulse width check for BIT_ON_TIME frames,
+ * and no run-on after a tool stops (stoppedRunOn 0). Time moves as in
+ * sim.cpp: the receiver's loop runs at each of its deadlines, and at each
+ * timer tick in debounced mode, and after every pass these must hold:
+ *   - the output is on exactly when the state isn't OFF
+ *   - OFF has no quiet or shutoff timeout pending, and a running collector
+ *     has both
+ *   - no run outlasts SHUTOFF_INTERVAL from the output switching on
+ *   - no run outlasts the longest quiet timeout after the inputs last changed,
+ *     give or take the time a code takes to be decoded
+ *   - the starts counter matches the starts seen on the output
+ * A broken one aborts with the reason, which libFuzzer reports as a crash and
+ * saves the input.
+ *
+ * With libFuzzer (clang only), e.g. from src:
+ *   clang++ -std=gnu++17 -O2 -g -fsanitize=fuzzer,address,undefined -DLIBFUZZER \
+ *     -o fuzz main-fuzz.cpp codes.cpp receiver.cpp tooltable.cpp transitions.cpp \
+ *     hal-native.cpp stats.cpp runlog.cpp
+ *   ./fuzz -max_len=32 -fork=$(nproc) corpus/
+ * Built without LIBFUZZER (env:fuzz), the same checks run on random inputs,
+ * or on the files given, such as crashes libFuzzer saved, and executions per
+ * second are reported.
+ *
+ * Throughput is set by the operations, not by the harness: each runs the
+ * receiver's loop at every deadline and tick it passes, and none runs it more
+ * than a few dozen times, about 0.3 us per operation on random inputs. Per
+ * core, random inputs of up to 8 bytes run at about 2M a second, 16 at 800k,
+ * 32 at 350-450k and 64 at 220k, so millions a second at 32 bytes takes
+ * -fork across several cores. 32 bytes is 15 operations, enough for every
+ * state and timeout, so that is the default length here and the suggested
+ * -max_len.
+ *
+ * Usage: program [iterations] [seed] [maxLength]
+ *        program file...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "codes.h"
+#include "debounce.h"
+#include "hal.h"
+#include "receiver.h"
+#include "sim.h"
+#include "transmitter.h"
+
+const uint8_t FLAG_COMPLEMENT = 0x01;
+const uint8_t FLAG_ADAPTIVE_QUIET = 0x02;
+const uint8_t FLAG_DEBOUNCED = 0x04;
+const uint8_t FLAG_WRAP = 0x08;
+const uint8_t FLAG_PULSE_WIDTH = 0x10;
+const uint8_t FLAG_NO_RUN_ON = 0x20;
+
+const uint32_t TICK_MS = 2;  // Timer1's 2.048 ms tick, near enough
+// Gaps between repeated tool codes, all shorter than any quiet timeout.
+static const uint16_t REPEAT_PERIODS[4] = {1500, 2500, 3500, 4500};
+
+static const Code TOOL_CODES[4] = {Code::TOOL_STARTING, Code::TOOL_RUNNING, Code::TOOL_STOPPED, Code::START};
+
+class FuzzRun {
+  public:
+    const char *failure = NULL;
+
+    FuzzRun(uint8_t flags) : debounced(flags & FLAG_DEBOUNCED) {
+      halSimSetMillis(flags & FLAG_WRAP ? UINT32_MAX - 60000 : 0);
+      halSimSetCodeInputs(0);
+      halOutputOff();
+      receiver.complementFrames = flags & FLAG_COMPLEMENT;
+      receiver.adaptiveQuiet = flags & FLAG_ADAPTIVE_QUIET;
+      receiver.frameTime = flags & FLAG_PULSE_WIDTH ? BIT_ON_TIME : 0;
+      receiver.stoppedRunOn = flags & FLAG_NO_RUN_ON ? 0 : STOPPED_RUN_ON;
+      // Longest a code can take from the inputs changing to newInput():
+      // settling, or the pulse width check, and the debouncer first.
+      decodeMs = (debounced ? DEBOUNCE_LATENCY_MS : 0) +
+                 (receiver.frameTime != 0 ? receiver.pulseWidthMin() : SETTLE_INTERVAL);
+      receiver.begin();
+      inputsChanged = halMillis();
+      nextTick = halMillis() + TICK_MS;
+    }
+
+    void op(uint8_t code, uint8_t arg) {
+      switch (code & 7) {
+        case 0:
+          setInputs(arg);
+          break;
+        case 1:
+          // A tool code up to 16 times, straight into the state machine as
+          // if decoded, which is much cheaper. Each repeat costs a pass of
+          // the receiver's loop or two, so the count is kept short and the
+          // gap between them, from the operation's high bits, stretches it.
+          for (uint8_t n = 0; n <= (arg >> 2 & 15) && !failure; n++) {
+            inputsChanged = halMillis();
+            receiver.newInput(TOOL_CODES[arg & 3]);
+            check();
+            advance(REPEAT_PERIODS[code >> 3 & 3]);
+          }
+          break;
+        case 2:
+          advance(arg);
+          break;
+        case 3:
+          advance(arg * 32);
+          break;
+        case 4:
+          advance(arg * 1024);
+          break;
+        case 5:
+          frame((Code)(arg & 0xF), arg >> 4);
+          break;
+        case 6: {
+          uint8_t id = arg >> 2;
+          frame(TOOL_CODES[arg & 3], 0);
+          frame(idSymbol(id >> 3 & 7), 0);
+          frame(idSymbol(id & 7), 0);
+          break;
+        }
+        case 7:
+          frame((Code)(arg & 0xF), 0);
+          frame(complementOf((Code)(arg & 0xF)), arg >> 4);
+          break;
+      }
+    }
+
+  private:
+    Receiver receiver;
+    bool debounced;
+    uint32_t decodeMs;
+    bool output = false;
+    uint32_t onTime = 0;
+    uint32_t inputsChanged = 0;
+    uint32_t nextTick = 0;
+    uint16_t starts = 0;
+
+    void setInputs(uint8_t bits) {
+      bits &= (uint8_t)Code::MASK;
+      if (bits == halReadCodeInputs())
+        return;
+      halSimSetCodeInputs(bits);
+      inputsChanged = halMillis();
+      if (!debounced)
+        receiver.onPinChange();
+    }
+
+    // A frame held for BIT_ON_TIME, then gap: ID_GAP_TIME, and longer in
+    // steps of a quarter second.
+    void frame(Code c, uint8_t gap) {
+      setInputs((uint8_t)c);
+      advance(BIT_ON_TIME);
+      setInputs(0);
+      advance(ID_GAP_TIME + gap * 250);
+    }
+
+    // The debouncer is settled when a tick with the inputs as they are would
+    // change nothing, so ticks can be skipped until they next change.
+    bool ticksMatter() const {
+      return debounced && !receiver.debouncer.isSettled(halReadCodeInputs());
+    }
+
+    void advance(uint32_t ms) {
+      uint32_t t = halMillis() + ms;
+      while (!failure) {
+        bool tick = ticksMatter() && simAtOrBefore(nextTick, t);
+        uint32_t deadline = receiver.hasDeadline() ? receiver.nextDeadline() : t + 1;
+        bool due = simAtOrBefore(deadline, t);
+        if (!tick && !due)
+          break;
+        bool tickFirst = tick && (!due || simBefore(nextTick, deadline));
+        uint32_t when = tickFirst ? nextTick : deadline;
+        if (simBefore(halMillis(), when))
+          halSimSetMillis(when);
+        if (tick && when == nextTick) {
+          receiver.onTick();
+          nextTick += TICK_MS;
+          // Most ticks queue nothing, and the firmware's loop() would go
+          // straight back to sleep.
+          if (receiver.queue.isEmpty() && !(due && when == deadline))
+            continue;
+        }
+        receiver.poll();
+        check();
+      }
+      if (simBefore(halMillis(), t))
+        halSimSetMillis(t);
+      // Ticks skipped while the debouncer was settled.
+      if (simAtOrBefore(nextTick, halMillis()))
+        nextTick += ((halMillis() - nextTick) / TICK_MS + 1) * TICK_MS;
+      check();
+    }
+
+    void check() {
+      uint32_t now = halMillis();
+      bool on = halSimOutput();
+      if (on && !output) {
+        onTime = now;
+        starts++;
+      }
+      output = on;
+
+      if (on != receiver.isRunning())
+        failure = "output doesn't match the state";
+      else if (!on && (receiver.timers.isArmed(QUIET_TIMER) || receiver.timers.isArmed(SHUTOFF_TIMER)))
+        failure = "timeout pending while OFF";
+      else if (on && !(receiver.timers.isArmed(QUIET_TIMER) && receiver.timers.isArmed(SHUTOFF_TIMER)))
+        failure = "running without a quiet and shutoff timeout";
+      else if (on && now - onTime > SHUTOFF_INTERVAL + 1)
+        failure = "ran past SHUTOFF_INTERVAL";
+      else if (on && now - inputsChanged > QUIET_INTERVAL + 1 + decodeMs)
+        failure = "ran past the quiet timeout";
+      else if (receiver.stats.counters[STAT_STARTS] != starts && starts < UINT16_MAX)
+        failure = "starts counter doesn't match the output";
+    }
+};
+
+// One input; the reason it failed, or NULL.
+static const char *fuzzOne(const uint8_t *data, size_t size) {
+  if (size < 1)
+    return NULL;
+  FuzzRun run(data[0]);
+  for (size_t i = 1; i + 1 < size && !run.failure; i += 2)
+    run.op(data[i], data[i + 1]);
+  return run.failure;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (const char *failure = fuzzOne(data, size)) {
+    fprintf(stderr, "invariant broken: %s\n", failure);
+    abort();
+  }
+  return 0;
+}
+
+#if !defined(LIBFUZZER)
+
+static bool readFile(const char *path, std::vector<uint8_t> &data) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  data.clear();
+  int c;
+  while ((c = getc(f)) != EOF)
+    data.push_back(c);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strspn(argv[1], "0123456789") != strlen(argv[1])) {
+    int failures = 0;
+    std::vector<uint8_t> data;
+    for (int i = 1; i < argc; i++) {
+      if (!readFile(argv[i], data)) {
+        perror(argv[i]);
+        return 2;
+      }
+      const char *failure = fuzzOne(data.data(), data.size());
+      printf("%s: %s\n", argv[i], failure ? failure : "ok");
+      failures += failure != NULL;
+    }
+    return failures > 0;
+  }
+
+  unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+  unsigned long seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+  std::mt19937 rng(seed);
+  size_t maxLength = argc > 3 ? strtoul(argv[3], NULL, 0) : 32;
+  std::uniform_int_distribution<size_t> length(1, maxLength);
+  std::vector<uint8_t> data;
+  double ops = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iterations; i++) {
+    data.resize(length(rng));
+    ops += (data.size() - 1) / 2;
+    for (uint8_t &b : data)
+      b = rng();
+    if (const char *failure = fuzzOne(data.data(), data.size())) {
+      printf("input %lu: %s, saved to fuzz-crash.bin\n", i, failure);
+      FILE *f = fopen("fuzz-crash.bin", "wb");
+      if (f) {
+        fwrite(data.data(), 1, data.size(), f);
+        fclose(f);
+      }
+      return 1;
+    }
+  }
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("%lu random inputs of up to %zu bytes, no invariant broken, %.0f executions/s, %.0f operations/s\n",
+         iterations, maxLength, iterations / s, ops / s);
+  return 0;
+}
+
+#endif
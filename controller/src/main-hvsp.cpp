@@ -0,0 +1,176 @@
+/*
+ * HVSP programmer service firmware for an Arduino Uno, on the fuse tools'
+ * hardware (pins 8-13, see hvsp.h).
+ *
+ * Replaces the refusenik and readfuses sketches with one firmware driven by
+ * the framed binary protocol in hvspproto.h: signature and fuse reads, fuse
+ * writes, chip erase, and flash and EEPROM page writes verified by readback,
+ * so a fuse-bricked board can be recovered and reprogrammed in one session
+ * without reflashing the Uno. Fuse values come from the host.
+ *
+ * Requests are executed in order as they arrive. The serial receive buffer is
+ * enlarged (SERIAL_RX_BUFFER_SIZE in platformio.ini) so the host can queue
+ * several page writes while the target is busy programming; HVSP_INFO
+ * reports how much it may have outstanding.
+ */
+
+#include <Arduino.h>
+#include "hvsp.h"
+#include "hvspproto.h"
+
+HvspFrameParser request;
+uint8_t reply[HVSP_MAX_PAYLOAD];
+uint8_t frame[HVSP_MAX_FRAME];
+uint8_t verify[HVSP_MAX_PAYLOAD];
+bool entered = false;
+uint8_t pageWords = 0;   // Flash page of the part entered; 0 is unknown
+
+void setup(void);
+void loop(void);
+void respond(uint8_t seq, uint8_t status, uint8_t length);
+uint8_t execute(uint8_t &length);
+
+void setup() {
+  hvspBegin();
+  Serial.begin(HVSP_BAUD);
+}
+
+void loop() {
+  while (Serial.available() > 0) {
+    switch (request.feed(Serial.read())) {
+      case HVSP_FEED_FRAME: {
+        uint8_t length = 0;
+        uint8_t status = execute(length);
+        respond(request.seq, status, status == HVSP_OK ? length : 0);
+        break;
+      }
+
+      case HVSP_FEED_BAD:
+        respond(request.seq, HVSP_BAD_FRAME, 0);
+        break;
+
+      case HVSP_FEED_MORE:
+        break;
+    }
+  }
+}
+
+void respond(uint8_t seq, uint8_t status, uint8_t length) {
+  Serial.write(frame, hvspEncode(frame, seq, status, reply, length));
+}
+
+// Run the request just received. Returns its status, with any reply payload
+// in reply and its size in length.
+uint8_t execute(uint8_t &length) {
+  const uint8_t *p = request.payload;
+  uint8_t n = request.length;
+
+  switch (request.code) {
+    case HVSP_INFO:
+      reply[0] = HVSP_PROTOCOL_VERSION;
+      hvspPut16(reply + 1, SERIAL_RX_BUFFER_SIZE);
+      reply[3] = HVSP_MAX_PAYLOAD;
+      reply[4] = 1;
+      length = 5;
+      return HVSP_OK;
+
+    case HVSP_ENTER: {
+      hvspEnter();
+      entered = true;
+      pageWords = 0;
+      uint16_t sig;
+      if (!hvspReadSignature(sig))
+        return HVSP_TIMEOUT;
+      pageWords = hvspFlashPageWords(sig);
+      hvspPut16(reply, sig);
+      length = 2;
+      return HVSP_OK;
+    }
+
+    case HVSP_EXIT:
+      hvspExit();
+      entered = false;
+      return HVSP_OK;
+
+    default:
+      break;
+  }
+
+  if (request.code < HVSP_READ_SIGNATURE || request.code > HVSP_READ_EEPROM)
+    return HVSP_BAD_COMMAND;
+  if (!entered)
+    return HVSP_NOT_ENTERED;
+
+  switch (request.code) {
+    case HVSP_READ_SIGNATURE: {
+      uint16_t sig;
+      if (!hvspReadSignature(sig))
+        return HVSP_TIMEOUT;
+      hvspPut16(reply, sig);
+      length = 2;
+      return HVSP_OK;
+    }
+
+    case HVSP_READ_FUSES:
+      for (uint8_t f = 0; f < HVSP_FUSES; f++) {
+        if (!hvspReadFuse((HvspFuse)f, reply[f]))
+          return HVSP_TIMEOUT;
+      }
+      if (!hvspReadLock(reply[HVSP_FUSES]))
+        return HVSP_TIMEOUT;
+      length = HVSP_FUSES + 1;
+      return HVSP_OK;
+
+    case HVSP_WRITE_FUSE: {
+      if (n != 2 || p[0] >= HVSP_FUSES)
+        return HVSP_BAD_LENGTH;
+      uint8_t val;
+      if (!hvspWriteFuse((HvspFuse)p[0], p[1]) || !hvspReadFuse((HvspFuse)p[0], val))
+        return HVSP_TIMEOUT;
+      return val == p[1] ? HVSP_OK : HVSP_VERIFY_FAILED;
+    }
+
+    case HVSP_CHIP_ERASE:
+      return hvspChipErase() ? HVSP_OK : HVSP_TIMEOUT;
+
+    case HVSP_WRITE_FLASH: {
+      if (n < 4 || (n & 1))
+        return HVSP_BAD_LENGTH;
+      uint8_t words = (n - 2) / 2;
+      uint16_t addr = hvspGet16(p);
+      if (!hvspWithinPage(addr, words, pageWords))
+        return HVSP_BAD_LENGTH;
+      if (!hvspWriteFlashPage(addr, p + 2, words) || !hvspReadFlash(addr, verify, words))
+        return HVSP_TIMEOUT;
+      return memcmp(verify, p + 2, n - 2) == 0 ? HVSP_OK : HVSP_VERIFY_FAILED;
+    }
+
+    case HVSP_READ_FLASH:
+      if (n != 3 || p[2] == 0 || p[2] > HVSP_MAX_PAYLOAD / 2)
+        return HVSP_BAD_LENGTH;
+      if (!hvspReadFlash(hvspGet16(p), reply, p[2]))
+        return HVSP_TIMEOUT;
+      length = p[2] * 2;
+      return HVSP_OK;
+
+    case HVSP_WRITE_EEPROM: {
+      if (n < 3)
+        return HVSP_BAD_LENGTH;
+      uint16_t addr = hvspGet16(p);
+      if (!hvspWithinPage(addr, n - 2, pageWords ? HVSP_EEPROM_PAGE : 0))
+        return HVSP_BAD_LENGTH;
+      if (!hvspWriteEepromPage(addr, p + 2, n - 2) || !hvspReadEeprom(addr, verify, n - 2))
+        return HVSP_TIMEOUT;
+      return memcmp(verify, p + 2, n - 2) == 0 ? HVSP_OK : HVSP_VERIFY_FAILED;
+    }
+
+    case HVSP_READ_EEPROM:
+      if (n != 3 || p[2] == 0 || p[2] > HVSP_MAX_PAYLOAD)
+        return HVSP_BAD_LENGTH;
+      if (!hvspReadEeprom(hvspGet16(p), reply, p[2]))
+        return HVSP_TIMEOUT;
+      length = p[2];
+      return HVSP_OK;
+  }
+  return HVSP_BAD_COMMAND;
+}
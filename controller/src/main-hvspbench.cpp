@@ -0,0 +1,121 @@
+// HVSP throughput benchmark, on the fuse tools' Uno and target socket.
+//
+// On each character received, powers the target into HVSP mode and times:
+//   no-op instructions (load command 0x00) through the hvsp.cpp engine, and
+//     through the digitalWrite()/digitalRead() shiftOut() the fuse tools used
+//     before it, in microseconds per instruction
+//   a full signature and three-fuse read (17 instructions) through each
+// The target's fuses are only read, never written.
+
+#include <Arduino.h>
+#include "hvsp.h"
+
+const unsigned int NOP_COUNT = 1000;
+const unsigned int READ_COUNT = 100;
+
+// The fuse tools' original bit loop, kept for comparison. It waits on SDO
+// with no timeout, so it only runs once the engine has seen the target.
+byte legacyShiftOut(byte val1, byte val2)
+{
+    int inBits = 0;
+    while (!digitalRead(11))
+        ;
+    unsigned int dout = (unsigned int)val1 << 2;
+    unsigned int iout = (unsigned int)val2 << 2;
+    for (int ii = 10; ii >= 0; ii--)
+    {
+        digitalWrite(9, !!(dout & (1 << ii)));
+        digitalWrite(10, !!(iout & (1 << ii)));
+        inBits <<= 1;
+        inBits |= digitalRead(11);
+        digitalWrite(12, HIGH);
+        digitalWrite(12, LOW);
+    }
+    return inBits >> 2;
+}
+
+void legacyReadAll()
+{
+    for (int ii = 1; ii < 3; ii++)
+    {
+        legacyShiftOut(0x08, 0x4C);
+        legacyShiftOut(ii, 0x0C);
+        legacyShiftOut(0x00, 0x68);
+        legacyShiftOut(0x00, 0x6C);
+    }
+    static const byte instr[3][2] = {{0x68, 0x6C}, {0x7A, 0x7E}, {0x6A, 0x6E}};
+    for (int f = 0; f < 3; f++)
+    {
+        legacyShiftOut(0x04, 0x4C);
+        legacyShiftOut(0x00, instr[f][0]);
+        legacyShiftOut(0x00, instr[f][1]);
+    }
+}
+
+bool readAll()
+{
+    uint16_t sig;
+    uint8_t val;
+    if (!hvspReadSignature(sig))
+        return false;
+    for (uint8_t f = 0; f < HVSP_FUSES; f++)
+        if (!hvspReadFuse((HvspFuse)f, val))
+            return false;
+    return true;
+}
+
+void report(const char *name, unsigned long micros, unsigned int count)
+{
+    Serial.print(name);
+    Serial.print(": ");
+    Serial.print((float)micros / count, 2);
+    Serial.println(" us");
+}
+
+void setup()
+{
+    hvspBegin();
+    Serial.begin(19200);
+    Serial.println("HVSP benchmark. Enter any character to start..");
+}
+
+void loop()
+{
+    if (Serial.available() == 0)
+        return;
+    Serial.read();
+
+    hvspEnter();
+    uint16_t sig;
+    if (!hvspReadSignature(sig))
+    {
+        Serial.println("Target not responding (SDO stuck low)");
+        hvspExit();
+        return;
+    }
+    Serial.print("Signature: ");
+    Serial.println(sig, HEX);
+
+    unsigned long start = micros();
+    for (unsigned int i = 0; i < NOP_COUNT; i++)
+        hvspTransfer(HVSP_CMD_NOP, HVSP_LOAD_COMMAND);
+    report("engine, per instruction", micros() - start, NOP_COUNT);
+
+    start = micros();
+    for (unsigned int i = 0; i < READ_COUNT; i++)
+        readAll();
+    report("engine, signature + fuses", micros() - start, READ_COUNT);
+
+    start = micros();
+    for (unsigned int i = 0; i < NOP_COUNT; i++)
+        legacyShiftOut(HVSP_CMD_NOP, HVSP_LOAD_COMMAND);
+    report("digitalWrite, per instruction", micros() - start, NOP_COUNT);
+
+    start = micros();
+    for (unsigned int i = 0; i < READ_COUNT; i++)
+        legacyReadAll();
+    report("digitalWrite, signature + fuses", micros() - start, READ_COUNT);
+
+    hvspExit();
+    Serial.println("");
+}
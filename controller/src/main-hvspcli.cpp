@@ -0,0 +1,472 @@
+/*
+ * Command-line client for the HVSP programmer firmware (env:hvsp).
+ *
+ * Talks the protocol in hvspproto.h over a serial port, keeping as many
+ * requests in flight as the programmer's receive buffer allows (HVSP_INFO).
+ * Flash images are Intel HEX; an environment name stands for PlatformIO's
+ * .pio/build/<env>/firmware.hex. Flash is erased, written page by page
+ * (each page verified by the programmer), then read back and compared here.
+ * Write and verify rates are reported in bytes per second.
+ *
+ * Against a gang programmer (env:hvspgang) everything happens on all its
+ * sockets at once, and results are reported per socket: a socket that is
+ * empty, times out, fails a verify or holds a different part from the rest
+ * is reported and the others carry on. The programmer's per-page verify is
+ * the only one, since reading every socket back would take longer than
+ * writing them all. Flash programming also reports chips per minute.
+ *
+ * The device emu[:part[:sockets]] runs the programmer emulator (hvspemu.h) on
+ * a pty in this process instead, paced like the hardware unless -f is given,
+ * so the whole path can be tested and benchmarked without a programmer.
+ * sockets has a character per socket, 1 for a chip, 0 for an empty socket
+ * and x for a faulty part, and more than one makes it a gang. bench writes a
+ * random image the size of the part's flash, and against the emulator also
+ * checks that every good target ends up holding it.
+ *
+ * dump reads all of EEPROM back into an Intel HEX file, from one socket; the
+ * receiver's run log (env:runlog) is read from such a dump.
+ *
+ * Options:
+ *   -1   one request at a time, for comparison with the pipelined rate
+ *   -f   emulator runs as fast as it can instead of at hardware speed
+ *
+ * Usage: program [-1] [-f] device info
+ *        program [-1] [-f] device fuses
+ *        program [-1] [-f] device fuse l|h|e value
+ *        program [-1] [-f] device erase
+ *        program [-1] [-f] device flash file.hex|env
+ *        program [-1] [-f] device eeprom file.hex
+ *        program [-1] [-f] device dump file.hex
+ *        program [-1] [-f] device bench [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hvspproto.h"
+#include "hvsphost.h"
+#include "hvspemu.h"
+#include "ihex.h"
+
+struct Request {
+  uint8_t code;
+  std::vector<uint8_t> payload;
+};
+
+static HvspClient client;
+static const HvspPart *part = NULL;
+
+// Sockets on the programmer, and each one's first failure. A gang socket
+// holding another part than the first one found is failed here.
+const uint8_t WRONG_PART = 0xFF;
+static uint8_t sockets = 1;
+static std::vector<uint8_t> socketStatus;
+
+static const char *socketStatusName(uint8_t status) {
+  return status == WRONG_PART ? "wrong part" : hvspStatusName(status);
+}
+
+// Take in the statuses that start a gang response.
+static void noteSockets(const HvspResponse &r) {
+  for (uint8_t s = 0; s < sockets && s < r.length; s++) {
+    if (socketStatus[s] == HVSP_OK)
+      socketStatus[s] = r.payload[s];
+  }
+}
+
+static unsigned goodSockets() {
+  unsigned good = 0;
+  for (uint8_t status : socketStatus)
+    good += status == HVSP_OK;
+  return good;
+}
+
+static bool fail(const char *what, const std::string &why) {
+  fprintf(stderr, "%s: %s\n", what, why.c_str());
+  return false;
+}
+
+// One request, which must succeed.
+static bool request(const char *what, uint8_t code, const uint8_t *payload, uint8_t length, HvspResponse &r) {
+  if (!client.transact(code, payload, length, r))
+    return fail(what, client.error);
+  if (r.status != HVSP_OK)
+    return fail(what, hvspStatusName(r.status));
+  return true;
+}
+
+// Send every request as fast as the window allows, and collect the responses
+// in order.
+static bool pipeline(const std::vector<Request> &requests, std::vector<HvspResponse> &responses) {
+  responses.resize(requests.size());
+  size_t received = 0;
+  for (const Request &q : requests) {
+    if (!client.send(q.code, q.payload.data(), q.payload.size()))
+      return fail("send", client.error);
+  }
+  while (received < requests.size()) {
+    if (!client.receive(responses[received++]))
+      return fail("receive", client.error);
+  }
+  return true;
+}
+
+// Negotiate the window and put the target in programming mode.
+static bool enter(bool oneAtATime) {
+  HvspResponse r;
+  if (!request("info", HVSP_INFO, NULL, 0, r))
+    return false;
+  if (r.length < 5 || r.payload[0] != HVSP_PROTOCOL_VERSION)
+    return fail("info", "protocol version mismatch");
+  uint16_t rxBuffer = hvspGet16(r.payload + 1);
+  sockets = r.payload[4];
+  if (sockets < 1 || sockets > HVSP_MAX_SOCKETS)
+    return fail("info", "bad socket count");
+  socketStatus.assign(sockets, HVSP_OK);
+  client.setWindow(oneAtATime ? 0 : rxBuffer);
+
+  if (!request("enter", HVSP_ENTER, NULL, 0, r))
+    return false;
+  if (sockets == 1) {
+    uint16_t sig = hvspGet16(r.payload);
+    part = hvspFindPart(sig);
+    if (!part) {
+      char s[32];
+      snprintf(s, sizeof(s), "unknown signature %04X", sig);
+      return fail("enter", s);
+    }
+    printf("%s (signature 1E%04X), receive buffer %u bytes\n", part->name, sig, rxBuffer);
+    return true;
+  }
+
+  noteSockets(r);
+  printf("gang of %u sockets, receive buffer %u bytes\n", sockets, rxBuffer);
+  for (uint8_t s = 0; s < sockets; s++) {
+    uint16_t sig = hvspGet16(r.payload + sockets + 2 * s);
+    if (socketStatus[s] == HVSP_OK) {
+      const HvspPart *p = hvspFindPart(sig);
+      if (!p || (part && p != part))
+        socketStatus[s] = WRONG_PART;
+      else
+        part = p;
+    }
+    if (socketStatus[s] == HVSP_OK)
+      printf("  socket %u: %s (signature 1E%04X)\n", s, part->name, sig);
+    else if (socketStatus[s] == WRONG_PART)
+      printf("  socket %u: wrong part (signature 1E%04X)\n", s, sig);
+    else
+      printf("  socket %u: %s\n", s, socketStatusName(socketStatus[s]));
+  }
+  if (!part)
+    return fail("enter", "no socket holds a known part");
+  return true;
+}
+
+static void leave() {
+  HvspResponse r;
+  request("exit", HVSP_EXIT, NULL, 0, r);
+}
+
+static double seconds(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+static void rate(const char *what, size_t bytes, double s) {
+  printf("  %-8s %6zu bytes in %7.3f s, %8.0f bytes/s\n", what, bytes, s, bytes / s);
+}
+
+// Write one memory a page at a time, then read it back and compare. Pages the
+// image doesn't touch are skipped; flash is erased first. On a gang, page
+// failures are the failing sockets', and there is no readback.
+static bool program(const HexImage &image, bool flash) {
+  const char *name = flash ? "flash" : "eeprom";
+  size_t memSize = flash ? part->flashSize : part->eepromSize;
+  size_t page = flash ? part->flashPage : part->eepromPage;
+  if (image.size() > memSize) {
+    char s[64];
+    snprintf(s, sizeof(s), "image is %zu bytes, %s is %zu", image.size(), name, memSize);
+    return fail(name, s);
+  }
+
+  HvspResponse r;
+  auto erased = std::chrono::steady_clock::now();
+  if (flash && !request("erase", HVSP_CHIP_ERASE, NULL, 0, r))
+    return false;
+  if (sockets > 1)
+    noteSockets(r);
+
+  // Reads are capped by the largest reply.
+  size_t readChunk = flash ? page : HVSP_MAX_PAYLOAD;
+  std::vector<Request> writes, reads;
+  std::vector<size_t> addrs, readAddrs;
+  for (size_t a = 0; a < image.size(); a += page) {
+    if (!image.anyUsed(a, page))
+      continue;
+    Request q = {flash ? (uint8_t)HVSP_WRITE_FLASH : (uint8_t)HVSP_WRITE_EEPROM, {}};
+    q.payload.resize(2 + page);
+    hvspPut16(&q.payload[0], flash ? a / 2 : a);
+    for (size_t i = 0; i < page; i++)
+      q.payload[2 + i] = image.at(a + i);
+    writes.push_back(q);
+    addrs.push_back(a);
+  }
+  for (size_t a = 0; sockets == 1 && a < image.size(); a += readChunk) {
+    size_t n = std::min(readChunk, image.size() - a);
+    if (!image.anyUsed(a, n))
+      continue;
+    Request q = {flash ? (uint8_t)HVSP_READ_FLASH : (uint8_t)HVSP_READ_EEPROM, {0, 0, 0}};
+    hvspPut16(&q.payload[0], flash ? a / 2 : a);
+    q.payload[2] = flash ? (n + 1) / 2 : n;
+    reads.push_back(q);
+    readAddrs.push_back(a);
+  }
+
+  std::vector<HvspResponse> responses;
+  auto start = std::chrono::steady_clock::now();
+  if (!pipeline(writes, responses))
+    return false;
+  double writeTime = seconds(start);
+  double chipTime = seconds(erased);
+  for (size_t i = 0; i < responses.size(); i++) {
+    if (sockets > 1 && responses[i].status == HVSP_OK) {
+      noteSockets(responses[i]);
+    }
+    else if (responses[i].status != HVSP_OK) {
+      char s[64];
+      snprintf(s, sizeof(s), "page at 0x%04zX: %s", addrs[i], hvspStatusName(responses[i].status));
+      return fail(name, s);
+    }
+  }
+
+  start = std::chrono::steady_clock::now();
+  if (!pipeline(reads, responses))
+    return false;
+  double readTime = seconds(start);
+  size_t readBytes = 0;
+  for (size_t i = 0; i < responses.size(); i++) {
+    const HvspResponse &v = responses[i];
+    if (v.status != HVSP_OK)
+      return fail("verify", hvspStatusName(v.status));
+    for (size_t j = 0; j < v.length && readAddrs[i] + j < image.size(); j++) {
+      size_t a = readAddrs[i] + j;
+      if (image.used[a] && v.payload[j] != image.data[a]) {
+        char s[64];
+        snprintf(s, sizeof(s), "0x%04zX reads %02X, expected %02X", a, v.payload[j], image.data[a]);
+        return fail("verify", s);
+      }
+    }
+    readBytes += v.length;
+  }
+
+  printf("%s: %zu pages of %zu bytes\n", name, writes.size(), page);
+  rate("write", writes.size() * page, writeTime);
+  if (sockets == 1)
+    rate("verify", readBytes, readTime);
+  if (flash)
+    printf("  %u of %u chips in %.3f s, %.1f chips/min\n",
+      goodSockets(), sockets, chipTime, goodSockets() * 60 / chipTime);
+  return true;
+}
+
+// Read all of EEPROM into a file.
+static bool dump(const char *path) {
+  if (sockets > 1)
+    return fail("dump", "reads one socket at a time");
+
+  std::vector<Request> reads;
+  for (size_t a = 0; a < part->eepromSize; a += HVSP_MAX_PAYLOAD) {
+    size_t n = std::min((size_t)HVSP_MAX_PAYLOAD, part->eepromSize - a);
+    Request q = {HVSP_READ_EEPROM, {0, 0, (uint8_t)n}};
+    hvspPut16(&q.payload[0], a);
+    reads.push_back(q);
+  }
+  std::vector<HvspResponse> responses;
+  auto start = std::chrono::steady_clock::now();
+  if (!pipeline(reads, responses))
+    return false;
+  double readTime = seconds(start);
+
+  HexImage image;
+  image.data.reserve(part->eepromSize);
+  for (const HvspResponse &v : responses) {
+    if (v.status != HVSP_OK)
+      return fail("dump", hvspStatusName(v.status));
+    image.data.insert(image.data.end(), v.payload, v.payload + v.length);
+  }
+  image.data.resize(part->eepromSize, 0xFF);
+  image.used.assign(image.data.size(), true);
+
+  std::string error;
+  if (!image.save(path, error))
+    return fail("dump", error);
+  printf("eeprom: %zu bytes to %s\n", image.size(), path);
+  rate("read", image.size(), readTime);
+  return true;
+}
+
+// A bare environment name means its PlatformIO build output.
+static std::string hexPath(const char *arg) {
+  std::string s(arg);
+  if (s.find('/') == std::string::npos && s.find('.') == std::string::npos)
+    return ".pio/build/" + s + "/firmware.hex";
+  return s;
+}
+
+static bool fuseIndex(const char *name, uint8_t &index) {
+  switch (name[0]) {
+    case 'l': case 'L': index = 0; return true;
+    case 'h': case 'H': index = 1; return true;
+    case 'e': case 'E': index = 2; return true;
+  }
+  return false;
+}
+
+static void usage() {
+  fprintf(stderr,
+    "usage: hvspcli [-1] [-f] device|emu[:part[:sockets]] command\n"
+    "  info | fuses | fuse l|h|e value | erase | flash file.hex|env | eeprom file.hex |\n"
+    "  dump file.hex | bench [seed]\n");
+}
+
+int main(int argc, char **argv) {
+  bool oneAtATime = false;
+  bool fast = false;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; arg++) {
+    if (strcmp(argv[arg], "-1") == 0)
+      oneAtATime = true;
+    else if (strcmp(argv[arg], "-f") == 0)
+      fast = true;
+    else {
+      usage();
+      return 2;
+    }
+  }
+  if (argc - arg < 2) {
+    usage();
+    return 2;
+  }
+  const char *device = argv[arg++];
+  const char *command = argv[arg++];
+
+  std::string path(device), error;
+  std::unique_ptr<HvspEmulator> emu;
+  if (strncmp(device, "emu", 3) == 0 && (device[3] == 0 || device[3] == ':')) {
+    std::string name = device[3] ? device + 4 : "attiny85";
+    std::string fill = "1";
+    size_t colon = name.find(':');
+    if (colon != std::string::npos) {
+      fill = name.substr(colon + 1);
+      name.resize(colon);
+    }
+    const HvspPart *p = hvspFindPart(name.c_str());
+    if (!p || fill.empty() || fill.size() > HVSP_MAX_SOCKETS ||
+        fill.find_first_not_of("10x") != std::string::npos) {
+      fprintf(stderr, "bad emulator %s\n", device);
+      return 2;
+    }
+    emu.reset(new HvspEmulator(*p, fill.size()));
+    for (size_t s = 0; s < fill.size(); s++) {
+      emu->targets[s].present = fill[s] != '0';
+      emu->targets[s].stuck = fill[s] == 'x' ? 0x01 : 0;
+    }
+    emu->paced = !fast;
+    if (!emu->start(path, error)) {
+      fail("emulator", error);
+      return 1;
+    }
+    printf("emulated %s x%zu on %s%s\n", p->name, fill.size(), path.c_str(), fast ? ", unpaced" : "");
+  }
+
+  if (!client.open(path.c_str(), error)) {
+    fail("open", error);
+    return 1;
+  }
+  if (!enter(oneAtATime))
+    return 1;
+
+  bool ok = true;
+  HvspResponse r;
+  if (strcmp(command, "info") == 0) {
+    // Printed by enter().
+  }
+  else if (strcmp(command, "fuses") == 0) {
+    ok = request("fuses", HVSP_READ_FUSES, NULL, 0, r);
+    if (ok && sockets == 1)
+      printf("lfuse %02X, hfuse %02X, efuse %02X, lock %02X\n",
+        r.payload[0], r.payload[1], r.payload[2], r.payload[3]);
+    if (ok && sockets > 1) {
+      noteSockets(r);
+      for (uint8_t s = 0; s < sockets; s++) {
+        const uint8_t *f = r.payload + sockets + 4 * s;
+        if (socketStatus[s] == HVSP_OK)
+          printf("  socket %u: lfuse %02X, hfuse %02X, efuse %02X, lock %02X\n", s, f[0], f[1], f[2], f[3]);
+      }
+    }
+  }
+  else if (strcmp(command, "fuse") == 0 && argc - arg == 2) {
+    uint8_t f[2];
+    ok = fuseIndex(argv[arg], f[0]) || fail("fuse", "expected l, h or e");
+    f[1] = strtoul(argv[arg + 1], NULL, 16);
+    ok = ok && request("fuse", HVSP_WRITE_FUSE, f, 2, r);
+    if (ok && sockets > 1)
+      noteSockets(r);
+  }
+  else if (strcmp(command, "erase") == 0) {
+    ok = request("erase", HVSP_CHIP_ERASE, NULL, 0, r);
+    if (ok && sockets > 1)
+      noteSockets(r);
+  }
+  else if ((strcmp(command, "flash") == 0 || strcmp(command, "eeprom") == 0) && argc - arg == 1) {
+    HexImage image;
+    std::string file = hexPath(argv[arg]);
+    ok = image.load(file.c_str(), error) || fail("load", error);
+    ok = ok && program(image, command[0] == 'f');
+  }
+  else if (strcmp(command, "dump") == 0 && argc - arg == 1) {
+    ok = dump(argv[arg]);
+  }
+  else if (strcmp(command, "bench") == 0) {
+    std::mt19937 rng(argc - arg > 0 ? strtoul(argv[arg], NULL, 0) : 1);
+    HexImage image;
+    image.data.resize(part->flashSize);
+    image.used.assign(part->flashSize, true);
+    for (uint8_t &b : image.data)
+      b = rng();
+    ok = program(image, true);
+    for (uint8_t s = 0; ok && emu && s < sockets; s++) {
+      if (socketStatus[s] == HVSP_OK && emu->targets[s].flash != image.data)
+        ok = fail("bench", "emulated flash doesn't match the image");
+    }
+  }
+  else {
+    usage();
+    ok = false;
+  }
+
+  leave();
+  if (sockets > 1) {
+    printf("%u of %u sockets good\n", goodSockets(), sockets);
+    for (uint8_t s = 0; s < sockets; s++) {
+      if (socketStatus[s] != HVSP_OK)
+        printf("  socket %u: %s\n", s, socketStatusName(socketStatus[s]));
+    }
+    if (goodSockets() < sockets)
+      ok = false;
+  }
+  if (emu) {
+    emu->stop();
+    printf("emulator: %llu requests, %llu bytes dropped\n",
+      (unsigned long long)emu->requests(), (unsigned long long)emu->overflows());
+    if (emu->overflows() > 0)
+      ok = false;
+  }
+  return ok ? 0 : 1;
+}
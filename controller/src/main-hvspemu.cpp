@@ -0,0 +1,67 @@
+/*
+ * The HVSP programmer emulator (hvspemu.h) on its own: serves a pty until
+ * interrupted, for pointing other tools at. Prints the device path, then a
+ * line per second with the requests handled and bytes dropped for overrun.
+ * sockets is a character per socket as for hvspcli's emu device (1 chip,
+ * 0 empty, x faulty); more than one is a gang programmer.
+ *
+ * Usage: program [part] [fast] [sockets]
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+
+#include "hvspemu.h"
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int) {
+  stopping = 1;
+}
+
+int main(int argc, char **argv) {
+  const char *name = argc > 1 ? argv[1] : "attiny85";
+  const HvspPart *part = hvspFindPart(name);
+  if (!part) {
+    fprintf(stderr, "unknown part %s\n", name);
+    return 2;
+  }
+
+  std::string fill = argc > 3 ? argv[3] : "1";
+  if (fill.empty() || fill.size() > HVSP_MAX_SOCKETS || fill.find_first_not_of("10x") != std::string::npos) {
+    fprintf(stderr, "bad sockets %s\n", fill.c_str());
+    return 2;
+  }
+
+  HvspEmulator emu(*part, fill.size());
+  for (size_t s = 0; s < fill.size(); s++) {
+    emu.targets[s].present = fill[s] != '0';
+    emu.targets[s].stuck = fill[s] == 'x' ? 0x01 : 0;
+  }
+  emu.paced = !(argc > 2 && atoi(argv[2]) != 0);
+  std::string path, error;
+  if (!emu.start(path, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  printf("%s x%zu on %s%s\n", part->name, fill.size(), path.c_str(), emu.paced ? "" : ", unpaced");
+  fflush(stdout);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  uint64_t reported = 0;
+  while (!stopping) {
+    sleep(1);
+    if (emu.requests() != reported) {
+      reported = emu.requests();
+      printf("%llu requests, %llu bytes dropped\n",
+        (unsigned long long)reported, (unsigned long long)emu.overflows());
+      fflush(stdout);
+    }
+  }
+  emu.stop();
+  return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * Gang HVSP programmer firmware for an Arduino Uno: env:hvsp's protocol
+ * (hvspproto.h) driving up to six sockets in lockstep through hvspgang.h.
+ *
+ * Every request runs once for all the sockets still in play, so a page takes
+ * as long to program into six chips as into one. Each response starts with
+ * every socket's status: a socket that times out or fails a verify is marked
+ * and left out of the rest of the session while the others carry on, until
+ * the next HVSP_ENTER tries them all again.
+ */
+
+#include <Arduino.h>
+#include "hvspgang.h"
+#include "hvspproto.h"
+
+static_assert(HVSP_GANG_MAX == HVSP_MAX_SOCKETS, "Protocol and engine agree on sockets");
+
+const uint8_t SOCKETS = HVSP_GANG_SOCKETS;
+
+HvspFrameParser request;
+uint8_t reply[HVSP_MAX_PAYLOAD];
+uint8_t frame[HVSP_MAX_FRAME];
+uint8_t socketStatus[SOCKETS];
+uint16_t sig[SOCKETS];
+uint8_t fuses[HVSP_FUSES + 1][SOCKETS];
+bool entered = false;
+uint8_t pageWords = 0;   // Smallest flash page of the sockets in play; 0 is unknown
+
+void setup(void);
+void loop(void);
+void respond(uint8_t seq, uint8_t status, uint8_t length);
+uint8_t execute(uint8_t &length);
+void settle(uint8_t before, uint8_t bad);
+uint8_t report();
+
+void setup() {
+  hvspGangBegin();
+  Serial.begin(HVSP_BAUD);
+}
+
+void loop() {
+  while (Serial.available() > 0) {
+    switch (request.feed(Serial.read())) {
+      case HVSP_FEED_FRAME: {
+        uint8_t length = 0;
+        uint8_t status = execute(length);
+        respond(request.seq, status, status == HVSP_OK ? length : 0);
+        break;
+      }
+
+      case HVSP_FEED_BAD:
+        respond(request.seq, HVSP_BAD_FRAME, 0);
+        break;
+
+      case HVSP_FEED_MORE:
+        break;
+    }
+  }
+}
+
+void respond(uint8_t seq, uint8_t status, uint8_t length) {
+  Serial.write(frame, hvspEncode(frame, seq, status, reply, length));
+}
+
+// Mark the sockets that dropped out since before as timed out, and those in
+// bad as failing verify, dropping them too. Only a socket's first failure is
+// kept.
+void settle(uint8_t before, uint8_t bad) {
+  bad &= hvspGangActive;
+  uint8_t lost = before & ~hvspGangActive;
+  for (uint8_t n = 0; n < SOCKETS; n++) {
+    if (socketStatus[n] != HVSP_OK)
+      continue;
+    if (lost & (1 << n))
+      socketStatus[n] = HVSP_TIMEOUT;
+    else if (bad & (1 << n))
+      socketStatus[n] = HVSP_VERIFY_FAILED;
+  }
+  hvspGangActive &= ~bad;
+}
+
+// The per-socket statuses that start a response. Returns their length.
+uint8_t report() {
+  memcpy(reply, socketStatus, SOCKETS);
+  return SOCKETS;
+}
+
+// Run the request just received. Returns its status, with any reply payload
+// in reply and its size in length.
+uint8_t execute(uint8_t &length) {
+  const uint8_t *p = request.payload;
+  uint8_t n = request.length;
+  uint8_t before = hvspGangActive;
+
+  switch (request.code) {
+    case HVSP_INFO:
+      reply[0] = HVSP_PROTOCOL_VERSION;
+      hvspPut16(reply + 1, SERIAL_RX_BUFFER_SIZE);
+      reply[3] = HVSP_MAX_PAYLOAD;
+      reply[4] = SOCKETS;
+      length = 5;
+      return HVSP_OK;
+
+    case HVSP_ENTER:
+      hvspGangEnter();
+      entered = true;
+      memset(socketStatus, HVSP_OK, SOCKETS);
+      before = hvspGangActive;
+      break;
+
+    case HVSP_EXIT:
+      hvspGangExit();
+      entered = false;
+      length = report();
+      return HVSP_OK;
+
+    default:
+      if (request.code < HVSP_READ_SIGNATURE || request.code > HVSP_READ_EEPROM)
+        return HVSP_BAD_COMMAND;
+      if (!entered)
+        return HVSP_NOT_ENTERED;
+      break;
+  }
+
+  switch (request.code) {
+    case HVSP_ENTER:
+    case HVSP_READ_SIGNATURE:
+      hvspGangReadSignature(sig);
+      settle(before, 0);
+      pageWords = 0xFF;
+      for (uint8_t s = 0; s < SOCKETS; s++) {
+        if (socketStatus[s] == HVSP_OK)
+          pageWords = min(pageWords, hvspFlashPageWords(sig[s]));
+      }
+      if (pageWords == 0xFF)
+        pageWords = 0;
+      length = report();
+      for (uint8_t s = 0; s < SOCKETS; s++, length += 2)
+        hvspPut16(reply + length, sig[s]);
+      return HVSP_OK;
+
+    case HVSP_READ_FUSES:
+      for (uint8_t f = 0; f < HVSP_FUSES; f++)
+        hvspGangReadFuse((HvspFuse)f, fuses[f]);
+      hvspGangReadLock(fuses[HVSP_FUSES]);
+      settle(before, 0);
+      length = report();
+      for (uint8_t s = 0; s < SOCKETS; s++) {
+        for (uint8_t f = 0; f <= HVSP_FUSES; f++)
+          reply[length++] = fuses[f][s];
+      }
+      return HVSP_OK;
+
+    case HVSP_WRITE_FUSE: {
+      if (n != 2 || p[0] >= HVSP_FUSES)
+        return HVSP_BAD_LENGTH;
+      uint8_t *val = fuses[0];
+      uint8_t bad = 0;
+      hvspGangWriteFuse((HvspFuse)p[0], p[1]);
+      hvspGangReadFuse((HvspFuse)p[0], val);
+      for (uint8_t s = 0; s < SOCKETS; s++) {
+        if (val[s] != p[1])
+          bad |= 1 << s;
+      }
+      settle(before, bad);
+      length = report();
+      return HVSP_OK;
+    }
+
+    case HVSP_CHIP_ERASE:
+      hvspGangChipErase();
+      settle(before, 0);
+      length = report();
+      return HVSP_OK;
+
+    case HVSP_WRITE_FLASH: {
+      if (n < 4 || (n & 1))
+        return HVSP_BAD_LENGTH;
+      uint8_t words = (n - 2) / 2;
+      uint16_t addr = hvspGet16(p);
+      if (!hvspWithinPage(addr, words, pageWords))
+        return HVSP_BAD_LENGTH;
+      HvspGangRead verify;
+      verify.expect = p + 2;
+      if (hvspGangWriteFlashPage(addr, p + 2, words))
+        hvspGangReadFlash(addr, words, verify);
+      settle(before, verify.bad);
+      length = report();
+      return HVSP_OK;
+    }
+
+    case HVSP_WRITE_EEPROM: {
+      if (n < 3)
+        return HVSP_BAD_LENGTH;
+      uint16_t addr = hvspGet16(p);
+      if (!hvspWithinPage(addr, n - 2, pageWords ? HVSP_EEPROM_PAGE : 0))
+        return HVSP_BAD_LENGTH;
+      HvspGangRead verify;
+      verify.expect = p + 2;
+      if (hvspGangWriteEepromPage(addr, p + 2, n - 2))
+        hvspGangReadEeprom(addr, n - 2, verify);
+      settle(before, verify.bad);
+      length = report();
+      return HVSP_OK;
+    }
+
+    // One socket's data; the instructions still go to them all.
+    case HVSP_READ_FLASH:
+    case HVSP_READ_EEPROM: {
+      bool flash = request.code == HVSP_READ_FLASH;
+      if (n != 4 || p[2] == 0 || p[2] > (flash ? HVSP_MAX_PAYLOAD / 2 : HVSP_MAX_PAYLOAD) || p[3] >= SOCKETS)
+        return HVSP_BAD_LENGTH;
+      HvspGangRead read;
+      read.socket = p[3];
+      read.data = reply;
+      if (flash)
+        hvspGangReadFlash(hvspGet16(p), p[2], read);
+      else
+        hvspGangReadEeprom(hvspGet16(p), p[2], read);
+      settle(before, 0);
+      if (socketStatus[p[3]] != HVSP_OK)
+        return socketStatus[p[3]];
+      length = flash ? p[2] * 2 : p[2];
+      return HVSP_OK;
+    }
+  }
+  return HVSP_BAD_COMMAND;
+}
@@ -0,0 +1,125 @@
+/*
+ * Host-side simulation of one transmitter and the receiver, driven by the
+ * simulated clock in hal-native.cpp.
+ *
+ * Each cycle turns a tool on for a random time and then off again, plays the
+ * transmitter's frames into the receiver's pin change handler, and lets the
+ * receiver's timeouts run until the collector stops. Time jumps from one event
+ * to the next, so a cycle costs a handful of function calls regardless of how
+ * many simulated seconds it covers.
+ *
+ * On release the transmitter sends its STOPPED codes; with stopped 0 it
+ * doesn't, as older firmware, and the collector waits out the quiet timeout.
+ *
+ * Usage: program [cycles] [seed] [stopped]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <chrono>
+#include <random>
+
+#include "hal.h"
+#include "receiver.h"
+#include "transmitter.h"
+#include "sim.h"
+
+static Receiver receiver;
+static Transmitter transmitter;
+
+int main(int argc, char **argv) {
+  unsigned long cycles = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+  unsigned long seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+  bool stopped = argc > 3 ? atoi(argv[3]) != 0 : true;
+
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<uint32_t> runTime(500, 20000);
+  std::uniform_int_distribution<uint32_t> idleTime(0, 30000);
+
+  SimStat onLatency, offLatency, runOn;
+  uint64_t falseShutoffs = 0;
+  uint64_t frames = 0;
+  uint64_t simulated = 0;
+
+  halSimSetMillis(0);
+  receiver.begin();
+
+  auto wallStart = std::chrono::steady_clock::now();
+
+  for (unsigned long i = 0; i < cycles; i++) {
+    uint32_t cycleStart = halMillis();
+    uint32_t start = halMillis() + idleTime(rng);
+    uint32_t release = start + runTime(rng);
+
+    // Tool starts.
+    simAdvanceTo(receiver, start);
+    halSimSetTrigger(true);
+    transmitter.readTrigger();
+
+    bool sawOn = false;
+    bool falseOff = false;
+    uint32_t t = start;
+    uint32_t frameEnd = start;
+    while (simBefore(t, release)) {
+      simSetInputs(receiver, t, (uint8_t)transmitter.nextCode());
+      frames++;
+      frameEnd = t + BIT_ON_TIME;
+      simSetInputs(receiver, frameEnd, 0);
+      if (halSimOutput() && !sawOn) {
+        onLatency.add(receiver.motorStartTime - start);
+        sawOn = true;
+      }
+      t += BIT_ON_TIME + transmitter.nextInterval(INTERVAL_MIN, INTERVAL_MAX);
+
+      // Collector stopped while the tool is still running.
+      simAdvanceTo(receiver, simBefore(t, release) ? t : release);
+      if (sawOn && !halSimOutput() && !falseOff) {
+        falseShutoffs++;
+        falseOff = true;
+      }
+    }
+
+    // Tool stops.
+    simAdvanceTo(receiver, release);
+    halSimSetTrigger(false);
+    transmitter.readTrigger();
+
+    if (stopped) {
+      // The transmitter wakes on the release, finishes any frame in progress
+      // and sends its STOPPED codes.
+      uint32_t s = simBefore(release, frameEnd) ? frameEnd : release;
+      for (uint8_t n = 0; n < STOPPED_CODE_COUNT; n++) {
+        simSetInputs(receiver, s, (uint8_t)Code::TOOL_STOPPED);
+        simSetInputs(receiver, s + BIT_ON_TIME, 0);
+        s += BIT_ON_TIME + transmitter.nextInterval(STOPPED_INTERVAL_MIN, STOPPED_INTERVAL_MAX);
+      }
+    }
+    else if (simAtOrBefore(halMillis(), t)) {
+      // The transmitter loop only sees the release once its current wait ends.
+      simAdvanceTo(receiver, t);
+    }
+
+    // Let the receiver time out.
+    while (receiver.hasDeadline())
+      simAdvanceTo(receiver, receiver.nextDeadline());
+    if (sawOn && !falseOff) {
+      offLatency.add(halMillis() - release);
+      runOn.add(halMillis() - start);
+    }
+    simulated += halMillis() - cycleStart;
+  }
+
+  auto wallEnd = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(wallEnd - wallStart).count();
+
+  printf("cycles %lu, frames %llu, simulated %.1f h\n",
+    cycles, (unsigned long long)frames, simulated / 3600000.0);
+  onLatency.print("tool on -> output on");
+  offLatency.print("tool off -> output off");
+  runOn.print("collector run time");
+  printf("  %-22s %llu\n", "false shutoffs", (unsigned long long)falseShutoffs);
+  printf("  %-22s %u\n", "queue overflows", receiver.queue.overflows());
+  printf("wall %.3f s, %.0f cycles/s\n", seconds, cycles / seconds);
+  return 0;
+}
@@ -1,6 +1,14 @@
 #include <Arduino.h>
+#include <avr/eeprom.h>
 #include <avr/interrupt.h>
-#include "codes.h"
+#include <avr/sleep.h>
+#include "debounce.h"
+#include "hal.h"
+#include "receiver.h"
+#include "rxclock.h"
+#include "stats.h"
+#include "transmitter.h"
+#include "usitx.h"
 
 /*
  * Runs on ATTiny84
@@ -8,165 +16,237 @@
  * Pins PA0-PA3 are inputs from the RF receiver. While valid codes are received on
  * the inputs, the output will be held high. When valid codes are not seen for an
  * interval of time, the output will switch off.
+ *
+ * The state machine itself lives in receiver.cpp so it can also be built and
+ * exercised on the host (env:native).
+ *
+ * With complement frames set in EEPROM, STARTING and RUNNING codes only count
+ * when followed by their complement (codes.h); every transmitter must then
+ * send them. With a frame time set in EEPROM, a code only counts if it held
+ * for that long, near enough (Receiver::frameTime), so transmitters can send
+ * short frames and codes cut short by a collision are rejected.
+ *
+ * Time is kept on Timer1 (rxclock.h) rather than by the Arduino core, so the
+ * core sleeps until an input changes or the next deadline, with no
+ * free-running tick: a pin change, Receiver::nextDeadline(), the next
+ * statistics frame, the EEPROM being ready for the run log's next byte, or
+ * Timer1 wrapping every 8.39 s, whichever comes first.
+ *
+ * Built with INPUT_DEBOUNCE (env:receiverdebounce), the inputs are sampled on
+ * Timer1's compare A interrupt every 2.048 ms and debounced together
+ * (debounce.h) instead of being read on each pin change. The tick starts on
+ * a pin change and stops once the debouncer has settled, so it only runs
+ * around frames. A glitch on any line, or a code whose lines settle apart,
+ * never reaches the decoder. A code is then decoded up to
+ * DEBOUNCE_LATENCY_MS (21 ms) after its frame starts instead of about 3 ms,
+ * so a frame time set in EEPROM counts as no less than that, and the
+ * transmitters must send frames at least that long.
+ *
+ * At boot the output blinks four times (2 s) as a lamp or relay check, but
+ * only after an external reset, or at every boot with self-test set in
+ * EEPROM; otherwise codes are decoded from the moment setup() returns.
+ *
+ * Every STATS_PERIOD the receiver's statistics go out as a binary frame on
+ * PA5 (the USI DO pin) at USI_TX_BAUD, 8N1; env:stats decodes them.
+ *
+ * Each run of the collector, how long it ran and what stopped it, goes to a
+ * ring of records in EEPROM with running totals (runlog.h), written from
+ * loop() a byte per pass. Read it back with hvspcli dump and decode it with
+ * env:runlog.
 */
 
 const int OUTPUT_PIN = 0;   // PB0
 
-// Output state machine.
-enum class MotorState : unsigned char { OFF, MANUAL_RUN, AUTO_RUN };
-volatile MotorState currentOutputState = MotorState::OFF;
-volatile MotorState priorOutputState = MotorState::OFF;
-
-// Transition from MANUAL_RUN to OFF after this interval;
-const unsigned long SHUTOFF_INTERVAL = 180000;  // 3 minutes for testing // 1200000; 20 minutes, in milliseconds
-
-// Max interval allowed between codes in a multi-code sequnce
-const unsigned long CODE_SEQ_INTERVAL = 1000;
-
-// Interval after hearing no activity from tool transmitters
-const unsigned long QUIET_INTERVAL = 5000;
-
-volatile unsigned long motorStartTime = 0;
-volatile unsigned long runningCodeReceivedTime = millis();
-volatile unsigned long anyCodeReceivedTime = millis();
+Receiver receiver;
+
+// Settings in EEPROM; erased values are the defaults. They are the
+// firmware's only EEMEM object, so the linker places them from address 0,
+// and the run log's ring starts at RUNLOG_BASE above them.
+struct ReceiverSettings {
+  // 1 requires complement frames; erased (0xFF) is off. Must match the
+  // transmitters.
+  uint8_t complementMode;
+
+  // Frame time of the transmitters in milliseconds, to check each code's
+  // pulse width against; erased (0xFF) doesn't check. Must match the
+  // transmitters. BIT_ON_TIME_MIN up, or DEBOUNCE_LATENCY_MS with
+  // INPUT_DEBOUNCE.
+  uint8_t frameTimeMs;
+
+  // Run-on after a tool stops with no other tool known to be active, in
+  // milliseconds (Receiver::stoppedRunOn); erased (0xFFFF) is
+  // STOPPED_RUN_ON.
+  uint16_t stoppedRunOnMs;
+
+  // 1 blinks the output at every boot; erased (0xFF) only after an
+  // external reset.
+  uint8_t selfTestMode;
+};
+
+ReceiverSettings EEMEM settings = {0xFF, 0xFF, 0xFFFF, 0xFF};
+
+static_assert(sizeof(settings) <= RUNLOG_BASE, "receiver settings run into the run log");
+
+const uint32_t STATS_PERIOD = 10000;
+StatsFrameWriter statsFrame;
+uint32_t statsSentTime = 0;
+
+// The ATtiny84's 512 bytes of RAM hold the globals and the stack together.
+// Keep the stack room for loop() down through a run log write with the pin
+// change and USI interrupts on top, and a few bytes for the Arduino core,
+// rxclock.cpp and usitx.cpp; the globals above get the rest.
+const uint16_t STACK_RESERVE = 96;
+const uint16_t DRIVER_RAM = 24;
+static_assert(sizeof(receiver) + sizeof(statsFrame) + sizeof(statsSentTime)
+    <= RAMEND + 1 - RAMSTART - STACK_RESERVE - DRIVER_RAM,
+  "receiver globals leave too little RAM for the stack");
 
 // Function declarations
+void selfTest(void);
 void setup(void);
 void loop(void);
-void newInput(Code);
-void newMotorState(MotorState);
-void turnOff(void);
-void turnOn(void);
+bool nextStatsByte(uint8_t &b);
+void sendStats(void);
 
 
 void setup() {
+  // Why we reset, cleared for next time.
+  uint8_t resetCause = MCUSR;
+  MCUSR = 0;
+
+  rxClockBegin();
+
   // Turn off voltage reference
   ACSR &= ~(1<<ACBG);
 
   // Set pin modes: PB0 output
   DDRA = 0b00000000;
   DDRB = 0b00000001;
+  usiTxBegin();
 
   // Turn off output
   PORTB = 0b00000000;
 
-  // Configure pin change interrupt on PORTA bits 0-3
+  // Configure pin change interrupt on PORTA bits 0-3. Debounced builds only
+  // use it to start the sampling tick.
   PCMSK0 =  _BV(PCINT0) | _BV(PCINT1) | _BV(PCINT2) | _BV(PCINT3);
   GIMSK |= _BV(PCIE0);        // Enable Pin Change Interrupts
+#if defined(INPUT_DEBOUNCE)
+  // Take in whatever is on the inputs already.
+  rxClockTickStart();
+#endif
+  receiver.complementFrames = eeprom_read_byte(&settings.complementMode) == 1;
+  uint8_t frameTime = eeprom_read_byte(&settings.frameTimeMs);
+  if (frameTime >= BIT_ON_TIME_MIN && frameTime != 0xFF)
+    receiver.frameTime = frameTime;
+#if defined(INPUT_DEBOUNCE)
+  if (receiver.frameTime != 0 && receiver.frameTime < DEBOUNCE_LATENCY_MS)
+    receiver.frameTime = DEBOUNCE_LATENCY_MS;
+#endif
+  uint16_t runOn = eeprom_read_word(&settings.stoppedRunOnMs);
+  if (runOn != 0xFFFF)
+    receiver.stoppedRunOn = runOn;
+  receiver.begin();
+  receiver.runLog.begin();
+  set_sleep_mode(SLEEP_MODE_IDLE);
   sei();
 
-  // Toggle LED
-  turnOn();
-  delay(250);
-  turnOff();
-  delay(250);
-  turnOn();
-  delay(250);
-  turnOff();
-  delay(250);
-  turnOn();
-  delay(250);
-  turnOff();
-  delay(250);
-  turnOn();
-  delay(250);
-  turnOff();
+  if ((resetCause & _BV(EXTRF)) || eeprom_read_byte(&settings.selfTestMode) == 1)
+    selfTest();
 }
 
-
-// Loop's job is to process timeouts. When a timeout occurrs, insert a
-// pseudocode into the codestream.
-void loop() {
-
-  unsigned long now = millis();
-  if (currentOutputState != MotorState::OFF) {
-
-    // Heard any good codes lately?
-    if (now - anyCodeReceivedTime > CODE_SEQ_INTERVAL) {
-      newInput(Code::CODE_SEQ_TIMEOUT);
-    }
-
-    // See if we've been running too long
-    if (now - motorStartTime > SHUTOFF_INTERVAL) {
-      newInput(Code::SHUTOFF_TIMEOUT);
-    }
-
-    // Have transmitters all gone silent?
-    if (now - runningCodeReceivedTime > QUIET_INTERVAL) {
-      newInput(Code::TOOL_QUIET_TIMEOUT);
-    }
-  }
+// Toggle LED
+void selfTest() {
+  halOutputOn();
+  halDelay(250);
+  halOutputOff();
+  halDelay(250);
+  halOutputOn();
+  halDelay(250);
+  halOutputOff();
+  halDelay(250);
+  halOutputOn();
+  halDelay(250);
+  halOutputOff();
+  halDelay(250);
+  halOutputOn();
+  halDelay(250);
+  halOutputOff();
 }
 
-// Invoked by ISR on each change to the inputs, and by loop on timeouts.
-// Advances the receiver state machine.
-void newInput(Code currentCode) {
-
-  switch (currentCode) {
-    case Code::START:
-    case Code::TOOL_STARTING:
-      newMotorState(MotorState::MANUAL_RUN);
-      runningCodeReceivedTime = millis();
-      break;
-
-    case Code::STOP:
-    case Code::TOOL_QUIET_TIMEOUT:
-    case Code::SHUTOFF_TIMEOUT:
-      newMotorState(MotorState::OFF);
-      break;
-
-    case Code::TOOL_RUNNING:
-      runningCodeReceivedTime = millis();
-      break;
-
-    default:
-      break;
-  }
 
+// Loop's job is to decode the input samples queued by the ISR and to process
+// timeouts. When a timeout occurrs, insert a pseudocode into the codestream.
+// Between passes the core idles until the next interrupt: a pin change, or
+// Timer1's compare B at the earliest of the receiver's deadline and the next
+// statistics frame. A run log write in progress moves on a byte each pass
+// the EEPROM is free, and the EEPROM ready interrupt wakes the next pass.
+void loop() {
+  receiver.poll();
+  receiver.runLog.poll();
+  sendStats();
+
+  uint32_t wake = statsSentTime + STATS_PERIOD;
+
+  // Check for queued input and set the wakeup with interrupts off, so a
+  // sample can't slip in between the check and the sleep. sei() takes effect
+  // after the following instruction, so the wakeup can't be missed either.
+  cli();
+  if (receiver.hasDeadline() && (int32_t)(receiver.nextDeadline() - wake) < 0)
+    wake = receiver.nextDeadline();
+  if (receiver.queue.isEmpty() && rxClockWakeAt(wake)) {
+    if (receiver.runLog.isWriting())
+      EECR |= _BV(EERIE);
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+  }
+  sei();
 }
 
-void newMotorState(MotorState s) {
-
-  if (s == currentOutputState)
+// Start a statistics frame once per STATS_PERIOD. The USI interrupt streams
+// it out of receiver.stats while loop() carries on.
+void sendStats() {
+  uint32_t now = halMillis();
+  if (now - statsSentTime < STATS_PERIOD || usiTxBusy())
     return;
+  statsSentTime = now;
+  receiver.stats.set(STAT_OVERFLOWS, receiver.queue.overflows());
+  statsFrame.begin(&receiver.stats);
+  usiTxStart(nextStatsByte);
+}
 
-  currentOutputState = s;
-
-  switch (s) {
-    case MotorState::OFF:
-      turnOff();
-      break;
-
-    case MotorState::AUTO_RUN:
-    case MotorState::MANUAL_RUN:
-      if (currentOutputState == (MotorState::OFF)) {
-        motorStartTime = millis();
-        turnOn();
-      }
-      break;
-  }
-
-
-  priorOutputState = currentOutputState;
+bool nextStatsByte(uint8_t &b) {
+  return statsFrame.next(b);
 }
 
-void inline turnOn() {
-  PORTB |= _BV(PINB0);
+// EEPROM ready, only enabled to wake loop() for the run log's next byte. It
+// fires for as long as the EEPROM is ready, so it switches itself off.
+ISR(EE_RDY_vect) {
+  EECR &= ~_BV(EERIE);
 }
 
-void inline turnOff() {
-  PORTB &= ~_BV(PINB0);
+#if defined(INPUT_DEBOUNCE)
+// Timer1 compare A, every RX_CLOCK_TICK_COUNTS while the inputs are moving.
+// Samples and debounces the inputs, queueing a code only when the debounced
+// code changes, and stops once a tick would change nothing.
+ISR(TIM1_COMPA_vect) {
+  receiver.onTick();
+  if (receiver.debouncer.isSettled(halReadCodeInputs()))
+    rxClockTickStop();
+  else
+    OCR1A += RX_CLOCK_TICK_COUNTS;
 }
 
-// Pin change interrupt. Invoked on change to any input bit.
+// Pin change interrupt: the inputs are moving, so sample them.
 ISR(PCINT0_vect) {
-
-  // Delay to allow all bits to settle if the receiver doesn't set them all at once.
-  delay(1);
-  Code c = (Code) (PINA & 0b00001111);
-
-  // If code is invalid, just eat it.
-  if (isValidCode(c)) {
-    newInput(c);
-  }
-}
\ No newline at end of file
+  rxClockTickStart();
+}
+#else
+// Pin change interrupt. Invoked on change to any input bit. Only queues the
+// inputs and a timestamp; loop() does the rest with interrupts enabled.
+ISR(PCINT0_vect) {
+  receiver.onPinChange();
+}
+#endif
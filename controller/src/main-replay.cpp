@@ -0,0 +1,355 @@
+/*
+ * Replay of a logic analyzer capture of the receiver's PA0-PA3 inputs
+ * through the receiver logic, on the simulated clock.
+ *
+ * Each change in the capture (trace.h reads VCD and CSV) is presented to the
+ * pin change handler at its millisecond, as the ISR would see it, and the
+ * receiver's deadlines between changes run as its loop would run them. Time
+ * jumps from one change or deadline to the next, so hours of capture replay
+ * in seconds. After the last change the receiver runs on until it has
+ * nothing left to do, at most SHUTOFF_INTERVAL.
+ *
+ * The result is the output pin's timeline, "ms,output" rows from time 0 of
+ * the capture, written with -o (- for stdout, when the summary goes to
+ * stderr). With -e it is compared with an expected timeline in the same
+ * form: edges within the tolerance of each other match, and each edge
+ * missing or extra is listed. The exit status is the number of differences,
+ * at most 255.
+ *
+ * gen writes a synthetic capture as VCD, for trying the replay without an
+ * analyzer: tools turning on and off at random, each running its own copy of
+ * the transmitter logic as in env:channel, with up to GEN_SKEW_US between
+ * the bits of one change and short glitches on single bits.
+ *
+ * Usage: program [-t toleranceMs] [-e expected.csv] [-o timeline.csv] trace
+ *        program gen [hours] [tools] [seed] > trace.vcd
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "hal.h"
+#include "receiver.h"
+#include "transmitter.h"
+#include "sim.h"
+#include "trace.h"
+
+const uint32_t GEN_SKEW_US = 200;
+const uint32_t GEN_GLITCH_MIN_US = 20;
+const uint32_t GEN_GLITCH_MAX_US = 500;
+const double GEN_GLITCH_MEAN_S = 30;
+const double GEN_MEAN_ON_S = 60;
+const double GEN_MEAN_OFF_S = 300;
+
+struct OutputEdge {
+  uint64_t ms;
+  bool on;
+};
+
+struct Replay {
+  Receiver receiver;
+  uint64_t now = 0;
+  bool output = false;
+  std::vector<OutputEdge> timeline;
+
+  void begin();
+  void advance(uint64_t t);
+  void finish();
+};
+
+void Replay::begin() {
+  halSimSetMillis(0);
+  halSimSetCodeInputs(0);
+  receiver.begin();
+  output = halSimOutput();
+}
+
+// Move time forward to t one receiver deadline at a time, noting each change
+// of the output.
+void Replay::advance(uint64_t t) {
+  while (now < t) {
+    uint64_t step = t;
+    if (receiver.hasDeadline()) {
+      uint32_t untilDeadline = receiver.nextDeadline() - (uint32_t)now;
+      if (untilDeadline < t - now)
+        step = now + untilDeadline;
+    }
+    now = step;
+    simAdvanceTo(receiver, (uint32_t)now);
+    if (halSimOutput() != output) {
+      output = halSimOutput();
+      timeline.push_back(OutputEdge{now, output});
+    }
+  }
+}
+
+// Run on until nothing is pending, or for SHUTOFF_INTERVAL.
+void Replay::finish() {
+  uint64_t end = now + SHUTOFF_INTERVAL;
+  while (receiver.hasDeadline() && now < end) {
+    uint32_t untilDeadline = receiver.nextDeadline() - (uint32_t)now;
+    advance(std::min(end, now + (untilDeadline ? untilDeadline : 1)));
+  }
+}
+
+static bool readTimeline(const char *path, std::vector<OutputEdge> &timeline) {
+  FILE *in = fopen(path, "r");
+  if (!in) {
+    perror(path);
+    return false;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), in)) {
+    unsigned long long ms;
+    unsigned on;
+    if (sscanf(line, "%llu,%u", &ms, &on) == 2)
+      timeline.push_back(OutputEdge{ms, on != 0});
+  }
+  fclose(in);
+  return true;
+}
+
+static void writeTimeline(FILE *out, const std::vector<OutputEdge> &timeline) {
+  fprintf(out, "ms,output\n");
+  for (const OutputEdge &e : timeline)
+    fprintf(out, "%llu,%u\n", (unsigned long long)e.ms, e.on);
+}
+
+// Edges of expected and actual in order, matching those of the same sense
+// within tolerance of each other. Prints each one left over and returns how
+// many.
+static unsigned diff(FILE *out, const std::vector<OutputEdge> &expected,
+                     const std::vector<OutputEdge> &actual, uint64_t tolerance) {
+  unsigned differences = 0;
+  uint64_t worstShift = 0;
+  size_t i = 0, j = 0;
+  while (i < expected.size() || j < actual.size()) {
+    if (i < expected.size() && j < actual.size()) {
+      const OutputEdge &e = expected[i], &a = actual[j];
+      uint64_t shift = e.ms > a.ms ? e.ms - a.ms : a.ms - e.ms;
+      if (e.on == a.on && shift <= tolerance) {
+        worstShift = std::max(worstShift, shift);
+        i++;
+        j++;
+        continue;
+      }
+      if (a.ms < e.ms) {
+        fprintf(out, "  extra   %10llu ms %s\n", (unsigned long long)a.ms, a.on ? "on" : "off");
+        j++;
+      }
+      else {
+        fprintf(out, "  missing %10llu ms %s\n", (unsigned long long)e.ms, e.on ? "on" : "off");
+        i++;
+      }
+    }
+    else if (i < expected.size()) {
+      fprintf(out, "  missing %10llu ms %s\n", (unsigned long long)expected[i].ms, expected[i].on ? "on" : "off");
+      i++;
+    }
+    else {
+      fprintf(out, "  extra   %10llu ms %s\n", (unsigned long long)actual[j].ms, actual[j].on ? "on" : "off");
+      j++;
+    }
+    differences++;
+  }
+  fprintf(out, "%zu expected edges, %zu replayed, %u differences, matched edges within %llu ms\n",
+    expected.size(), actual.size(), differences, (unsigned long long)worstShift);
+  return differences;
+}
+
+static int replay(const char *path, const char *expectedPath, const char *outPath, uint64_t tolerance) {
+  FILE *report = outPath && strcmp(outPath, "-") == 0 ? stderr : stdout;
+  std::vector<OutputEdge> expected;
+  if (expectedPath && !readTimeline(expectedPath, expected))
+    return 255;
+
+  PinTraceReader trace;
+  std::string error;
+  if (!trace.open(path, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 255;
+  }
+
+  auto wallStart = std::chrono::steady_clock::now();
+  Replay r;
+  r.begin();
+  PinEdge e;
+  uint64_t changes = 0;
+  uint64_t last = 0;
+  while (trace.next(e)) {
+    uint64_t ms = e.ns / 1000000;
+    // Captures are in order, but don't let a stray one run the clock back.
+    if (ms < r.now)
+      ms = r.now;
+    r.advance(ms);
+    simSetInputs(r.receiver, (uint32_t)ms, e.bits);
+    changes++;
+    last = ms;
+  }
+  if (!trace.error.empty()) {
+    fprintf(stderr, "%s: %s\n", path, trace.error.c_str());
+    return 255;
+  }
+  r.finish();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+  const uint16_t *c = r.receiver.stats.counters;
+  fprintf(report, "%llu input changes over %.1f s, replayed in %.3f s (%.0fx)\n",
+    (unsigned long long)changes, last / 1000.0, seconds, seconds > 0 ? last / 1000.0 / seconds : 0);
+  fprintf(report, "codes %u, rejected %u, glitches %u, overflows %u, starts %u, quiet timeouts %u, shutoffs %u\n",
+    c[STAT_CODES], c[STAT_REJECTED], c[STAT_GLITCHES], r.receiver.queue.overflows(),
+    c[STAT_STARTS], c[STAT_QUIET_TIMEOUTS], c[STAT_SHUTOFF_TIMEOUTS]);
+  fprintf(report, "%zu output edges\n", r.timeline.size());
+
+  if (outPath) {
+    FILE *out = report == stderr ? stdout : fopen(outPath, "w");
+    if (!out) {
+      perror(outPath);
+      return 255;
+    }
+    writeTimeline(out, r.timeline);
+    if (out != stdout)
+      fclose(out);
+  }
+  if (!expectedPath)
+    return 0;
+  unsigned differences = diff(report, expected, r.timeline, tolerance);
+  return differences > 255 ? 255 : differences;
+}
+
+// A toggle of one input at a time in microseconds. Toggles rather than
+// levels, so glitches can be dropped in anywhere.
+struct Toggle {
+  uint64_t us;
+  uint8_t bit;
+
+  bool operator<(const Toggle &other) const {
+    return us < other.us;
+  }
+};
+
+struct GenTool {
+  Transmitter tx;
+  uint64_t next = 0;        // Next step of the state machine, ms
+  bool looping = false;
+  uint64_t switchAt = 0;    // Next trigger change, ms
+  uint8_t code = 0;         // Code being sent, 0 between frames
+};
+
+static int generate(double hours, unsigned count, unsigned long seed) {
+  std::mt19937_64 rng(seed);
+  std::exponential_distribution<double> onTime(1 / (GEN_MEAN_ON_S * 1000));
+  std::exponential_distribution<double> offTime(1 / (GEN_MEAN_OFF_S * 1000));
+  std::uniform_int_distribution<uint32_t> skew(0, GEN_SKEW_US);
+  uint64_t end = (uint64_t)(hours * 3600000);
+
+  std::vector<GenTool> tools(count);
+  for (unsigned i = 0; i < count; i++) {
+    tools[i].tx.seed(seed * 1000003 + i + 1);
+    tools[i].switchAt = (uint64_t)offTime(rng);
+  }
+
+  std::vector<Toggle> toggles;
+  uint8_t channel = 0;
+  for (;;) {
+    // The earliest trigger change or step of any tool.
+    uint64_t now = UINT64_MAX;
+    for (GenTool &t : tools) {
+      now = std::min(now, t.switchAt);
+      if (t.looping)
+        now = std::min(now, t.next);
+    }
+    if (now >= end)
+      break;
+
+    for (GenTool &t : tools) {
+      bool stepNow = t.looping && t.next == now;
+      if (t.switchAt == now) {
+        bool on = !t.tx.triggered;
+        t.tx.setTrigger(on);
+        t.switchAt = now + 1 + (uint64_t)(on ? onTime(rng) : offTime(rng));
+        stepNow = stepNow || (on && !t.looping) || t.tx.isStopPending();
+      }
+      if (!stepNow)
+        continue;
+      uint16_t ms = t.tx.step();
+      // The transmitter outputs are active low, on PB1-PB4.
+      t.code = t.tx.state == TxState::FRAME ?
+        (uint8_t)(~halSimCodeOutputs() >> 1) & (uint8_t)Code::MASK : 0;
+      t.looping = ms != 0;
+      t.next = now + ms;
+    }
+
+    uint8_t bits = 0;
+    for (const GenTool &t : tools)
+      bits |= t.code;
+    for (uint8_t b = 0; b < 4; b++) {
+      if ((bits ^ channel) & (1 << b))
+        toggles.push_back(Toggle{now * 1000 + skew(rng), b});
+    }
+    channel = bits;
+  }
+
+  // Glitches: one input flipped briefly, at random.
+  std::exponential_distribution<double> glitchGap(1 / (GEN_GLITCH_MEAN_S * 1e6));
+  std::uniform_int_distribution<uint32_t> glitchWidth(GEN_GLITCH_MIN_US, GEN_GLITCH_MAX_US);
+  std::uniform_int_distribution<uint8_t> glitchBit(0, 3);
+  for (uint64_t us = (uint64_t)glitchGap(rng); us < end * 1000; us += 1 + (uint64_t)glitchGap(rng)) {
+    uint8_t b = glitchBit(rng);
+    toggles.push_back(Toggle{us, b});
+    toggles.push_back(Toggle{us + glitchWidth(rng), b});
+  }
+  std::stable_sort(toggles.begin(), toggles.end());
+
+  const char ids[] = "!\"#$";
+  printf("$version replay gen %g h, %u tools, seed %lu $end\n", hours, count, seed);
+  printf("$timescale 1us $end\n$scope module receiver $end\n");
+  for (int b = 0; b < 4; b++)
+    printf("$var wire 1 %c PA%d $end\n", ids[b], b);
+  printf("$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n0! 0\" 0# 0$\n$end\n");
+  uint8_t level = 0;
+  for (size_t i = 0; i < toggles.size(); i++) {
+    if (i == 0 || toggles[i].us != toggles[i - 1].us)
+      printf("#%llu\n", (unsigned long long)toggles[i].us);
+    level ^= 1 << toggles[i].bit;
+    printf("%d%c\n", (level >> toggles[i].bit) & 1, ids[toggles[i].bit]);
+  }
+  printf("#%llu\n", (unsigned long long)end * 1000);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "gen") == 0) {
+    double hours = argc > 2 ? atof(argv[2]) : 8;
+    unsigned tools = argc > 3 ? strtoul(argv[3], NULL, 0) : 4;
+    unsigned long seed = argc > 4 ? strtoul(argv[4], NULL, 0) : 1;
+    return generate(hours, tools, seed);
+  }
+
+  const char *expected = NULL;
+  const char *out = NULL;
+  uint64_t tolerance = 0;
+  int arg = 1;
+  for (; arg + 1 < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg += 2) {
+    if (strcmp(argv[arg], "-t") == 0)
+      tolerance = strtoull(argv[arg + 1], NULL, 0);
+    else if (strcmp(argv[arg], "-e") == 0)
+      expected = argv[arg + 1];
+    else if (strcmp(argv[arg], "-o") == 0)
+      out = argv[arg + 1];
+    else
+      break;
+  }
+  if (argc - arg != 1) {
+    fprintf(stderr, "Usage: %s [-t toleranceMs] [-e expected.csv] [-o timeline.csv] trace\n"
+                    "       %s gen [hours] [tools] [seed] > trace.vcd\n", argv[0], argv[0]);
+    return 255;
+  }
+  return replay(argv[arg], expected, out, tolerance);
+}
@@ -0,0 +1,237 @@
+/*
+ * Host check of the transmitter's true-RMS trigger (rms.h) against the
+ * analog front end it can replace.
+ *
+ * Accuracy: a steady sine at currents across RMS_MIN_MA..RMS_MAX_MA is
+ * sampled as the ADC would (10 bits, mid-rail bias plus a DC offset, some
+ * noise, RMS_SAMPLE_HZ not a whole multiple of the mains), and every
+ * window's milliamps() is compared with the true RMS.
+ *
+ * Latency: the current steps from zero to a multiple of the on threshold at
+ * a random phase, and back to zero, and the time to each trigger change is
+ * measured for the RMS trigger and for a model of the analog path. The model
+ * is AutoVac1.asc's rectifier: the stage output through a 1N4148 (0.6 V)
+ * and 470 ohms into 100 uF, bled by 47 kohms, with the stage gain putting
+ * 5 A RMS at a 4.5 V peak. Its comparator levels are the reservoir voltages
+ * it settles at for the RMS trigger's on and off currents, so both paths
+ * switch at the same currents and differ only in speed. Thresholds whose
+ * peak is under the diode drop can't be seen by the analog path at all, and
+ * "never" for a release means not within RELEASE_LIMIT.
+ *
+ * Exit status is the number of accuracy failures (windows off by more than
+ * 2% or 5 mA).
+ *
+ * Usage: program [trials] [seed]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <random>
+
+#include "rms.h"
+
+const double MAINS_HZ = RMS_MAINS_HZ;
+const double SAMPLE_SECONDS = 1.0 / ((double)RMS_F_CPU / RMS_SAMPLE_CYCLES);
+const double OFFSET_COUNTS = 7;
+const double NOISE_COUNTS = 0.5;
+
+// Each trial runs until both paths have turned off, or this long after the
+// current does.
+const double RELEASE_LIMIT = 30;
+
+const double ANALOG_STEP = 20e-6;
+const double ANALOG_VOLTS_PER_AMP = 4.5 / (5 * M_SQRT2);   // Peak volts per RMS amp
+const double DIODE_VOLTS = 0.6;
+const double CHARGE_OHMS = 470;
+const double BLEED_OHMS = 47e3;
+const double RESERVOIR_FARADS = 100e-6;
+
+static std::mt19937 rng;
+
+// A current that is amps RMS from on until off seconds, at the given phase.
+struct Current {
+  double amps;
+  double phase;
+  double on;
+  double off;
+
+  double at(double t) const {
+    if (t < on || t >= off)
+      return 0;
+    return amps * M_SQRT2 * sin(2 * M_PI * MAINS_HZ * t + phase);
+  }
+};
+
+// One ADC reading of the current at t.
+static uint16_t sample(const Current &c, double t) {
+  std::normal_distribution<double> noise(0, NOISE_COUNTS);
+  double v = RMS_BIAS + OFFSET_COUNTS + c.at(t) * RMS_COUNTS_PER_AMP + noise(rng);
+  long counts = lround(v);
+  return counts < 0 ? 0 : counts > 1023 ? 1023 : counts;
+}
+
+// The rectifier and reservoir, stepped by ANALOG_STEP.
+struct Analog {
+  double volts = 0;
+
+  void step(double amps) {
+    double in = amps * ANALOG_VOLTS_PER_AMP - DIODE_VOLTS;
+    double current = -volts / BLEED_OHMS;
+    if (in > volts)
+      current += (in - volts) / CHARGE_OHMS;
+    volts += current * ANALOG_STEP / RESERVOIR_FARADS;
+  }
+};
+
+// Reservoir voltage the analog path settles at for a steady current, as the
+// mean over its last mains cycle.
+static double settle(double amps) {
+  Analog a;
+  Current c = {amps, 0, 0, 1e9};
+  double sum = 0;
+  long n = 0;
+  for (double t = 0; t < 3; t += ANALOG_STEP) {
+    a.step(c.at(t));
+    if (t >= 3 - 1 / MAINS_HZ) {
+      sum += a.volts;
+      n++;
+    }
+  }
+  return sum / n;
+}
+
+static int accuracy() {
+  int failures = 0;
+  printf("accuracy, %u samples/window, offset %.0f counts, noise %.1f counts RMS\n",
+    RMS_WINDOW, OFFSET_COUNTS, NOISE_COUNTS);
+  printf("  %8s %8s %8s %8s\n", "mA", "min mA", "max mA", "worst %");
+  const uint16_t levels[] = {100, 200, 500, 1000, 2000, 5000};
+  for (uint16_t ma : levels) {
+    RmsTrigger r;
+    r.configure(RMS_DEFAULT_ON_MA, RMS_DEFAULT_HYSTERESIS_MA);
+    Current c = {ma / 1000.0, std::uniform_real_distribution<double>(0, 2 * M_PI)(rng), 0, 1e9};
+    uint16_t lo = UINT16_MAX, hi = 0;
+    double worst = 0;
+    for (long i = 0; i < 200L * RMS_WINDOW; i++) {
+      if (r.count == RMS_WINDOW - 1) {
+        r.add(sample(c, i * SAMPLE_SECONDS));
+        uint16_t got = r.milliamps();
+        double error = fabs((double)got - ma);
+        lo = got < lo ? got : lo;
+        hi = got > hi ? got : hi;
+        worst = error > worst ? error : worst;
+        if (error > ma * 0.02 && error > 5)
+          failures++;
+      }
+      else {
+        r.add(sample(c, i * SAMPLE_SECONDS));
+      }
+    }
+    printf("  %8u %8u %8u %8.2f\n", ma, lo, hi, 100 * worst / ma);
+  }
+  return failures;
+}
+
+struct Latency {
+  double sum = 0;
+  double worst = 0;
+  int missed = 0;
+  int n = 0;
+
+  void add(double seconds) {
+    if (seconds < 0) {
+      missed++;
+      return;
+    }
+    sum += seconds;
+    worst = seconds > worst ? seconds : worst;
+    n++;
+  }
+
+  void print() const {
+    if (n == 0)
+      printf(" %9s %9s", "never", "");
+    else
+      printf(" %9.1f %9.1f", 1000 * sum / n, 1000 * worst);
+  }
+};
+
+// One step on about t = 0.5 s and off two seconds later, each at a random
+// point in a window. Latencies of each path, or -1 if it never switched.
+static void trial(uint16_t onMa, uint16_t offMa, double amps, double vOn, double vOff,
+                  Latency *rmsLatency, Latency *analogLatency) {
+  RmsTrigger r;
+  r.configure(onMa, onMa - offMa);
+  Analog a;
+  bool analogOn = false;
+  std::uniform_real_distribution<double> inWindow(0, RMS_WINDOW * SAMPLE_SECONDS);
+  double on = 0.5 + inWindow(rng);
+  Current c = {amps, std::uniform_real_distribution<double>(0, 2 * M_PI)(rng), on, on + 2 + inWindow(rng)};
+  double rmsEdge[2] = {-1, -1};
+  double analogEdge[2] = {-1, -1};
+  double nextSample = 0;
+
+  for (double t = 0; t < c.off + RELEASE_LIMIT && (rmsEdge[1] < 0 || analogEdge[1] < 0); t += ANALOG_STEP) {
+    a.step(c.at(t));
+    bool was = analogOn;
+    if (a.volts >= vOn)
+      analogOn = true;
+    else if (a.volts < vOff)
+      analogOn = false;
+    if (analogOn != was && analogEdge[!analogOn] < 0)
+      analogEdge[!analogOn] = t - (analogOn ? c.on : c.off);
+
+    if (t >= nextSample) {
+      nextSample += SAMPLE_SECONDS;
+      if (r.add(sample(c, t)) && rmsEdge[!r.on] < 0)
+        rmsEdge[!r.on] = t - (r.on ? c.on : c.off);
+    }
+  }
+  for (int i = 0; i < 2; i++) {
+    rmsLatency[i].add(rmsEdge[i]);
+    analogLatency[i].add(analogEdge[i]);
+  }
+}
+
+static void latency(int trials) {
+  printf("\nlatency from a current step to the trigger, ms mean and worst, %d phases each\n", trials);
+  printf("  %6s %6s %7s | %19s %19s | %19s %19s\n", "on mA", "off mA", "step mA",
+    "RMS on", "RMS off", "analog on", "analog off");
+  const uint16_t thresholds[] = {500, 1000, 2000};
+  const double multiples[] = {1.5, 3};
+  for (uint16_t onMa : thresholds) {
+    uint16_t offMa = onMa - onMa / 5;
+    double vOn = settle(onMa / 1000.0);
+    double vOff = settle(offMa / 1000.0);
+    for (double m : multiples) {
+      Latency rmsLatency[2], analogLatency[2];
+      for (int i = 0; i < trials; i++) {
+        if (vOn > 0.01)
+          trial(onMa, offMa, m * onMa / 1000.0, vOn, vOff, rmsLatency, analogLatency);
+        else
+          trial(onMa, offMa, m * onMa / 1000.0, INFINITY, INFINITY, rmsLatency, analogLatency);
+      }
+      printf("  %6u %6u %7.0f |", onMa, offMa, m * onMa);
+      rmsLatency[0].print();
+      rmsLatency[1].print();
+      printf(" |");
+      analogLatency[0].print();
+      analogLatency[1].print();
+      printf("\n");
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  int trials = argc > 1 ? atoi(argv[1]) : 20;
+  rng.seed(argc > 2 ? strtoul(argv[2], NULL, 0) : 1);
+
+  printf("%u samples/s, %u cycles per sample at %lu MHz, %u samples per %u Hz window\n\n",
+    RMS_SAMPLE_HZ, RMS_SAMPLE_CYCLES, (unsigned long)(RMS_F_CPU / 1000000), RMS_WINDOW, RMS_MAINS_HZ);
+  int failures = accuracy();
+  latency(trials);
+  printf("\n%d accuracy failures\n", failures);
+  return failures;
+}
@@ -0,0 +1,117 @@
+// Cycle budget of the RMS trigger kernel (rms.h) on the transmitter's
+// ATtiny85 at 8 MHz, which has no hardware multiplier. The kernel has to
+// finish well inside RMS_SAMPLE_CYCLES, the time between ADC samples.
+//
+// Measures, once at power-up:
+//   the longest single add() over every sample value, window ends included,
+//     timed with Timer1 at CK/8 less the cost of the timing itself
+//   the real interrupt load: idle loop iterations in one second with the ADC
+//     free-running and its interrupt running add(), against the same second
+//     with the ADC off, as CPU cycles per interrupt
+// The results go to EEPROM (RmsBenchResult at address 0) for reading back
+// with avrdude -U eeprom:r:-:h, and PB1 goes high if both are within budget,
+// PB2 if not.
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+
+#include "rms.h"
+
+const uint16_t LOAD_MS = 1000;
+
+struct RmsBenchResult {
+  uint16_t budget;       // RMS_SAMPLE_CYCLES
+  uint16_t worstAdd;     // Cycles; 0xFFFF if past Timer1's 2040-cycle reach
+  uint16_t interrupt;    // Cycles per ADC interrupt, from the load
+  uint16_t samples;      // ADC interrupts in LOAD_MS
+  uint32_t idleOff;      // Idle loop iterations in LOAD_MS, ADC off
+  uint32_t idleOn;       // and with it running
+};
+
+RmsBenchResult EEMEM result;
+
+RmsTrigger rms;
+volatile uint16_t samples = 0;
+volatile uint16_t sampleIn;
+
+void setup(void);
+void loop(void);
+bool addOnce(uint16_t sample) __attribute__((noinline));
+uint16_t worstAdd(void);
+uint32_t idle(void);
+
+bool addOnce(uint16_t sample) {
+  return rms.add(sample);
+}
+
+// Timer1 ticks at CK/8 around add(), or around nothing for the overhead.
+uint16_t worstAdd() {
+  uint8_t overhead = 0xFF;
+  uint8_t worst = 0;
+  TCCR1 = _BV(CS12);
+  for (uint16_t i = 0; i < 2 * 1024; i++) {
+    uint16_t sample = (i * 37) & 1023;
+    cli();
+    TIFR = _BV(TOV1);
+    TCNT1 = 0;
+    if (i & 1)
+      sampleIn = sample;
+    else
+      addOnce(sample);
+    uint8_t ticks = TCNT1;
+    bool wrapped = TIFR & _BV(TOV1);
+    sei();
+    if (wrapped)
+      return 0xFFFF;
+    if (i & 1)
+      overhead = min(overhead, ticks);
+    else
+      worst = max(worst, ticks);
+  }
+  TCCR1 = 0;
+  return (worst - overhead) * 8;
+}
+
+uint32_t idle() {
+  uint32_t n = 0;
+  uint32_t start = millis();
+  while (millis() - start < LOAD_MS)
+    n++;
+  return n;
+}
+
+void setup() {
+  DDRB = _BV(PB1) | _BV(PB2);
+  PORTB = 0;
+  rms.configure(RMS_DEFAULT_ON_MA, RMS_DEFAULT_HYSTERESIS_MA);
+
+  RmsBenchResult r;
+  r.budget = RMS_SAMPLE_CYCLES;
+  r.worstAdd = worstAdd();
+
+  r.idleOff = idle();
+  DIDR0 = _BV(ADC0D);
+  ADMUX = 0;
+  ADCSRB = 0;
+  samples = 0;
+  ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+  r.idleOn = idle();
+  ADCSRA = 0;
+  r.samples = samples;
+
+  // The iterations lost to the interrupts, as cycles per interrupt.
+  r.interrupt = (uint64_t)(r.idleOff - r.idleOn) * (RMS_F_CPU / 1000) * LOAD_MS / r.idleOff / r.samples;
+  eeprom_update_block(&r, &result, sizeof(r));
+
+  bool fits = r.worstAdd < r.budget && r.interrupt < r.budget;
+  PORTB = fits ? _BV(PB1) : _BV(PB2);
+}
+
+void loop() {
+}
+
+ISR(ADC_vect) {
+  samples++;
+  rms.add(ADC);
+}
@@ -0,0 +1,321 @@
+/*
+ * Host-side decoder for the receiver's EEPROM run log (runlog.h).
+ *
+ * Reads an Intel HEX dump of the receiver's EEPROM, as hvspcli dump writes
+ * it, and prints the totals, which go back to when the log was last erased,
+ * and the records still in the ring, oldest first: how long each run lasted,
+ * how long the collector had been off before it, what started it and what
+ * stopped it. Runs shorter than SHORT_RUN_SECONDS, or after less off time
+ * than that, are marked: those are the collector short-cycling.
+ *
+ * With sim, drives a receiver through runs ended each way (a keyfob STOP,
+ * the quiet timeout after a tool's last code, SHUTOFF_TIMEOUT under a tool
+ * that never stops), with the log written a byte per loop pass into the
+ * simulated EEPROM, and cuts the power at random, half the time while a run
+ * is being written. The log read back must hold exactly the runs that ended
+ * before each cut, less at most those still being written when it came, and
+ * every record must match the run as the output pin saw it. Prints the log,
+ * the most writes any cell took per run, and exits 1 on any mismatch. With
+ * out.hex the simulated EEPROM is saved there too, as a dump would be.
+ *
+ * Usage: program file.hex
+ *        program sim [runs] [cuts] [seed] [out.hex]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+#include "ihex.h"
+#include "receiver.h"
+#include "runlog.h"
+#include "sim.h"
+
+static const char *const STOP_NAMES[RUN_STOPS] = {"keyfob", "quiet", "shutoff", "other"};
+
+// The records in the ring, oldest first.
+static std::vector<RunRecord> records(const uint8_t *eeprom, uint16_t newestSeq) {
+  std::vector<RunRecord> all;
+  for (uint8_t i = 0; i < RUNLOG_RECORDS; i++) {
+    RunRecord r;
+    memcpy(&r, eeprom + RUNLOG_RECORD_BASE + i * sizeof(r), sizeof(r));
+    if (runLogValid((const uint8_t *)&r, sizeof(r)) && (int16_t)(newestSeq - r.seq) >= 0)
+      all.push_back(r);
+  }
+  std::sort(all.begin(), all.end(), [newestSeq](const RunRecord &a, const RunRecord &b) {
+    return (uint16_t)(newestSeq - a.seq) > (uint16_t)(newestSeq - b.seq);
+  });
+  return all;
+}
+
+static void printDuration(uint32_t s) {
+  if (s >= 3600)
+    printf("%3u:%02u:%02u", s / 3600, s / 60 % 60, s % 60);
+  else
+    printf("   %2u:%02u", s / 60, s % 60);
+}
+
+static void print(const uint8_t *eeprom) {
+  RunLogScan s;
+  s.scan([eeprom](uint16_t addr) { return eeprom[addr]; });
+  const RunTotals &t = s.totals;
+
+  unsigned other = t.seq;
+  for (uint8_t i = 0; i < RUN_STOP_OTHER; i++)
+    other -= t.stops[i];
+  printf("%u runs, %u short (under %u s), ", t.seq, t.shortRuns, SHORT_RUN_SECONDS);
+  printDuration(t.runSeconds);
+  printf(" on in all");
+  if (t.seq > 0)
+    printf(", %.0f s a run", (double)t.runSeconds / t.seq);
+  printf("\n");
+  for (uint8_t i = 0; i < RUN_STOPS; i++) {
+    unsigned n = i < RUN_STOP_OTHER ? t.stops[i] : other;
+    printf("  stopped by %-8s %6u  %5.1f%%\n", STOP_NAMES[i], n, t.seq ? 100.0 * n / t.seq : 0);
+  }
+  if (s.totalsBehind)
+    printf("  (totals brought up to date from the newest record)\n");
+
+  std::vector<RunRecord> all = records(eeprom, s.newestSeq);
+  printf("\n%zu records\n", all.size());
+  printf("%6s %9s %9s  %-7s %-8s\n", "seq", "off", "on", "start", "stop");
+  for (const RunRecord &r : all) {
+    printf("%6u ", r.seq);
+    if (r.offSeconds == RUN_OFF_UNKNOWN)
+      printf("%9s", "-");
+    else
+      printDuration(r.offSeconds);
+    putchar(' ');
+    printDuration(r.runSeconds());
+    printf("  %-7s %-8s%s\n", r.flags() & RUN_FLAG_KEYFOB ? "keyfob" : "tool",
+           STOP_NAMES[r.flags() & RUN_FLAG_STOP],
+           r.runSeconds() < SHORT_RUN_SECONDS || r.offSeconds < SHORT_RUN_SECONDS ? "  short" : "");
+  }
+}
+
+// How a simulated run is driven, and so how it should end.
+enum Scenario { KEYFOB_ONLY, TOOL_KEYFOB, TOOL_QUIET, TOOL_SHUTOFF, SCENARIOS };
+
+const uint32_t STEP_MS = 2;               // A loop pass per millis() tick
+const uint32_t RUNNING_PERIOD = 1500;     // Between a tool's RUNNING codes
+const uint32_t CUT_WINDOW = 150;          // After a stop, to catch a write
+
+struct SimRun {
+  uint16_t runSeconds, offSeconds;
+  uint8_t flags;
+};
+
+class LogSim {
+  public:
+    std::vector<SimRun> logged;   // Every run that should be in the log
+    unsigned mismatches = 0;
+    unsigned lost = 0;            // Runs whose record a power cut tore
+
+    explicit LogSim(unsigned long seed) : rng(seed) {}
+
+    void powerUp() {
+      receiver.reset(new Receiver());
+      receiver->begin();
+      receiver->runLog.begin();
+      stoppedOnce = false;
+      unsigned kept = receiver->runLog.currentTotals().seq;
+      // Only runs still being written when the power went may be missing.
+      if (kept > logged.size() || kept + inFlight < logged.size()) {
+        printf("after a cut: %u runs in the log, expected %zu less up to %u\n", kept, logged.size(), inFlight);
+        mismatches++;
+      }
+      if (kept < logged.size()) {
+        lost += logged.size() - kept;
+        logged.resize(kept);
+      }
+      inFlight = 0;
+    }
+
+    // One run, with the power cut during it or just after it ends if cut.
+    void run(bool cut) {
+      // Keyfob runs end before even the shortest quiet timeout.
+      std::uniform_int_distribution<uint32_t> idle(1000, 60000);
+      std::uniform_int_distribution<uint32_t> shortRun(500, QUIET_MIN_INTERVAL - 500);
+      std::uniform_int_distribution<uint32_t> toolRun(1000, 150000);
+      Scenario sc = (Scenario)std::uniform_int_distribution<int>(0, SCENARIOS - 1)(rng);
+      bool cutDuring = cut && rng() % 2;
+
+      step(halMillis() + idle(rng));
+      uint32_t start = halMillis();
+      uint32_t length = sc == KEYFOB_ONLY ? shortRun(rng)
+                      : sc == TOOL_SHUTOFF ? SHUTOFF_INTERVAL + 10000 : toolRun(rng);
+      uint32_t cutAt = start + rng() % length;
+      receiver->newInput(sc == KEYFOB_ONLY ? Code::START : Code::TOOL_STARTING);
+      if (!halSimOutput()) {
+        printf("run didn't start\n");
+        mismatches++;
+        return;
+      }
+      uint32_t on = halMillis();
+
+      uint32_t lastCode = start;
+      while (halSimOutput() && simBefore(halMillis(), start + length)) {
+        if (cutDuring && !simBefore(halMillis(), cutAt)) {
+          powerCut();
+          return;
+        }
+        step(halMillis() + STEP_MS);
+        if (sc != KEYFOB_ONLY && halSimOutput() && halMillis() - lastCode >= RUNNING_PERIOD) {
+          receiver->newInput(Code::TOOL_RUNNING);
+          lastCode = halMillis();
+        }
+      }
+      if (halSimOutput() && sc != TOOL_QUIET)
+        receiver->newInput(Code::STOP);
+      while (halSimOutput())
+        step(halMillis() + STEP_MS);
+
+      uint32_t off = halMillis();
+      RunStop expected = sc == TOOL_QUIET ? RUN_STOP_QUIET
+                       : sc == TOOL_SHUTOFF ? RUN_STOP_SHUTOFF : RUN_STOP_KEYFOB;
+      uint32_t offMs = on - lastOff;
+      SimRun r{(uint16_t)((off - on) / 1000),
+               stoppedOnce && offMs / 1000 < RUN_OFF_UNKNOWN ? (uint16_t)(offMs / 1000) : RUN_OFF_UNKNOWN,
+               (uint8_t)(expected | (sc == KEYFOB_ONLY ? RUN_FLAG_KEYFOB : 0))};
+      logged.push_back(r);
+      inFlight++;
+      lastOff = off;
+      stoppedOnce = true;
+
+      if (cut && !cutDuring) {
+        step(halMillis() + rng() % CUT_WINDOW);
+        powerCut();
+        return;
+      }
+      // The write finishes well before the next run can end.
+      step(halMillis() + CUT_WINDOW);
+      if (!receiver->runLog.isWriting())
+        inFlight = 0;
+    }
+
+    // Compare the log with the runs, newest first.
+    void check() {
+      const uint8_t *eeprom = halSimEeprom();
+      RunLogScan s;
+      s.scan([eeprom](uint16_t addr) { return eeprom[addr]; });
+      if (s.totals.seq != logged.size()) {
+        printf("log holds %u runs, expected %zu\n", s.totals.seq, logged.size());
+        mismatches++;
+        return;
+      }
+      RunTotals t = {};
+      for (size_t i = 0; i < logged.size(); i++) {
+        RunRecord r = {(uint16_t)(i + 1), (uint16_t)(logged[i].runSeconds | logged[i].flags << RUN_FLAGS_SHIFT),
+                       logged[i].offSeconds, 0};
+        t.add(r);
+      }
+      if (t.runSeconds != s.totals.runSeconds || t.shortRuns != s.totals.shortRuns ||
+          memcmp(t.stops, s.totals.stops, sizeof(t.stops)) != 0) {
+        printf("totals don't match the runs\n");
+        mismatches++;
+      }
+
+      std::vector<RunRecord> all = records(eeprom, s.newestSeq);
+      size_t expect = logged.size() < RUNLOG_RECORDS ? logged.size() : RUNLOG_RECORDS;
+      if (all.size() != expect) {
+        printf("%zu records in the ring, expected %zu\n", all.size(), expect);
+        mismatches++;
+        return;
+      }
+      for (size_t i = 0; i < all.size(); i++) {
+        const RunRecord &r = all[i];
+        const SimRun &e = logged[logged.size() - all.size() + i];
+        if (r.seq != logged.size() - all.size() + i + 1 || r.runSeconds() != e.runSeconds ||
+            r.offSeconds != e.offSeconds || r.flags() != e.flags) {
+          printf("record %u: %u s on, %u s off, flags %X; run was %u s, %u s, %X\n",
+                 r.seq, r.runSeconds(), r.offSeconds, r.flags(), e.runSeconds, e.offSeconds, e.flags);
+          mismatches++;
+        }
+      }
+    }
+
+  private:
+    void step(uint32_t t) {
+      while (simBefore(halMillis(), t)) {
+        halSimAdvance(STEP_MS);
+        receiver->poll();
+        receiver->runLog.poll();
+      }
+    }
+
+    void powerCut() {
+      halSimEepromPowerCut(rng());
+      halOutputOff();
+      halSimAdvance(1000);
+      powerUp();
+    }
+
+    std::unique_ptr<Receiver> receiver;
+    std::mt19937 rng;
+    unsigned inFlight = 0;
+    uint32_t lastOff = 0;
+    bool stoppedOnce = false;
+};
+
+static int simulate(unsigned runs, unsigned cuts, unsigned long seed, const char *out) {
+  LogSim sim(seed);
+  std::mt19937 pick(seed + 1);
+  halSimSetMillis(0);
+  sim.powerUp();
+  for (unsigned i = 0; i < runs; i++)
+    sim.run(pick() % runs < cuts);
+  sim.check();
+
+  print(halSimEeprom());
+  uint32_t most = 0;
+  for (uint16_t a = 0; a < HAL_SIM_EEPROM_SIZE; a++)
+    most = std::max(most, halSimEepromWrites()[a]);
+  printf("\n%u runs, %u power cuts planned, %u records torn: most writes to one cell %u, %.3f a run\n",
+         runs, cuts, sim.lost, most, (double)most / runs);
+  printf("%u mismatches\n", sim.mismatches);
+
+  if (out) {
+    HexImage image;
+    image.data.assign(halSimEeprom(), halSimEeprom() + HAL_SIM_EEPROM_SIZE);
+    image.used.assign(HAL_SIM_EEPROM_SIZE, true);
+    std::string error;
+    if (!image.save(out, error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+  }
+  return sim.mismatches > 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "sim") == 0) {
+    unsigned runs = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000;
+    unsigned cuts = argc > 3 ? strtoul(argv[3], NULL, 0) : 50;
+    unsigned long seed = argc > 4 ? strtoul(argv[4], NULL, 0) : 1;
+    return simulate(runs, cuts, seed, argc > 5 ? argv[5] : NULL);
+  }
+  if (argc != 2) {
+    fprintf(stderr, "usage: runlog file.hex | sim [runs] [cuts] [seed] [out.hex]\n");
+    return 2;
+  }
+
+  HexImage image;
+  std::string error;
+  if (!image.load(argv[1], error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  if (image.size() < RUNLOG_END) {
+    fprintf(stderr, "%s: %zu bytes, the log runs to %u\n", argv[1], image.size(), RUNLOG_END);
+    return 1;
+  }
+  print(image.data.data());
+  return 0;
+}
@@ -0,0 +1,640 @@
+/*
+ * Cycle-accurate benchmark of the receiver and transmitter firmware, running
+ * their ELF builds under simavr (pio run -e receiver -e transmitter first).
+ *
+ * Each firmware runs from reset for a fixed stretch of simulated time while
+ * its inputs are driven from the host:
+ *   receiver     tool runs on PA0-PA3 as the transmitters send them: STARTING,
+ *                RUNNING and STOPPED frames BIT_ON_TIME long, the bits of
+ *                each change up to SKEW_US apart, and every fifth frame after
+ *                a burst of BURST_EDGES pin changes BURST_US apart. With -r
+ *                the inputs come from a capture instead, as env:replay reads
+ *                them, starting STIMULUS_START in.
+ *   transmitter  the trigger on PB0 (active low) on and off for a few seconds
+ *                at a time, each edge bouncing as the comparator's does.
+ *
+ * Measured for each:
+ *   flash, static RAM (.data and .bss) and peak stack, in bytes
+ *   startup       cycles from reset until the core first sleeps
+ *   active        percentage of cycles not asleep after startup
+ *   each vector   invocations, mean and worst cycles from entry to reti,
+ *                 and worst latency from the interrupt being raised to its
+ *                 entry, which includes time with interrupts off
+ *   code path     transmitter only: worst and mean cycles from the watchdog
+ *                 or Timer1 interrupt to the code outputs changing, the
+ *                 codeOn()/codeOff() path of a frame
+ *   transitions   receiver only: the transition table's and newInput()'s
+ *                 size in flash, from the ELF's symbols, and for each
+ *                 (state, code) pair seen, calls and mean and worst cycles
+ *                 of newInput() from entry to return, less any interrupts
+ *                 taken meanwhile. The state is followed on the host with
+ *                 transition(), which env:transitions checks against the
+ *                 receiver; the code is newInput()'s argument in r22.
+ *
+ * The transmitter is also run from a cold start with the trigger already on,
+ * as it is when powered from the tool's outlet, for:
+ *   reset to frame  cycles from reset until the first code goes out
+ *
+ * Results are "firmware,metric,value" rows, in a fixed order so two runs
+ * diff line by line. compare lists every metric of two result files with
+ * its change, marking those more than 1% worse; every metric is better
+ * lower. Its exit status is the number so marked, at most 255.
+ *
+ * Usage: program [-s seconds] [-r trace] [-o results.csv] [receiver.elf [transmitter.elf]]
+ *        program compare old.csv new.csv
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_irq.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/sim_interrupts.h>
+#include <simavr/avr_ioport.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <gelf.h>
+
+#include "codes.h"
+#include "transitions.h"
+#include "transmitter.h"
+#include "trace.h"
+
+const uint32_t STIMULUS_START_MS = 4000;   // After any startup blink or self-test
+const double COLD_START_SECONDS = 5;
+const uint32_t SKEW_US = 200;
+const uint8_t BURST_EDGES = 8;
+const uint32_t BURST_US = 5;
+const uint32_t BOUNCE_US = 50;
+const double REGRESSION = 0.01;
+
+const char *const TINY84_VECTORS[] = {
+  "RESET", "INT0", "PCINT0", "PCINT1", "WDT", "TIM1_CAPT", "TIM1_COMPA", "TIM1_COMPB",
+  "TIM1_OVF", "TIM0_COMPA", "TIM0_COMPB", "TIM0_OVF", "ANA_COMP", "ADC", "EE_RDY",
+  "USI_STR", "USI_OVF",
+};
+
+const char *const TINY85_VECTORS[] = {
+  "RESET", "INT0", "PCINT0", "TIM1_COMPA", "TIM1_OVF", "TIM0_OVF", "EE_RDY", "ANA_COMP",
+  "ADC", "TIM1_COMPB", "TIM0_COMPA", "TIM0_COMPB", "WDT", "USI_START", "USI_OVF",
+};
+
+const char *const STATE_NAMES[MOTOR_STATES] = {"OFF", "MANUAL_RUN", "AUTO_RUN"};
+
+const char *const CODE_NAMES[CODE_COUNT] = {
+  "NONE", "START", "STOP", "ID_4", "BUTTON_C", "ID_5", "ID_6", "ID_0",
+  "TOOL_STOPPED", "TOOL_STARTING", "ID_1", "TOOL_RUNNING", "ID_7", "ID_2", "ID_3", "MASK",
+  "CODE_SEQ_TIMEOUT", "TOOL_QUIET_TIMEOUT", "SHUTOFF_TIMEOUT",
+};
+
+// Symbols of the receiver's state machine, by prefix: LTO may add a suffix.
+const char *const NEW_INPUT_SYMBOL = "_ZN8Receiver8newInputE4Code";
+const char *const TRANSITIONS_SYMBOL = "TRANSITIONS";
+
+// One input pin level, at a time in microseconds from reset.
+struct Stimulus {
+  uint64_t us;
+  char port;
+  uint8_t pin;
+  bool level;
+
+  bool operator<(const Stimulus &other) const {
+    return us < other.us;
+  }
+};
+
+struct Firmware {
+  const char *name;
+  const char *mcu;
+  uint32_t hz;
+  const char *const *vectors;
+  uint8_t vectorCount;
+  bool codePath;
+  bool coldStart;   // Only until the first frame, for reset to frame
+  bool transitions;
+};
+
+const Firmware RECEIVER = {"receiver", "attiny84", 8000000, TINY84_VECTORS,
+  sizeof(TINY84_VECTORS) / sizeof(TINY84_VECTORS[0]), false, false, true};
+const Firmware TRANSMITTER = {"transmitter", "attiny85", 8000000, TINY85_VECTORS,
+  sizeof(TINY85_VECTORS) / sizeof(TINY85_VECTORS[0]), true, false, false};
+const Firmware TRANSMITTER_COLD = {"transmitter", "attiny85", 8000000, TINY85_VECTORS,
+  sizeof(TINY85_VECTORS) / sizeof(TINY85_VECTORS[0]), true, true, false};
+
+struct VectorStats {
+  uint64_t count = 0;
+  uint64_t cycles = 0;
+  uint64_t worst = 0;
+  uint64_t worstLatency = 0;
+  bool pending = false;
+  uint64_t raisedAt = 0;
+  uint64_t enteredAt = 0;
+};
+
+struct TransitionStats {
+  uint64_t count = 0;
+  uint64_t cycles = 0;
+  uint64_t worst = 0;
+};
+
+// Address and size of the first symbol whose name starts with prefix.
+static bool elfSymbol(const char *path, const char *prefix, uint32_t &address, uint32_t &size) {
+  if (elf_version(EV_CURRENT) == EV_NONE)
+    return false;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  Elf *e = elf_begin(fd, ELF_C_READ, NULL);
+  bool found = false;
+  Elf_Scn *scn = NULL;
+  while (e && !found && (scn = elf_nextscn(e, scn)) != NULL) {
+    GElf_Shdr shdr;
+    if (!gelf_getshdr(scn, &shdr) || shdr.sh_type != SHT_SYMTAB)
+      continue;
+    Elf_Data *data = elf_getdata(scn, NULL);
+    size_t n = shdr.sh_entsize ? shdr.sh_size / shdr.sh_entsize : 0;
+    for (size_t i = 0; data && i < n && !found; i++) {
+      GElf_Sym sym;
+      if (!gelf_getsym(data, i, &sym))
+        continue;
+      const char *name = elf_strptr(e, shdr.sh_link, sym.st_name);
+      if (name && strncmp(name, prefix, strlen(prefix)) == 0) {
+        address = sym.st_value;
+        size = sym.st_size;
+        found = true;
+      }
+    }
+  }
+  if (e)
+    elf_end(e);
+  close(fd);
+  return found;
+}
+
+class Bench;
+
+// Context for the IRQ callbacks of one vector or pin.
+struct Hook {
+  Bench *bench;
+  uint8_t n;
+};
+
+class Bench {
+  public:
+    Bench(const Firmware &fw, std::vector<Stimulus> stimuli)
+      : fw(fw), stimuli(std::move(stimuli)), vectors(fw.vectorCount) {}
+
+    bool run(const char *path, double seconds, FILE *out);
+
+  private:
+    const Firmware &fw;
+    avr_t *avr = NULL;
+    std::vector<Stimulus> stimuli;
+    size_t nextStimulus = 0;
+    std::vector<VectorStats> vectors;
+    std::vector<Hook> hooks;
+
+    uint64_t wakeAt = 0;       // Entry to the last watchdog or Timer1 interrupt
+    bool awaitingOutput = false;
+    uint64_t codePathCount = 0;
+    uint64_t codePathSum = 0;
+    uint64_t codePathWorst = 0;
+    uint64_t firstFrame = 0;   // Cycle a code output first went active (low)
+
+    uint64_t isrCycles = 0;    // In all vectors, entry to reti
+    uint32_t newInputPc = 0;   // 0 if the ELF has no newInput() to time
+    bool inNewInput = false;
+    uint16_t newInputSp = 0;   // Stack pointer on entry, below the return address
+    uint64_t newInputStart = 0;
+    uint64_t newInputIsrStart = 0;
+    uint8_t newInputCode = 0;
+    MotorState state = MotorState::OFF;
+    std::vector<TransitionStats> transitions =
+      std::vector<TransitionStats>(MOTOR_STATES * CODE_COUNT);
+
+    uint64_t cycles(uint64_t us) const {
+      return us * (fw.hz / 1000000);
+    }
+
+    static avr_cycle_count_t stimulate(avr_t *avr, avr_cycle_count_t when, void *param);
+    static void pending(avr_irq_t *irq, uint32_t value, void *param);
+    static void running(avr_irq_t *irq, uint32_t value, void *param);
+    static void output(avr_irq_t *irq, uint32_t value, void *param);
+    void followNewInput(uint16_t sp);
+};
+
+// Apply the stimuli due, and come back for the next.
+avr_cycle_count_t Bench::stimulate(avr_t *avr, avr_cycle_count_t when, void *param) {
+  Bench *b = (Bench *)param;
+  while (b->nextStimulus < b->stimuli.size() && b->cycles(b->stimuli[b->nextStimulus].us) <= when) {
+    const Stimulus &s = b->stimuli[b->nextStimulus++];
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(s.port), s.pin), s.level);
+  }
+  if (b->nextStimulus == b->stimuli.size())
+    return 0;
+  return std::max<avr_cycle_count_t>(b->cycles(b->stimuli[b->nextStimulus].us), when + 1);
+}
+
+void Bench::pending(avr_irq_t *, uint32_t value, void *param) {
+  Hook *h = (Hook *)param;
+  VectorStats &v = h->bench->vectors[h->n];
+  if (value && !v.pending)
+    v.raisedAt = h->bench->avr->cycle;
+  v.pending = value;
+}
+
+void Bench::running(avr_irq_t *, uint32_t value, void *param) {
+  Hook *h = (Hook *)param;
+  Bench *b = h->bench;
+  VectorStats &v = b->vectors[h->n];
+  uint64_t now = b->avr->cycle;
+  if (value) {
+    v.enteredAt = now;
+    v.worstLatency = std::max(v.worstLatency, now - v.raisedAt);
+    const char *name = b->fw.vectors[h->n];
+    if (b->fw.codePath && (strcmp(name, "WDT") == 0 || strcmp(name, "TIM1_COMPA") == 0)) {
+      b->wakeAt = now;
+      b->awaitingOutput = true;
+    }
+  }
+  else {
+    v.count++;
+    v.cycles += now - v.enteredAt;
+    v.worst = std::max(v.worst, now - v.enteredAt);
+    b->isrCycles += now - v.enteredAt;
+  }
+}
+
+// A code output changed; the first change after a wake ends the code path.
+// The outputs are active low, so the first low level is the first frame.
+void Bench::output(avr_irq_t *, uint32_t value, void *param) {
+  Bench *b = (Bench *)param;
+  if (!value && !b->firstFrame)
+    b->firstFrame = b->avr->cycle;
+  if (!b->awaitingOutput)
+    return;
+  b->awaitingOutput = false;
+  uint64_t c = b->avr->cycle - b->wakeAt;
+  b->codePathCount++;
+  b->codePathSum += c;
+  b->codePathWorst = std::max(b->codePathWorst, c);
+}
+
+// Called after every instruction: time newInput() from its first instruction
+// until its return pops the stack above where it was on entry, and follow the
+// state machine to know which transition each call was.
+void Bench::followNewInput(uint16_t sp) {
+  if (!inNewInput) {
+    if (avr->pc != newInputPc)
+      return;
+    inNewInput = true;
+    newInputSp = sp;
+    newInputStart = avr->cycle;
+    newInputIsrStart = isrCycles;
+    newInputCode = avr->data[22];
+    return;
+  }
+  if (sp <= newInputSp)
+    return;
+  inNewInput = false;
+  if (newInputCode >= CODE_COUNT)
+    return;
+  uint64_t c = avr->cycle - newInputStart - (isrCycles - newInputIsrStart);
+  TransitionStats &t = transitions[(uint8_t)state * CODE_COUNT + newInputCode];
+  t.count++;
+  t.cycles += c;
+  t.worst = std::max(t.worst, c);
+  uint8_t next = transition(state, (Code)newInputCode);
+  if (next & T_VALID)
+    state = (MotorState)(next & T_STATE);
+}
+
+bool Bench::run(const char *path, double seconds, FILE *out) {
+  elf_firmware_t f;
+  memset(&f, 0, sizeof(f));
+  if (elf_read_firmware(path, &f) != 0) {
+    fprintf(stderr, "%s: can't read firmware\n", path);
+    return false;
+  }
+  avr = avr_make_mcu_by_name(fw.mcu);
+  if (!avr) {
+    fprintf(stderr, "simavr has no %s\n", fw.mcu);
+    return false;
+  }
+  avr_init(avr);
+  f.frequency = fw.hz;
+  avr_load_firmware(avr, &f);
+  avr->frequency = fw.hz;
+
+  hooks.reserve(fw.vectorCount);
+  for (uint8_t n = 1; n < fw.vectorCount; n++) {
+    avr_irq_t *irq = avr_get_interrupt_irq(avr, n);
+    if (!irq)
+      continue;
+    hooks.push_back(Hook{this, n});
+    avr_irq_register_notify(irq + AVR_INT_IRQ_PENDING, pending, &hooks.back());
+    avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING, running, &hooks.back());
+  }
+  uint32_t newInputBytes = 0, tableAddress = 0, tableBytes = 0;
+  if (fw.transitions) {
+    if (!elfSymbol(path, NEW_INPUT_SYMBOL, newInputPc, newInputBytes))
+      fprintf(stderr, "%s: no %s symbol, so no transition timings\n", fw.name, NEW_INPUT_SYMBOL);
+    elfSymbol(path, TRANSITIONS_SYMBOL, tableAddress, tableBytes);
+  }
+  if (fw.codePath) {
+    for (uint8_t pin = 1; pin <= 4; pin++)
+      avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), pin), output, this);
+  }
+
+  // Levels at reset, then the rest on time.
+  while (nextStimulus < stimuli.size() && stimuli[nextStimulus].us == 0) {
+    const Stimulus &s = stimuli[nextStimulus++];
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(s.port), s.pin), s.level);
+  }
+  if (nextStimulus < stimuli.size())
+    avr_cycle_timer_register(avr, cycles(stimuli[nextStimulus].us), stimulate, this);
+
+  uint64_t end = (uint64_t)(seconds * fw.hz);
+  uint64_t startup = 0;
+  uint64_t asleep = 0;
+  uint64_t awake = 0;
+  uint16_t lowestSp = avr->ramend;
+  while (avr->cycle < end && !(fw.coldStart && firstFrame)) {
+    uint64_t before = avr->cycle;
+    bool sleeping = avr->state == cpu_Sleeping;
+    int state = avr_run(avr);
+    if (state == cpu_Done || state == cpu_Crashed) {
+      fprintf(stderr, "%s: stopped at %llu cycles, pc 0x%04x\n", fw.name,
+        (unsigned long long)avr->cycle, (unsigned)avr->pc);
+      return false;
+    }
+    if (startup) {
+      if (sleeping)
+        asleep += avr->cycle - before;
+      else
+        awake += avr->cycle - before;
+    }
+    else if (avr->state == cpu_Sleeping) {
+      startup = avr->cycle;
+    }
+    uint16_t sp = avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+    lowestSp = std::min(lowestSp, sp);
+    if (newInputPc)
+      followNewInput(sp);
+  }
+
+  if (fw.coldStart) {
+    if (!firstFrame) {
+      fprintf(stderr, "%s: no frame within %.0f s of reset\n", fw.name, seconds);
+      return false;
+    }
+    fprintf(out, "%s,reset_to_frame_cycles,%llu\n", fw.name, (unsigned long long)firstFrame);
+    avr_terminate(avr);
+    return true;
+  }
+
+  fprintf(out, "%s,flash_bytes,%u\n", fw.name, f.flashsize);
+  fprintf(out, "%s,ram_static_bytes,%u\n", fw.name, f.datasize + f.bsssize);
+  fprintf(out, "%s,stack_peak_bytes,%u\n", fw.name, avr->ramend - lowestSp);
+  fprintf(out, "%s,startup_cycles,%llu\n", fw.name, (unsigned long long)startup);
+  fprintf(out, "%s,active_percent,%.3f\n", fw.name,
+    asleep + awake ? 100.0 * awake / (asleep + awake) : 100.0);
+  for (uint8_t n = 1; n < fw.vectorCount; n++) {
+    const VectorStats &v = vectors[n];
+    if (v.count == 0)
+      continue;
+    const char *name = fw.vectors[n];
+    fprintf(out, "%s,%s_count,%llu\n", fw.name, name, (unsigned long long)v.count);
+    fprintf(out, "%s,%s_cycles_mean,%.1f\n", fw.name, name, (double)v.cycles / v.count);
+    fprintf(out, "%s,%s_cycles_worst,%llu\n", fw.name, name, (unsigned long long)v.worst);
+    fprintf(out, "%s,%s_latency_worst,%llu\n", fw.name, name, (unsigned long long)v.worstLatency);
+  }
+  if (fw.codePath && codePathCount) {
+    fprintf(out, "%s,code_path_cycles_mean,%.1f\n", fw.name, (double)codePathSum / codePathCount);
+    fprintf(out, "%s,code_path_cycles_worst,%llu\n", fw.name, (unsigned long long)codePathWorst);
+  }
+  if (tableBytes)
+    fprintf(out, "%s,transition_table_bytes,%u\n", fw.name, tableBytes);
+  if (newInputPc) {
+    fprintf(out, "%s,new_input_bytes,%u\n", fw.name, newInputBytes);
+    uint64_t worst = 0;
+    for (uint8_t s = 0; s < MOTOR_STATES; s++) {
+      for (uint8_t c = 0; c < CODE_COUNT; c++) {
+        const TransitionStats &t = transitions[s * CODE_COUNT + c];
+        if (t.count == 0)
+          continue;
+        fprintf(out, "%s,%s_%s_count,%llu\n", fw.name, STATE_NAMES[s], CODE_NAMES[c], (unsigned long long)t.count);
+        fprintf(out, "%s,%s_%s_cycles_mean,%.1f\n", fw.name, STATE_NAMES[s], CODE_NAMES[c], (double)t.cycles / t.count);
+        fprintf(out, "%s,%s_%s_cycles_worst,%llu\n", fw.name, STATE_NAMES[s], CODE_NAMES[c], (unsigned long long)t.worst);
+        worst = std::max(worst, t.worst);
+      }
+    }
+    fprintf(out, "%s,transition_cycles_worst,%llu\n", fw.name, (unsigned long long)worst);
+  }
+  avr_terminate(avr);
+  return true;
+}
+
+// One frame's pins changing from one code to another at us, each bit up to
+// SKEW_US late.
+static void frameEdge(std::vector<Stimulus> &s, std::mt19937 &rng, uint64_t us, uint8_t from, uint8_t to) {
+  std::uniform_int_distribution<uint32_t> skew(0, SKEW_US);
+  for (uint8_t b = 0; b < 4; b++) {
+    if ((from ^ to) & (1 << b))
+      s.push_back(Stimulus{us + skew(rng), 'A', b, (to >> b & 1) != 0});
+  }
+}
+
+// Tool runs of a few seconds, with gaps of a few seconds between them.
+static std::vector<Stimulus> receiverStimuli(double seconds, unsigned long seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<uint32_t> interval(INTERVAL_MIN, INTERVAL_MAX);
+  std::uniform_int_distribution<uint32_t> stopped(STOPPED_INTERVAL_MIN, STOPPED_INTERVAL_MAX);
+  std::uniform_int_distribution<uint32_t> runFrames(4, 10);
+  std::vector<Stimulus> s;
+  for (uint8_t b = 0; b < 4; b++)
+    s.push_back(Stimulus{0, 'A', b, false});
+
+  uint64_t ms = STIMULUS_START_MS;
+  uint64_t end = (uint64_t)(seconds * 1000);
+  unsigned frames = 0;
+  while (ms < end) {
+    unsigned n = runFrames(rng);
+    for (unsigned i = 0; i < n + STOPPED_CODE_COUNT; i++) {
+      Code c = i < STARTUP_CODE_COUNT ? Code::TOOL_STARTING : i < n ? Code::TOOL_RUNNING : Code::TOOL_STOPPED;
+      if (++frames % 5 == 0) {
+        for (uint8_t e = 0; e < BURST_EDGES; e++)
+          s.push_back(Stimulus{ms * 1000 - (BURST_EDGES - e) * BURST_US, 'A', 0, (e & 1) == 0});
+      }
+      frameEdge(s, rng, ms * 1000, 0, (uint8_t)c);
+      frameEdge(s, rng, (ms + BIT_ON_TIME) * 1000, (uint8_t)c, 0);
+      ms += i + 1 < n ? interval(rng) : stopped(rng);
+    }
+    ms += 3 * INTERVAL_MAX;
+  }
+  std::stable_sort(s.begin(), s.end());
+  return s;
+}
+
+// A capture's input changes, from STIMULUS_START_MS on.
+static bool traceStimuli(const char *path, std::vector<Stimulus> &s) {
+  PinTraceReader trace;
+  std::string error;
+  if (!trace.open(path, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return false;
+  }
+  for (uint8_t b = 0; b < 4; b++)
+    s.push_back(Stimulus{0, 'A', b, false});
+  uint8_t bits = 0;
+  PinEdge e;
+  while (trace.next(e)) {
+    for (uint8_t b = 0; b < 4; b++) {
+      if ((bits ^ e.bits) & (1 << b))
+        s.push_back(Stimulus{STIMULUS_START_MS * 1000 + e.ns / 1000, 'A', b, (e.bits >> b & 1) != 0});
+    }
+    bits = e.bits;
+  }
+  if (!trace.error.empty()) {
+    fprintf(stderr, "%s: %s\n", path, trace.error.c_str());
+    return false;
+  }
+  return true;
+}
+
+// The trigger pulled low for a few seconds at a time, bouncing at each edge.
+static std::vector<Stimulus> transmitterStimuli(double seconds, unsigned long seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<uint32_t> onTime(3000, 10000);
+  std::uniform_int_distribution<uint32_t> offTime(2000, 6000);
+  std::vector<Stimulus> s;
+  s.push_back(Stimulus{0, 'B', 0, true});
+  uint64_t ms = STIMULUS_START_MS;
+  uint64_t end = (uint64_t)(seconds * 1000);
+  bool on = false;
+  while (ms < end) {
+    on = !on;
+    for (uint8_t i = 0; i < 3; i++) {
+      s.push_back(Stimulus{ms * 1000 + 2 * i * BOUNCE_US, 'B', 0, !on});
+      s.push_back(Stimulus{ms * 1000 + (2 * i + 1) * BOUNCE_US, 'B', 0, on});
+    }
+    s.push_back(Stimulus{ms * 1000 + 6 * BOUNCE_US, 'B', 0, !on});
+    ms += on ? onTime(rng) : offTime(rng);
+  }
+  return s;
+}
+
+static bool readResults(const char *path, std::vector<std::string> &keys, std::map<std::string, double> &values) {
+  FILE *in = fopen(path, "r");
+  if (!in) {
+    perror(path);
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), in)) {
+    char *comma = strrchr(line, ',');
+    if (!comma)
+      continue;
+    *comma = '\0';
+    if (strcmp(line, "firmware,metric") == 0)
+      continue;
+    keys.push_back(line);
+    values[line] = atof(comma + 1);
+  }
+  fclose(in);
+  return true;
+}
+
+static int compare(const char *oldPath, const char *newPath) {
+  std::vector<std::string> oldKeys, newKeys;
+  std::map<std::string, double> oldValues, newValues;
+  if (!readResults(oldPath, oldKeys, oldValues) || !readResults(newPath, newKeys, newValues))
+    return 255;
+  unsigned regressions = 0;
+  printf("%-36s %12s %12s %9s\n", "metric", "old", "new", "change");
+  for (const std::string &k : newKeys) {
+    double now = newValues[k];
+    if (!oldValues.count(k)) {
+      printf("%-36s %12s %12.1f %9s\n", k.c_str(), "-", now, "new");
+      continue;
+    }
+    double was = oldValues[k];
+    double change = was != 0 ? (now - was) / was : now != 0 ? 1 : 0;
+    bool worse = change > REGRESSION;
+    regressions += worse;
+    printf("%-36s %12.1f %12.1f %+8.1f%%%s\n", k.c_str(), was, now, 100 * change, worse ? " !" : "");
+  }
+  for (const std::string &k : oldKeys) {
+    if (!newValues.count(k))
+      printf("%-36s %12.1f %12s %9s\n", k.c_str(), oldValues[k], "-", "gone");
+  }
+  printf("%u regressions over %.0f%%\n", regressions, 100 * REGRESSION);
+  return regressions > 255 ? 255 : regressions;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "compare") == 0) {
+    if (argc != 4) {
+      fprintf(stderr, "Usage: %s compare old.csv new.csv\n", argv[0]);
+      return 255;
+    }
+    return compare(argv[2], argv[3]);
+  }
+
+  double seconds = 30;
+  const char *trace = NULL;
+  const char *outPath = NULL;
+  int arg = 1;
+  for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+    if (strcmp(argv[arg], "-s") == 0)
+      seconds = atof(argv[arg + 1]);
+    else if (strcmp(argv[arg], "-r") == 0)
+      trace = argv[arg + 1];
+    else if (strcmp(argv[arg], "-o") == 0)
+      outPath = argv[arg + 1];
+    else
+      break;
+  }
+  if (argc - arg > 2 || (arg < argc && argv[arg][0] == '-')) {
+    fprintf(stderr, "Usage: %s [-s seconds] [-r trace] [-o results.csv] [receiver.elf [transmitter.elf]]\n"
+                    "       %s compare old.csv new.csv\n", argv[0], argv[0]);
+    return 255;
+  }
+  const char *receiverElf = arg < argc ? argv[arg] : ".pio/build/receiver/firmware.elf";
+  const char *transmitterElf = arg + 1 < argc ? argv[arg + 1] : ".pio/build/transmitter/firmware.elf";
+
+  std::vector<Stimulus> rx;
+  if (trace) {
+    if (!traceStimuli(trace, rx))
+      return 255;
+  }
+  else {
+    rx = receiverStimuli(seconds, 1);
+  }
+
+  FILE *out = outPath ? fopen(outPath, "w") : stdout;
+  if (!out) {
+    perror(outPath);
+    return 255;
+  }
+  fprintf(out, "firmware,metric,value\n");
+  Bench receiver(RECEIVER, rx);
+  Bench transmitter(TRANSMITTER, transmitterStimuli(seconds, 1));
+  Bench cold(TRANSMITTER_COLD, {Stimulus{0, 'B', 0, false}});
+  bool ok = receiver.run(receiverElf, seconds, out);
+  ok = transmitter.run(transmitterElf, seconds, out) && ok;
+  ok = cold.run(transmitterElf, COLD_START_SECONDS, out) && ok;
+  if (out != stdout)
+    fclose(out);
+  return ok ? 0 : 1;
+}
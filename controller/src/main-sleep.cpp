@@ -0,0 +1,184 @@
+/*
+ * Host-side measurement of the receiver's sleeping main loop.
+ *
+ * Real time is modelled in microseconds, and the clock is the receiver's
+ * Timer1 (rxclock.h): 128 us counts, read as whole milliseconds. loop() runs
+ * once per wakeup, and between wakeups the core is idle. It wakes after
+ * every pin change interrupt, on Timer1's compare at the first count at or
+ * after the earlier of Receiver::nextDeadline() and the next statistics
+ * frame, and when Timer1 wraps. One transmitter cycles a tool on and off as
+ * in main-native.cpp.
+ *
+ * Reported:
+ *   wakeups per second, split into deadlines, statistics frames, Timer1
+ *     wraps and pin changes, against timer0's free-running millis() tick
+ *   estimated time awake, from assumed cycle costs per wakeup (the busy-polling
+ *     loop this replaced was awake 100% of the time)
+ *   quiet timeout jitter: time from the leading edge of the last TOOL_RUNNING
+ *     frame to the output switching off, relative to QUIET_INTERVAL
+ *
+ * Usage: program [hours] [timerWakeCycles] [pinWakeCycles] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <random>
+
+#include "hal.h"
+#include "receiver.h"
+#include "transmitter.h"
+#include "sim.h"
+
+const double F_CPU_HZ = 8000000.0;
+const uint64_t COUNT_MICROS = 128;                 // Timer1 at CK/1024
+const uint64_t WRAP_MICROS = 65536 * COUNT_MICROS;
+const uint64_t TIMER0_TICK_MICROS = 2048;          // The tick it replaces
+const uint32_t STATS_PERIOD = 10000;               // As main-receiver.cpp
+
+static Receiver receiver;
+static Transmitter transmitter;
+
+int main(int argc, char **argv) {
+  double hours = argc > 1 ? atof(argv[1]) : 24;
+  // A pass costs a few hundred cycles, and each read of the clock a 32-bit
+  // division, several hundred more.
+  double timerWakeCycles = argc > 2 ? atof(argv[2]) : 1500;
+  double pinWakeCycles = argc > 3 ? atof(argv[3]) : 2500;
+  unsigned long seed = argc > 4 ? strtoul(argv[4], NULL, 0) : 1;
+
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<uint32_t> runTime(500, 20000);
+  std::uniform_int_distribution<uint32_t> idleTime(0, 30000);
+  std::uniform_int_distribution<uint32_t> phase(0, 999);
+
+  uint64_t end = (uint64_t)(hours * 3600e6);
+  uint64_t now = 0;
+  uint64_t nextWrap = WRAP_MICROS;
+  uint32_t statsSent = 0;
+  uint64_t deadlineWakes = 0, statsWakes = 0, wrapWakes = 0, pinWakes = 0;
+
+  // Transmitter schedule, in microseconds.
+  bool toolOn = false;
+  uint64_t toolChange = (uint64_t)idleTime(rng) * 1000;
+  uint64_t nextEdge = UINT64_MAX;
+  bool codeOn = false;
+  uint64_t lastRunningEdge = 0;
+
+  int64_t jitterMin = INT64_MAX, jitterMax = INT64_MIN;
+  double jitterSum = 0;
+  uint64_t jitterCount = 0;
+
+  // Jitter is measured against the fixed interval.
+  receiver.adaptiveQuiet = false;
+  halSimSetMillis(0);
+  receiver.begin();
+  bool output = false;
+
+  while (now < end) {
+    // Compare B: the first count at which the clock reads the wakeup time.
+    uint32_t wakeMs = statsSent + STATS_PERIOD;
+    bool forStats = true;
+    if (receiver.hasDeadline() && (int32_t)(receiver.nextDeadline() - wakeMs) < 0) {
+      wakeMs = receiver.nextDeadline();
+      forStats = false;
+    }
+    uint64_t wake = ((uint64_t)wakeMs * 1000 + COUNT_MICROS - 1) / COUNT_MICROS * COUNT_MICROS;
+    if (wake <= now)
+      wake = now + COUNT_MICROS;
+
+    uint64_t next = wake;
+    if (nextWrap < next) next = nextWrap;
+    if (toolChange < next) next = toolChange;
+    if (nextEdge < next) next = nextEdge;
+    now = next;
+    halSimSetMillis((uint32_t)(now / COUNT_MICROS * COUNT_MICROS / 1000));
+
+    if (now == wake || now == nextWrap) {
+      if (now == nextWrap) {
+        nextWrap += WRAP_MICROS;
+        wrapWakes++;
+      }
+      else if (forStats) {
+        statsWakes++;
+      }
+      else {
+        deadlineWakes++;
+      }
+      receiver.poll();
+      if (halMillis() - statsSent >= STATS_PERIOD)
+        statsSent = halMillis();
+    }
+
+    if (now == toolChange) {
+      toolOn = !toolOn;
+      halSimSetTrigger(toolOn);
+      transmitter.readTrigger();
+      if (toolOn) {
+        toolChange = now + (uint64_t)runTime(rng) * 1000;
+        if (nextEdge == UINT64_MAX)
+          nextEdge = now + phase(rng);
+      }
+      else {
+        toolChange = now + (uint64_t)idleTime(rng) * 1000;
+      }
+    }
+
+    if (now == nextEdge) {
+      bool pinChanged = true;
+      if (!codeOn) {
+        if (transmitter.triggered) {
+          Code c = transmitter.nextCode();
+          halSimSetCodeInputs((uint8_t)c);
+          if (c == Code::TOOL_RUNNING || c == Code::TOOL_STARTING)
+            lastRunningEdge = now;
+          codeOn = true;
+          nextEdge = now + BIT_ON_TIME * 1000;
+        }
+        else {
+          nextEdge = UINT64_MAX;
+          pinChanged = false;
+        }
+      }
+      else {
+        halSimSetCodeInputs(0);
+        codeOn = false;
+        nextEdge = now + (uint64_t)(BIT_ON_TIME + transmitter.nextInterval(INTERVAL_MIN, INTERVAL_MAX)) * 1000;
+      }
+      if (pinChanged) {
+        receiver.onPinChange();
+        receiver.poll();
+        pinWakes++;
+      }
+    }
+
+    if (output && !halSimOutput() && !toolOn) {
+      int64_t jitter = (int64_t)(now - lastRunningEdge) - (int64_t)QUIET_INTERVAL * 1000;
+      if (jitter < jitterMin) jitterMin = jitter;
+      if (jitter > jitterMax) jitterMax = jitter;
+      jitterSum += jitter;
+      jitterCount++;
+    }
+    output = halSimOutput();
+  }
+
+  double seconds = now / 1e6;
+  uint64_t timerWakes = deadlineWakes + statsWakes + wrapWakes;
+  double awakeCycles = timerWakes * timerWakeCycles + pinWakes * pinWakeCycles;
+
+  printf("simulated %.1f h, Timer1 count %llu us\n", hours, (unsigned long long)COUNT_MICROS);
+  printf("  wakeups/s            %10.3f (deadlines %.3f, stats %.3f, wraps %.3f, pin changes %.3f)\n",
+    (timerWakes + pinWakes) / seconds, deadlineWakes / seconds, statsWakes / seconds,
+    wrapWakes / seconds, pinWakes / seconds);
+  printf("  timer0 tick wakeups/s %9.1f, not taken\n", 1e6 / TIMER0_TICK_MICROS);
+  printf("  time awake           %10.3f %% (assuming %.0f cycles/timer wakeup, %.0f cycles/pin change)\n",
+    100.0 * awakeCycles / (F_CPU_HZ * seconds), timerWakeCycles, pinWakeCycles);
+  if (jitterCount) {
+    printf("  quiet timeout        %10llu samples\n", (unsigned long long)jitterCount);
+    printf("  quiet timeout late   min %lld  mean %.0f  max %lld us (spread %lld us)\n",
+      (long long)jitterMin, jitterSum / jitterCount, (long long)jitterMax,
+      (long long)(jitterMax - jitterMin));
+  }
+  printf("  queue overflows      %10u\n", receiver.queue.overflows());
+  return 0;
+}
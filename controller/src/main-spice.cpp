@@ -0,0 +1,462 @@
+/*
+ * Sweeps of the transmitter's analog trigger (transmitter/LTSpice/AutoVac1.asc)
+ * in ngspice, one batch run per point across all cores, measuring how fast
+ * the hardware trigger follows the load.
+ *
+ * The schematic is converted as ltspice.h describes, then per point:
+ *   load current  I1, the current transformer's secondary, is a 60 Hz sine
+ *                 of the load's RMS current times sqrt(2) over the CT ratio
+ *                 (-r, 1000:1 by default, which makes the schematic's 2 mA
+ *                 peak 1.4 A). V3 switches it on SWITCH_ON_S in, for LOAD_S.
+ *   threshold pot R9 and R12, the divider setting the comparator's
+ *                 threshold, as one pot of their total resistance with the
+ *                 wiper the given fraction of the way up from ground (the
+ *                 schematic's 39K of 49K is 0.8).
+ *   supply        V2.
+ * Noise from the schematic's white() source is left out unless -n, as its
+ * 0.5 us steps make each run take minutes.
+ *
+ * Measured from each run, with the trigger output Vout active low:
+ *   assert        ms from the load switching on to Vout falling through half
+ *                 the supply
+ *   deassert      ms from the load switching off to Vout rising again, within
+ *                 RELEASE_S
+ *   ripple        peak-to-peak mV at the comparator input Vcap, over the
+ *                 RIPPLE_S before the load switches off, with its mean and
+ *                 that of the threshold Vcomp
+ *   edges         Vout transitions while the load is on, which firmware
+ *                 debouncing has to absorb; 1 is a clean trigger
+ * A status of no-trigger (Vout never fell), stuck (low before the load came
+ * on), no-release or failed (ngspice, with -k keeping its log) marks points
+ * whose times are missing.
+ *
+ * Sweeps are a list (a,b,c) or a range (from:to:points), the current's
+ * spaced logarithmically and the others evenly. Results are CSV rows, to
+ * -o or stdout; a summary per supply and pot position, with the smallest
+ * current that triggers and the spread of the latencies, goes to stderr.
+ * netlist writes the converted schematic, with its own .tran, for running
+ * by hand.
+ *
+ * Needs ngspice (-x for another binary); the PSpice models need its psa
+ * compatibility mode, which each run's .spiceinit sets.
+ *
+ * Usage: program [-j jobs] [-i amps] [-p positions] [-v volts] [-r ratio]
+ *                [-n] [-k] [-x ngspice] [-o results.csv] [schematic.asc]
+ *        program netlist [-n] [schematic.asc]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ltspice.h"
+
+const double SWITCH_ON_S = 0.5;    // After the bias and coupling settle
+const double LOAD_S = 2;
+const double RELEASE_S = 6;        // C3 discharges through R5, 4.7 s
+const double RIPPLE_S = 0.1;       // Six cycles
+const double LINE_HZ = 60;
+const char *MAX_STEP = "100u";
+
+const char *SUPPLY = "V2";
+const char *SWITCH = "V3";
+const char *CT = "I1";
+const char *POT_HIGH = "R9";
+const char *POT_LOW = "R12";
+
+const char *DEFAULT_SCHEMATIC = "../transmitter/LTSpice/AutoVac1.asc";
+
+struct Point {
+  double amps, pot, volts;
+};
+
+struct Measured {
+  double assertMs = NAN;
+  double deassertMs = NAN;
+  double rippleMv = NAN;
+  double vcap = NAN;
+  double vcomp = NAN;
+  unsigned edges = 0;
+  const char *status = "failed";
+};
+
+// A resistor value with its SPICE suffix, in ohms.
+double spiceNumber(const std::string &s) {
+  char *end;
+  double v = strtod(s.c_str(), &end);
+  std::string suffix;
+  for (; *end; end++)
+    suffix += tolower((unsigned char)*end);
+  if (suffix.compare(0, 3, "meg") == 0)
+    return v * 1e6;
+  switch (suffix.empty() ? ' ' : suffix[0]) {
+    case 't': return v * 1e12;
+    case 'g': return v * 1e9;
+    case 'k': return v * 1e3;
+    case 'm': return v * 1e-3;
+    case 'u': return v * 1e-6;
+    case 'n': return v * 1e-9;
+    case 'p': return v * 1e-12;
+    case 'f': return v * 1e-15;
+  }
+  return v;
+}
+
+bool parseSweep(const char *spec, bool logarithmic, std::vector<double> &values) {
+  values.clear();
+  double from, to;
+  unsigned points;
+  char tail;
+  if (sscanf(spec, "%lf:%lf:%u%c", &from, &to, &points, &tail) == 3) {
+    if (points == 0 || (logarithmic && (from <= 0 || to <= 0)))
+      return false;
+    for (unsigned i = 0; i < points; i++) {
+      double f = points == 1 ? 0 : (double)i / (points - 1);
+      values.push_back(logarithmic ? from * pow(to / from, f) : from + (to - from) * f);
+    }
+    return true;
+  }
+  std::string s(spec);
+  size_t start = 0;
+  while (start <= s.size()) {
+    size_t comma = s.find(',', start);
+    if (comma == std::string::npos)
+      comma = s.size();
+    char *end;
+    std::string field = s.substr(start, comma - start);
+    double v = strtod(field.c_str(), &end);
+    if (field.empty() || *end)
+      return false;
+    values.push_back(v);
+    start = comma + 1;
+  }
+  return !values.empty();
+}
+
+bool writeText(const std::string &path, const std::string &text) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (!f)
+    return false;
+  bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+  return fclose(f) == 0 && ok;
+}
+
+// The first time from start on that v crosses level in the given direction,
+// interpolated between samples, or NAN.
+double crossing(const std::vector<double> &t, const std::vector<double> &v,
+                double start, double level, bool rising) {
+  for (size_t i = 1; i < t.size(); i++) {
+    if (t[i] < start)
+      continue;
+    bool before = rising ? v[i - 1] < level : v[i - 1] > level;
+    bool after = rising ? v[i] >= level : v[i] <= level;
+    if (before && after) {
+      double f = (level - v[i - 1]) / (v[i] - v[i - 1]);
+      return std::max(start, t[i - 1] + f * (t[i] - t[i - 1]));
+    }
+  }
+  return NAN;
+}
+
+// wrdata's columns: time, then Vout, Vcap and Vcomp.
+Measured measure(const std::string &path, double volts) {
+  Measured m;
+  FILE *f = fopen(path.c_str(), "r");
+  if (!f)
+    return m;
+  std::vector<double> t, out, cap, comp;
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    double c[4];
+    if (sscanf(line, "%lf %lf %lf %lf", &c[0], &c[1], &c[2], &c[3]) == 4) {
+      t.push_back(c[0]);
+      out.push_back(c[1]);
+      cap.push_back(c[2]);
+      comp.push_back(c[3]);
+    }
+  }
+  fclose(f);
+  if (t.size() < 2)
+    return m;
+
+  double level = volts / 2;
+  double on = SWITCH_ON_S, off = SWITCH_ON_S + LOAD_S;
+  double sum = 0, compSum = 0, lo = INFINITY, hi = -INFINITY;
+  unsigned n = 0;
+  bool stuck = false;
+  for (size_t i = 0; i < t.size(); i++) {
+    if (t[i] <= on && i + 1 < t.size() && t[i + 1] > on)
+      stuck = out[i] < level;
+    if (t[i] > on && t[i] < off && i > 0 && (out[i] < level) != (out[i - 1] < level))
+      m.edges++;
+    if (t[i] >= off - RIPPLE_S && t[i] < off) {
+      lo = std::min(lo, cap[i]);
+      hi = std::max(hi, cap[i]);
+      sum += cap[i];
+      compSum += comp[i];
+      n++;
+    }
+  }
+  if (n > 0) {
+    m.rippleMv = (hi - lo) * 1000;
+    m.vcap = sum / n;
+    m.vcomp = compSum / n;
+  }
+
+  if (stuck) {
+    m.status = "stuck";
+    return m;
+  }
+  double low = crossing(t, out, on, level, false);
+  if (isnan(low) || low >= off) {
+    m.status = "no-trigger";
+    return m;
+  }
+  m.assertMs = (low - on) * 1000;
+  double high = crossing(t, out, off, level, true);
+  if (isnan(high)) {
+    m.status = "no-release";
+    return m;
+  }
+  m.deassertMs = (high - off) * 1000;
+  m.status = "ok";
+  return m;
+}
+
+struct Sweep {
+  AscSchematic schematic;
+  std::string root;          // Work directory, holding the fixed-up models
+  std::string ngspice = "ngspice";
+  double ratio = 1000;
+  double potTotal = 0;
+  bool noise = false;
+  bool keep = false;
+
+  Measured run(unsigned index, const Point &p) {
+    std::map<std::string, std::string> values;
+    char v[128];
+    snprintf(v, sizeof(v), "%g", p.volts);
+    values[SUPPLY] = v;
+    snprintf(v, sizeof(v), "SIN(0 %g %g)", p.amps * sqrt(2.0) / ratio, LINE_HZ);
+    values[CT] = v;
+    snprintf(v, sizeof(v), "PULSE(0 1 %g 1m 1m %g 1000)", SWITCH_ON_S, LOAD_S);
+    values[SWITCH] = v;
+    snprintf(v, sizeof(v), "%g", std::max(1.0, potTotal * (1 - p.pot)));
+    values[POT_HIGH] = v;
+    snprintf(v, sizeof(v), "%g", std::max(1.0, potTotal * p.pot));
+    values[POT_LOW] = v;
+
+    std::string dir = root + "/" + std::to_string(index);
+    mkdir(dir.c_str(), 0755);
+    std::string cir = schematic.netlist(values, noise, false, root);
+    snprintf(v, sizeof(v), ".tran 0 %g 0 %s\n", SWITCH_ON_S + LOAD_S + RELEASE_S, MAX_STEP);
+    cir += v;
+    cir += ".control\n"
+           "set wr_singlescale\n"
+           "run\n"
+           "wrdata out.txt v(vout) v(vcap) v(vcomp)\n"
+           "quit\n"
+           ".endc\n"
+           ".end\n";
+    if (!writeText(dir + "/.spiceinit", "set ngbehavior=psa\nset num_threads=1\n") ||
+        !writeText(dir + "/run.cir", cir))
+      return Measured();
+
+    std::string command = "cd '" + dir + "' && exec '" + ngspice +
+                          "' -b -o run.log run.cir >/dev/null 2>&1";
+    if (system(command.c_str()) != 0)
+      return Measured();
+    Measured m = measure(dir + "/out.txt", p.volts);
+    if (!keep)
+      unlink((dir + "/out.txt").c_str());
+    return m;
+  }
+};
+
+void printValue(FILE *f, double v, const char *format) {
+  if (isnan(v))
+    fputc(',', f);
+  else
+    fprintf(f, format, v);
+}
+
+int main(int argc, char **argv) {
+  bool netlistOnly = argc > 1 && strcmp(argv[1], "netlist") == 0;
+  int arg = netlistOnly ? 2 : 1;
+  unsigned jobs = std::thread::hardware_concurrency();
+  Sweep sweep;
+  const char *outPath = NULL;
+  std::vector<double> amps, pots, volts;
+  parseSweep("0.1:5:12", true, amps);
+  parseSweep("0.2:0.8:4", false, pots);
+  parseSweep("4.5,5,5.5", false, volts);
+
+  bool ok = true;
+  for (; arg < argc && argv[arg][0] == '-'; arg++) {
+    const char *flag = argv[arg];
+    if (strcmp(flag, "-n") == 0) {
+      sweep.noise = true;
+      continue;
+    }
+    if (strcmp(flag, "-k") == 0) {
+      sweep.keep = true;
+      continue;
+    }
+    if (arg + 1 >= argc) {
+      ok = false;
+      break;
+    }
+    const char *value = argv[++arg];
+    if (strcmp(flag, "-j") == 0)
+      jobs = strtoul(value, NULL, 0);
+    else if (strcmp(flag, "-i") == 0)
+      ok = ok && parseSweep(value, true, amps);
+    else if (strcmp(flag, "-p") == 0)
+      ok = ok && parseSweep(value, false, pots);
+    else if (strcmp(flag, "-v") == 0)
+      ok = ok && parseSweep(value, false, volts);
+    else if (strcmp(flag, "-r") == 0)
+      sweep.ratio = atof(value);
+    else if (strcmp(flag, "-x") == 0)
+      sweep.ngspice = value;
+    else if (strcmp(flag, "-o") == 0)
+      outPath = value;
+    else
+      ok = false;
+  }
+  if (!ok || argc - arg > 1 || sweep.ratio <= 0) {
+    fprintf(stderr, "Usage: %s [-j jobs] [-i amps] [-p positions] [-v volts] [-r ratio]\n"
+                    "          [-n] [-k] [-x ngspice] [-o results.csv] [schematic.asc]\n"
+                    "       %s netlist [-n] [schematic.asc]\n"
+                    "Sweeps are a,b,c or from:to:points.\n", argv[0], argv[0]);
+    return 2;
+  }
+  if (jobs == 0)
+    jobs = 1;
+
+  std::string error;
+  const char *path = arg < argc ? argv[arg] : DEFAULT_SCHEMATIC;
+  if (!sweep.schematic.load(path, error)) {
+    fprintf(stderr, "%s: %s\n", path, error.c_str());
+    return 1;
+  }
+  if (netlistOnly) {
+    printf("%s.end\n", sweep.schematic.netlist({}, sweep.noise, true).c_str());
+    return 0;
+  }
+
+  for (const char *name : {SUPPLY, SWITCH, CT, POT_HIGH, POT_LOW}) {
+    if (!sweep.schematic.find(name)) {
+      fprintf(stderr, "%s: no %s\n", path, name);
+      return 1;
+    }
+  }
+  sweep.potTotal = spiceNumber(sweep.schematic.find(POT_HIGH)->value) +
+                   spiceNumber(sweep.schematic.find(POT_LOW)->value);
+
+  char root[] = "/tmp/autovac-spice.XXXXXX";
+  if (!mkdtemp(root)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  sweep.root = root;
+  if (!sweep.schematic.writeModels(sweep.root, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  // Current varies fastest, so each summary row below is a run of points.
+  std::vector<Point> points;
+  for (double v : volts)
+    for (double p : pots)
+      for (double a : amps)
+        points.push_back(Point{a, p, v});
+  std::vector<Measured> results(points.size());
+  std::atomic<unsigned> next(0);
+  std::atomic<unsigned> done(0);
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < jobs; i++) {
+    pool.emplace_back([&]() {
+      unsigned k;
+      while ((k = next++) < points.size()) {
+        results[k] = sweep.run(k, points[k]);
+        fprintf(stderr, "\r%u/%zu", ++done, points.size());
+      }
+    });
+  }
+  for (std::thread &t : pool)
+    t.join();
+  fprintf(stderr, "\n");
+
+  FILE *out = outPath ? fopen(outPath, "w") : stdout;
+  if (!out) {
+    perror(outPath);
+    return 1;
+  }
+  fprintf(out, "current_a,pot,supply_v,assert_ms,deassert_ms,ripple_mv,vcap_v,vcomp_v,edges,status\n");
+  unsigned failed = 0;
+  for (size_t i = 0; i < points.size(); i++) {
+    const Point &p = points[i];
+    const Measured &m = results[i];
+    fprintf(out, "%.4g,%.3g,%.3g,", p.amps, p.pot, p.volts);
+    printValue(out, m.assertMs, "%.2f,");
+    printValue(out, m.deassertMs, "%.2f,");
+    printValue(out, m.rippleMv, "%.2f,");
+    printValue(out, m.vcap, "%.4f,");
+    printValue(out, m.vcomp, "%.4f,");
+    fprintf(out, "%u,%s\n", m.edges, m.status);
+    if (strcmp(m.status, "failed") == 0)
+      failed++;
+  }
+  if (outPath)
+    fclose(out);
+
+  fprintf(stderr, "%7s %5s %9s %19s %19s %10s\n", "supply", "pot", "trips at",
+          "assert ms", "deassert ms", "ripple mV");
+  for (size_t i = 0; i < points.size(); i += amps.size()) {
+    double trips = NAN, aLo = INFINITY, aHi = 0, dLo = INFINITY, dHi = 0, ripple = 0;
+    for (size_t j = i; j < i + amps.size(); j++) {
+      const Measured &m = results[j];
+      if (!isnan(m.assertMs)) {
+        if (isnan(trips))
+          trips = points[j].amps;
+        aLo = std::min(aLo, m.assertMs);
+        aHi = std::max(aHi, m.assertMs);
+      }
+      if (!isnan(m.deassertMs)) {
+        dLo = std::min(dLo, m.deassertMs);
+        dHi = std::max(dHi, m.deassertMs);
+      }
+      if (!isnan(m.rippleMv))
+        ripple = std::max(ripple, m.rippleMv);
+    }
+    fprintf(stderr, "%6.2fV %5.2f ", points[i].volts, points[i].pot);
+    if (isnan(trips))
+      fprintf(stderr, "%9s %19s", "never", "");
+    else
+      fprintf(stderr, "%8.3gA %8.1f - %8.1f", trips, aLo, aHi);
+    if (dHi > 0)
+      fprintf(stderr, " %8.1f - %8.1f", dLo, dHi);
+    else
+      fprintf(stderr, " %19s", "");
+    fprintf(stderr, " %10.1f\n", ripple);
+  }
+
+  if (sweep.keep)
+    fprintf(stderr, "Runs kept in %s\n", root);
+  else
+    system(("rm -rf '" + sweep.root + "'").c_str());
+  if (failed)
+    fprintf(stderr, "%u of %zu runs failed\n", failed, points.size());
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Host-side decoder for the receiver's statistics frames (stats.h).
+ *
+ * Reads the raw bytes the receiver sends on its USI serial line, from a
+ * capture file or from stdin (e.g. a serial port set to 19200 8N1 raw), and
+ * prints every frame that passes its checksum: the event counters, and the
+ * inter-code gap and collector run time histograms with cumulative fractions,
+ * which is what the timeouts in receiver.h should be sized against.
+ *
+ * With sim, runs one simulated transmitter and the receiver as main-native.cpp
+ * does, then sends the receiver's statistics through the same frame writer
+ * and decoder, so the whole path can be checked without hardware.
+ *
+ * Usage: program [file|-]
+ *        program sim [cycles] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <random>
+
+#include "hal.h"
+#include "receiver.h"
+#include "transmitter.h"
+#include "stats.h"
+#include "sim.h"
+
+static const char *const STAT_NAMES[RECEIVER_STATS] = {
+  "codes", "rejected", "glitches", "queue overflows",
+  "code seq timeouts", "quiet timeouts", "shutoff timeouts", "collector starts",
+};
+
+// Finds frames in a byte stream. Bytes that don't make a good frame are
+// skipped, one at a time, until the next sync pattern.
+class StatsParser {
+  public:
+    uint64_t badFrames = 0;
+
+    // Feed one byte; true when it completes a good frame, now in out.
+    bool feed(uint8_t b, ReceiverStats &out) {
+      if (length < sizeof(frame))
+        frame[length++] = b;
+      while (length > 0) {
+        int r = check();
+        if (r > 0) {
+          for (uint8_t i = 0; i < RECEIVER_STATS + 2 * STATS_BUCKETS; i++) {
+            uint16_t v = frame[4 + 2 * i] | (frame[5 + 2 * i] << 8);
+            if (i < RECEIVER_STATS)
+              out.counters[i] = v;
+            else if (i < RECEIVER_STATS + STATS_BUCKETS)
+              out.gaps[i - RECEIVER_STATS] = v;
+            else
+              out.runTimes[i - RECEIVER_STATS - STATS_BUCKETS] = v;
+          }
+          length = 0;
+          return true;
+        }
+        if (r == 0)
+          return false;
+        if (length == STATS_FRAME_SIZE)
+          badFrames++;
+        memmove(frame, frame + 1, --length);
+      }
+      return false;
+    }
+
+  private:
+    uint8_t frame[STATS_FRAME_SIZE];
+    uint8_t length = 0;
+
+    // 1 for a good frame, 0 for a good start that needs more bytes, -1 for
+    // garbage at the front.
+    int check() const {
+      if (frame[0] != STATS_SYNC_0 || (length > 1 && frame[1] != STATS_SYNC_1))
+        return -1;
+      if (length > 2 && frame[2] != STATS_FRAME_TYPE)
+        return -1;
+      if (length > 3 && frame[3] != STATS_PAYLOAD_SIZE)
+        return -1;
+      if (length < STATS_FRAME_SIZE)
+        return 0;
+
+      uint8_t sum1 = 0, sum2 = 0;
+      for (uint8_t i = 2; i < STATS_FRAME_SIZE - 2; i++) {
+        sum1 += frame[i];
+        sum2 += sum1;
+      }
+      return sum1 == frame[STATS_FRAME_SIZE - 2] && sum2 == frame[STATS_FRAME_SIZE - 1] ? 1 : -1;
+    }
+};
+
+static void printHistogram(const char *name, const uint16_t *buckets, uint8_t shift, const char *unit) {
+  uint32_t total = 0;
+  for (uint8_t b = 0; b < STATS_BUCKETS; b++)
+    total += buckets[b];
+  printf("  %s, %u samples\n", name, total);
+  if (total == 0)
+    return;
+
+  uint32_t cumulative = 0;
+  for (uint8_t b = 0; b < STATS_BUCKETS; b++) {
+    if (buckets[b] == 0)
+      continue;
+    cumulative += buckets[b];
+    uint32_t lo = b == 0 ? 0 : (1U << (b - 1)) << shift;
+    char range[32];
+    if (b == STATS_BUCKETS - 1)
+      snprintf(range, sizeof(range), ">= %u %s", lo, unit);
+    else
+      snprintf(range, sizeof(range), "%u - %u %s", lo, ((1U << b) << shift) - 1, unit);
+    printf("    %-20s %6u  %6.4f\n", range, buckets[b], (double)cumulative / total);
+  }
+}
+
+static void printStats(uint64_t frame, const ReceiverStats &s) {
+  printf("frame %llu\n", (unsigned long long)frame);
+  for (uint8_t i = 0; i < RECEIVER_STATS; i++)
+    printf("  %-22s %6u%s\n", STAT_NAMES[i], s.counters[i], s.counters[i] == UINT16_MAX ? " (saturated)" : "");
+  printHistogram("gap between codes", s.gaps, GAP_UNIT_SHIFT, "ms");
+  printHistogram("collector run time", s.runTimes, RUN_UNIT_SHIFT, "ms");
+}
+
+static Receiver receiver;
+static Transmitter transmitter;
+
+// One transmitter cycling a tool on and off, as in main-native.cpp.
+static void simulate(unsigned long cycles, unsigned long seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<uint32_t> runTime(500, 20000);
+  std::uniform_int_distribution<uint32_t> idleTime(0, 30000);
+
+  halSimSetMillis(0);
+  receiver.begin();
+
+  for (unsigned long i = 0; i < cycles; i++) {
+    uint32_t start = halMillis() + idleTime(rng);
+    uint32_t release = start + runTime(rng);
+
+    simAdvanceTo(receiver, start);
+    halSimSetTrigger(true);
+    transmitter.readTrigger();
+
+    uint32_t t = start;
+    uint32_t frameEnd = start;
+    while (simBefore(t, release)) {
+      simSetInputs(receiver, t, (uint8_t)transmitter.nextCode());
+      frameEnd = t + BIT_ON_TIME;
+      simSetInputs(receiver, frameEnd, 0);
+      t += BIT_ON_TIME + transmitter.nextInterval(INTERVAL_MIN, INTERVAL_MAX);
+      simAdvanceTo(receiver, simBefore(t, release) ? t : release);
+    }
+
+    simAdvanceTo(receiver, release);
+    halSimSetTrigger(false);
+    transmitter.readTrigger();
+    uint32_t s = simBefore(release, frameEnd) ? frameEnd : release;
+    for (uint8_t n = 0; n < STOPPED_CODE_COUNT; n++) {
+      simSetInputs(receiver, s, (uint8_t)Code::TOOL_STOPPED);
+      simSetInputs(receiver, s + BIT_ON_TIME, 0);
+      s += BIT_ON_TIME + transmitter.nextInterval(STOPPED_INTERVAL_MIN, STOPPED_INTERVAL_MAX);
+    }
+
+    while (receiver.hasDeadline())
+      simAdvanceTo(receiver, receiver.nextDeadline());
+  }
+  receiver.stats.set(STAT_OVERFLOWS, receiver.queue.overflows());
+}
+
+int main(int argc, char **argv) {
+  StatsParser parser;
+  ReceiverStats stats = {};
+  uint64_t frames = 0;
+
+  if (argc > 1 && strcmp(argv[1], "sim") == 0) {
+    unsigned long cycles = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000;
+    unsigned long seed = argc > 3 ? strtoul(argv[3], NULL, 0) : 1;
+    simulate(cycles, seed);
+
+    StatsFrameWriter writer;
+    writer.begin(&receiver.stats);
+    uint8_t b;
+    while (writer.next(b)) {
+      if (parser.feed(b, stats))
+        printStats(++frames, stats);
+    }
+    if (frames != 1 || memcmp(&stats, &receiver.stats, sizeof(stats)) != 0) {
+      printf("decoded frame doesn't match the receiver's statistics\n");
+      return 1;
+    }
+    return 0;
+  }
+
+  FILE *in = stdin;
+  if (argc > 1 && strcmp(argv[1], "-") != 0) {
+    in = fopen(argv[1], "rb");
+    if (!in) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+
+  int c;
+  while ((c = getc(in)) != EOF) {
+    if (parser.feed((uint8_t)c, stats)) {
+      printStats(++frames, stats);
+      fflush(stdout);
+    }
+  }
+  printf("%llu frames, %llu bad\n", (unsigned long long)frames, (unsigned long long)parser.badFrames);
+  return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * Host-side check of the receiver's transition table against a plain
+ * reference model of the state machine, for every (state, code) pair.
+ *
+ * Each pair is tried from every point in an ID sequence, with and without a
+ * following STOPPED, and with and without another identified tool active. The
+ * reference is written out case by case, the way newInput() used to be, so
+ * the table generated by transition() is checked against an independent
+ * statement of the behaviour. Every mismatch is printed; the exit status is
+ * the number of failed cases. A last case checks that a tool table entry
+ * doesn't come back to life after more than 65.5 s without a code.
+ *
+ * Then prints the table itself: its size in flash, and per state the next
+ * state and actions for each valid code, with the most actions any one
+ * transition runs.
+ *
+ * Usage: program
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "hal.h"
+#include "receiver.h"
+
+static const char *const CODE_NAMES[CODE_COUNT] = {
+  "NONE", "START", "STOP", "ID_4", "BUTTON_C", "ID_5", "ID_6", "ID_0",
+  "TOOL_STOPPED", "TOOL_STARTING", "ID_1", "TOOL_RUNNING", "ID_7", "ID_2", "ID_3", "MASK",
+  "CODE_SEQ_TIMEOUT", "TOOL_QUIET_TIMEOUT", "SHUTOFF_TIMEOUT",
+};
+
+static const char *const STATE_NAMES[MOTOR_STATES] = { "OFF", "MANUAL_RUN", "AUTO_RUN" };
+
+static const uint8_t OTHER_TOOL = 5;
+static const uint8_t ID_HIGH = 2;
+
+// What a receiver looks like from outside.
+struct Snapshot {
+  MotorState state;
+  bool output;
+  IdSequence seq;
+  bool idStopped;
+  uint32_t runningTime;
+  bool quietArmed;
+  uint32_t quietAt;
+  bool shutoffArmed;
+  bool codeSeqArmed;
+  uint8_t activeTools;
+};
+
+static Snapshot snapshot(const Receiver &r) {
+  Snapshot s;
+  s.state = r.currentOutputState;
+  s.output = halSimOutput();
+  s.seq = r.idSequence;
+  s.idStopped = r.idStopped;
+  s.runningTime = r.runningCodeReceivedTime;
+  s.quietArmed = r.timers.isArmed(QUIET_TIMER);
+  s.quietAt = s.quietArmed ? r.timers.deadline(QUIET_TIMER) : 0;
+  s.shutoffArmed = r.timers.isArmed(SHUTOFF_TIMER);
+  s.codeSeqArmed = r.timers.isArmed(CODE_SEQ_TIMER);
+  s.activeTools = r.tools.activeCount();
+  return s;
+}
+
+static void refToolRunning(Snapshot &e, uint32_t now) {
+  e.runningTime = now;
+  if (e.state != MotorState::OFF) {
+    e.quietArmed = true;
+    e.quietAt = now + QUIET_INTERVAL + 1;
+  }
+}
+
+static void refToolStopped(Snapshot &e, uint32_t now) {
+  if (e.state == MotorState::OFF || e.activeTools > 0)
+    return;
+  uint32_t when = now + STOPPED_RUN_ON + 1;
+  if (!e.quietArmed || (int32_t)(when - e.quietAt) < 0) {
+    e.quietArmed = true;
+    e.quietAt = when;
+  }
+}
+
+// The state machine as a switch over codes, from the state before.
+static Snapshot reference(const Snapshot &before, Code c, uint32_t now) {
+  Snapshot e = before;
+  if (!isValidCode(c))
+    return e;
+
+  switch (c) {
+    case Code::START:
+    case Code::TOOL_STARTING:
+      if (e.state == MotorState::OFF) {
+        e.output = true;
+        e.shutoffArmed = true;
+      }
+      e.state = MotorState::MANUAL_RUN;
+      refToolRunning(e, now);
+      e.seq = c == Code::TOOL_STARTING ? SEQ_ID_HIGH : SEQ_NONE;
+      e.idStopped = false;
+      break;
+
+    case Code::STOP:
+    case Code::TOOL_QUIET_TIMEOUT:
+    case Code::SHUTOFF_TIMEOUT:
+      if (e.state != MotorState::OFF) {
+        e.output = false;
+        e.quietArmed = e.shutoffArmed = e.codeSeqArmed = false;
+        e.quietAt = 0;
+      }
+      e.state = MotorState::OFF;
+      e.seq = SEQ_NONE;
+      break;
+
+    case Code::TOOL_RUNNING:
+      refToolRunning(e, now);
+      e.seq = SEQ_ID_HIGH;
+      e.idStopped = false;
+      break;
+
+    case Code::TOOL_STOPPED:
+      refToolStopped(e, now);
+      e.seq = SEQ_ID_HIGH;
+      e.idStopped = true;
+      break;
+
+    case Code::CODE_SEQ_TIMEOUT:
+      e.seq = SEQ_NONE;
+      break;
+
+    default:
+      // An ID symbol.
+      if (e.seq == SEQ_ID_HIGH) {
+        e.seq = SEQ_ID_LOW;
+      }
+      else if (e.seq == SEQ_ID_LOW) {
+        // The completed ID is never OTHER_TOOL, so it isn't active yet.
+        if (e.idStopped) {
+          refToolStopped(e, now);
+        }
+        else {
+          e.activeTools++;
+          refToolRunning(e, now);
+        }
+        e.seq = SEQ_NONE;
+      }
+      break;
+  }
+
+  if (((uint8_t)c & ~(uint8_t)Code::MASK) == 0 &&
+      (e.state != MotorState::OFF || e.seq != SEQ_NONE))
+    e.codeSeqArmed = true;
+  return e;
+}
+
+static bool same(const Snapshot &a, const Snapshot &b) {
+  return a.state == b.state && a.output == b.output && a.seq == b.seq &&
+    (a.seq == SEQ_NONE || a.idStopped == b.idStopped) &&
+    a.runningTime == b.runningTime && a.quietArmed == b.quietArmed &&
+    (!a.quietArmed || a.quietAt == b.quietAt) &&
+    a.shutoffArmed == b.shutoffArmed && a.codeSeqArmed == b.codeSeqArmed &&
+    a.activeTools == b.activeTools;
+}
+
+static void print(const char *label, const Snapshot &s) {
+  printf("    %-8s %-10s out %d seq %d stopped %d running %u quiet %d@%u shutoff %d codeseq %d tools %u\n",
+    label, STATE_NAMES[(uint8_t)s.state], s.output, s.seq, s.idStopped, s.runningTime,
+    s.quietArmed, s.quietAt, s.shutoffArmed, s.codeSeqArmed, s.activeTools);
+}
+
+static uint8_t actionCount(uint8_t t) {
+  uint8_t n = 0;
+  for (uint8_t bit = T_RUNNING; bit != T_VALID; bit <<= 1)
+    if (t & bit)
+      n++;
+  return n + ((t & T_ID) != T_ID_RESET);
+}
+
+static void printTransition(uint8_t t) {
+  static const char *const ID_ACTIONS[4] = { "id reset", "id follows", "stopped id follows", "id symbol" };
+  printf("-> %-10s %s%s%s%s\n", STATE_NAMES[t & T_STATE], ID_ACTIONS[(t & T_ID) >> 2],
+    t & T_RUNNING ? ", running" : "", t & T_QUIET ? ", quiet" : "",
+    t & T_STOPPED ? ", stopped" : "");
+}
+
+int main() {
+  unsigned cases = 0, failures = 0;
+
+  for (uint8_t s = 0; s < MOTOR_STATES; s++) {
+    for (uint8_t c = 0; c < CODE_COUNT; c++) {
+      for (uint8_t seq = SEQ_NONE; seq <= SEQ_ID_LOW; seq++) {
+        for (uint8_t stopped = 0; stopped < 2; stopped++) {
+          for (uint8_t other = 0; other < 2; other++) {
+            Receiver r;
+            halSimSetMillis(100000);
+            halSimSetCodeInputs(0);
+            halOutputOff();
+            r.begin();
+            if (s != (uint8_t)MotorState::OFF) {
+              r.newMotorState((MotorState)s);
+              r.timers.arm(QUIET_TIMER, halMillis() + QUIET_INTERVAL + 1);
+            }
+            if (other) {
+              r.tools.expire(halMillis(), QUIET_INTERVAL);
+              r.tools.seen(OTHER_TOOL, halMillis());
+            }
+            r.idSequence = (IdSequence)seq;
+            r.idHigh = ID_HIGH;
+            r.idStopped = stopped;
+            halSimAdvance(200);
+
+            Snapshot before = snapshot(r);
+            Snapshot expected = reference(before, (Code)c, halMillis());
+            r.newInput((Code)c);
+            Snapshot actual = snapshot(r);
+
+            cases++;
+            if (!same(expected, actual)) {
+              failures++;
+              printf("FAIL %s, %s, seq %u, stopped %u, other tool %u\n",
+                STATE_NAMES[s], CODE_NAMES[c], seq, stopped, other);
+              print("before", before);
+              print("expected", expected);
+              print("actual", actual);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // A tool last seen more than 65.5 s before the next code, its 16-bit age
+  // wrapped round to look recent, must still have aged out.
+  {
+    Receiver r;
+    halSimSetMillis(100000);
+    r.begin();
+    r.tools.expire(halMillis(), QUIET_INTERVAL);
+    r.tools.seen(OTHER_TOOL, halMillis());
+    halSimAdvance(65536 + QUIET_INTERVAL / 2);
+    r.newInput(Code::START);
+    cases++;
+    if (r.tools.activeCount() != 0) {
+      failures++;
+      printf("FAIL tool seen 68 s before START still active\n");
+    }
+  }
+
+  printf("%u cases, %u failed\n", cases, failures);
+
+  uint8_t worst = 0;
+  printf("\ntransition table: %u bytes of flash, valid codes 0x%05lx\n",
+    (unsigned)sizeof(TRANSITIONS), VALID_CODES);
+  for (uint8_t s = 0; s < MOTOR_STATES; s++) {
+    printf("  %s\n", STATE_NAMES[s]);
+    for (uint8_t c = 0; c < CODE_COUNT; c++) {
+      uint8_t t = transitionFor((MotorState)s, (Code)c);
+      if (!(t & T_VALID))
+        continue;
+      printf("    %-20s ", CODE_NAMES[c]);
+      printTransition(t);
+      if (actionCount(t) > worst)
+        worst = actionCount(t);
+    }
+  }
+  printf("most actions in one transition: %u\n", worst);
+  return failures;
+}
@@ -2,8 +2,14 @@
 #include <avr/sleep.h>
 #include <avr/interrupt.h>
 #include <avr/power.h>
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
 
-#include "codes.h"
+#include "hal.h"
+#include "transmitter.h"
+#if defined(TRIGGER_RMS)
+#include "rms.h"
+#endif
 
 /*
  * Pin PB0 is an input, and is triggered (active low) when the current
@@ -20,11 +26,51 @@
  * probability of repeated collissions (which are undetectable) when multiple
  * transmitters are active at the same time.
  * 
- * The receiver can distinguish between STARTUP_CODE and RUNNING_CODE, but
- * cannot identify which transmitter is sending codes, or even how many different
- * transmitters are active.
+ * The receiver can distinguish between STARTUP_CODE and RUNNING_CODE. A
+ * transmitter with an ID in EEPROM follows each code with two ID symbols, so
+ * the receiver can tell how many transmitters are active and which ones. An
+ * erased EEPROM (0xFF) sends codes alone, as before.
  * 
- * When the trigger is no longer asserted, we go to sleep.
+ * When the trigger is no longer asserted, we send TOOL_STOPPED a few times
+ * so the receiver can stop the collector without waiting for its quiet
+ * timeout, then go to sleep.
+ *
+ * The intervals come from a per-device xorshift generator, seeded at power-up
+ * from the seeds saved in EEPROM, ADC noise and the ID, and the seed is moved
+ * on and saved to one of RNG_SEED_SLOTS for the next boot, so no one cell is
+ * rewritten at every tool start. Without that every transmitter would repeat
+ * the same sequence, and two tools switched on together would collide frame
+ * after frame. With backoff set in EEPROM, the first frames after a trigger
+ * change also wait a random number of frame slots (transmitter.h). With
+ * complement frames set in EEPROM, each STARTING and RUNNING code is followed
+ * by its complement, for a receiver set the same way (codes.h). A frame time
+ * set in EEPROM shortens each frame's hold from BIT_ON_TIME, for receivers
+ * checking pulse width against the same frame time.
+ *
+ * The transmitter is powered from the tool's own outlet, so every tool start
+ * is a cold boot, and the first STARTING code goes out within a millisecond
+ * or so of reset: setup() reads the trigger straight away, and the seed is
+ * saved to EEPROM in the first gap rather than before the first frame. The
+ * fuses (platformio.ini) hold reset for 4 ms after power-up, not the
+ * default 64 ms. The
+ * startup self-test (buttons A to C three times, about 2.8 s) only runs
+ * after an external reset, or at every boot with self-test set in EEPROM.
+ * env:simbench measures reset to first frame.
+ *
+ * Frames are sent by an interrupt-driven state machine. The watchdog times
+ * the gaps between frames while the MCU is powered down, and Timer1 times the
+ * frame hold (and any remainder shorter than a watchdog period) in idle mode.
+ * With the trigger released we power down until the pin change interrupt.
+ *
+ * Code selection and interval generation live in transmitter.cpp so they can
+ * also be built and exercised on the host (env:native).
+ *
+ * Built with TRIGGER_RMS (env:transmitterrms), the trigger is decided in
+ * firmware instead of by the comparator: the conditioned current signal goes
+ * to ADC0 on PB5 (reset disabled), sampled free-running, and the ADC
+ * interrupt runs the true-RMS trigger in rms.h once a sample, with its
+ * thresholds from EEPROM. The ADC stops in power down, so that mode idles
+ * wherever the comparator build powers down.
  */
 
 const int TRIGGER_PIN = 0;  // PB0
@@ -33,158 +79,281 @@ const int B_PIN = 2;        // PB2
 const int C_PIN = 3;        // PB3
 const int D_PIN = 4;        // PB4
 
+Transmitter transmitter;
 
-// Transmit interval is 1500ms +- 500ms
-const int INTERVAL_MIN = 1000; // milliseconds
-const int INTERVAL_MAX = 2000; // milliseconds
-const int BIT_ON_TIME = 45; // milliseconds
-const int INTERBIT_INTERVAL = 265;
-volatile int startupCodeCounter = 0;
-const int STARTUP_CODE_COUNT = 3;
-volatile bool triggered = false;
-bool justAwoke = false;
+// Transmitter ID, 0 to MAX_TOOLS - 1, or NO_ID. Set per device when
+// programming the EEPROM.
+uint8_t EEMEM toolId = NO_ID;
 
-void waitInterval(uint16_t minMillis, uint16_t maxMillis);
-void codeOn(byte code);
-void codeOff(void);
+// Interval generator seeds. The seed is all of them XORed together, and each
+// boot saves the new state to the slot its low bits pick, so the writes
+// spread over the slots and every tool start doesn't wear the same cells. A
+// write torn by a power cut only stirs the seed. Programming different values
+// into each device helps, but ADC noise alone tells them apart.
+const uint8_t RNG_SEED_SLOTS = 16;
+uint32_t EEMEM rngSeeds[RNG_SEED_SLOTS] = {
+  0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+  0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+};
+
+// 1 enables slotted backoff after trigger changes; erased (0xFF) is off.
+uint8_t EEMEM backoffMode = 0xFF;
+
+// 1 sends complement frames; erased (0xFF) is off. Must match the receiver.
+uint8_t EEMEM complementMode = 0xFF;
+
+// Frame hold in milliseconds, BIT_ON_TIME_MIN up; erased (0xFF) is
+// BIT_ON_TIME. Must match receivers that check pulse width, and be at least
+// DEBOUNCE_LATENCY_MS (21) for receivers built with INPUT_DEBOUNCE.
+uint8_t EEMEM frameTimeMs = 0xFF;
+
+// 1 runs the startup self-test at every boot; erased (0xFF) runs it only
+// after an external reset.
+uint8_t EEMEM selfTestMode = 0xFF;
+
+// Set once the generator state has been saved for the next boot.
+bool seedSaved = false;
+
+// Set by the watchdog or Timer1 interrupt when the current wait step ends.
+volatile bool timerExpired = false;
+
+#if defined(TRIGGER_RMS)
+RmsTrigger rms;
+
+// Trigger thresholds in milliamps, RMS_MIN_MA to RMS_MAX_MA; erased selects
+// the defaults in rms.h.
+uint16_t EEMEM rmsOnMilliamps = 0xFFFF;
+uint16_t EEMEM rmsHysteresisMilliamps = 0xFFFF;
+
+const uint8_t SLEEP_MODE_DEEPEST = SLEEP_MODE_IDLE;
+#else
+const uint8_t SLEEP_MODE_DEEPEST = SLEEP_MODE_PWR_DOWN;
+#endif
+
+void sendCode(Code code);
+void selfTest(void);
 void setup(void);
 void loop(void);
 void sleep(void);
-void triggerOn(void);
-void triggerOff(void);
-void readTrigger(void);
-
-// Wait a random length of time between min and max milliseconds.
-void waitInterval(uint16_t min, uint16_t max)
-{
-  uint16_t width = max - min;
-  int time = rand() % width + min;
-  delay(time);
-}
-
-void codeOn(Code c) {
-  // Assume all bits are currently zero.
+bool sleepUntilExpired(uint8_t mode);
+void cancelWait(void);
+void waitFor(uint16_t ms);
+uint32_t adcNoise(void);
 
-  // Turn on code bits. Active low.
-  byte bits = ((byte)c & (byte)Code::MASK) << 1;
-  byte invBits = ~bits;
-  PORTB = invBits;
+// Hold a code on the transmitter inputs for one frame. Used by the self-test
+// only; normal frames go through transmitter.step().
+void sendCode(Code c) {
+  transmitter.codeOn(c);
+  halDelay(BIT_ON_TIME);
+  transmitter.codeOff();
 }
 
-void codeOff() {
-  // Possibly wait here
-  // ...
-
-  // Turn off (HIGH) all code bits.
-  PORTB = (byte)Code::MASK << 1;
+// Buttons A to C in turn, three times over, for checking a transmitter and
+// receiver pair by eye. D is left out: it is also TOOL_STOPPED, and would
+// stop a collector some other tool is running.
+void selfTest() {
+  for (int i=0; i<3;  i++) {
+    sendCode(Code::BUTTON_A);
+    halDelay(INTERBIT_INTERVAL);
+    sendCode(Code::BUTTON_B);
+    halDelay(INTERBIT_INTERVAL);
+    sendCode(Code::BUTTON_C);
+    halDelay(INTERBIT_INTERVAL);
+  }
 }
 
 void setup() {
 
+  // Why we reset, cleared for next time. A watchdog reset leaves the
+  // watchdog running with its reset enabled, which the waits below don't use.
+  uint8_t resetCause = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+
   // Turn off voltage reference
   ACSR &= ~(1<<ACBG);
 
   // Set pin modes: PB0 input, PB1-PB4 output
   DDRB = 0b00011110;
-  codeOff();
+  transmitter.codeOff();
+
+  uint8_t id = eeprom_read_byte(&toolId);
+  transmitter.id = id == NO_ID ? NO_ID : id & (MAX_TOOLS - 1);
+  transmitter.backoff = eeprom_read_byte(&backoffMode) == 1;
+  transmitter.complement = eeprom_read_byte(&complementMode) == 1;
+  uint8_t frameTime = eeprom_read_byte(&frameTimeMs);
+  if (frameTime >= BIT_ON_TIME_MIN && frameTime != 0xFF)
+    transmitter.frameTime = frameTime;
+  uint32_t saved = 0;
+  for (uint8_t i = 0; i < RNG_SEED_SLOTS; i++)
+    saved ^= eeprom_read_dword(&rngSeeds[i]);
+  transmitter.seed(saved ^ adcNoise() ^ ((uint32_t)id << 24));
+
+#if defined(TRIGGER_RMS)
+  rms.configure(eeprom_read_word(&rmsOnMilliamps), eeprom_read_word(&rmsHysteresisMilliamps));
+
+  // ADC0 against Vcc, free-running at CK/128 with an interrupt per sample.
+  static_assert(RMS_ADC_PRESCALE == 128, "ADPS below selects CK/128");
+  DIDR0 = _BV(ADC0D);
+  ADMUX = 0;
+  ADCSRB = 0;
+  ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+#else
+  power_adc_disable();
 
   // Configure pin change interrupt
   PCMSK = _BV(PCINT0);       // Only PB0 raises interrupt
   GIMSK |= _BV(PCIE);        // Enable Pin Change Interrupts
+#endif
   sei();
 
-  // Take a nap until something happens.
-  //sleep();
-
-  // Startup test
-  for (int i=0; i<3;  i++) {
-    codeOn(Code::BUTTON_A);
-    delay(BIT_ON_TIME);
-    codeOff();
-    delay(INTERBIT_INTERVAL);
-    codeOn(Code::BUTTON_B);
-    delay(BIT_ON_TIME);
-    codeOff();
-    delay(INTERBIT_INTERVAL);
-    codeOn(Code::BUTTON_C);
-    delay(BIT_ON_TIME);
-    codeOff();
-    delay(INTERBIT_INTERVAL);
-    codeOn(Code::BUTTON_D);
-    delay(BIT_ON_TIME);
-    codeOff();
-    delay(INTERBIT_INTERVAL);
-  }
+  if ((resetCause & _BV(EXTRF)) || eeprom_read_byte(&selfTestMode) == 1)
+    selfTest();
 
-  readTrigger();
+#if !defined(TRIGGER_RMS)
+  transmitter.readTrigger();
+#endif
 }
 
 void loop() {
-  while (triggered) {
-    if (startupCodeCounter > 0) {
-      codeOn(Code::TOOL_STARTING);
-      delay(BIT_ON_TIME);
-      codeOff();
-      startupCodeCounter--;
-    }
-    else {
-      codeOn(Code::TOOL_RUNNING);
-      delay(BIT_ON_TIME);
-      codeOff();
-    }
+  uint16_t ms = transmitter.step();
 
-    waitInterval(INTERVAL_MIN, INTERVAL_MAX);
+  // The seed write takes up to 14 ms, so it waits for the first gap (or
+  // idle) instead of holding up the first frame.
+  if (!seedSaved && (transmitter.state == TxState::GAP || transmitter.state == TxState::IDLE)) {
+    eeprom_update_dword(&rngSeeds[transmitter.rngState % RNG_SEED_SLOTS], transmitter.rngState);
+    seedSaved = true;
   }
-
-  //sleep();
+  if (ms == 0)
+    sleep();
+  else
+    waitFor(ms);
 }
 
+// Power down until the trigger changes. Returns at once if it already has.
 void sleep()
 {
-  // Prepare for Power Down sleep
-  
   cli();                                  // Disable interrupts
-  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  if (transmitter.triggered) {
+    sei();
+    return;
+  }
+  set_sleep_mode(SLEEP_MODE_DEEPEST);
   sleep_enable();                         // Set SE bit
   sei();                                  // Enable interrupts
-  
-
-  // Sleep until wake event (any interrupt) happens.
-  justAwoke = true;  // Get ready for waking up later
   sleep_cpu();                            // ZZZzzzz.
-  
+
   // Now we are awake again!
-  cli();                                  // Disable interrupts
   sleep_disable();                        // Clear SE bit
-  sei();                                  // Enable interrupts
 }
 
-// Called when first triggered to prepare for triggerOn.
-// Invoked by interrupt routine; any global variables changed should be declared volatile.
-void triggerOn() {
-  startupCodeCounter = STARTUP_CODE_COUNT;
+// Sleep in the given mode until the running wait step expires. Pin changes
+// wake us early; the trigger is only acted on between frames, so go back to
+// sleep, unless it was released during a running gap. Returns false if the
+// wait was cut short for that.
+bool sleepUntilExpired(uint8_t mode) {
+  set_sleep_mode(mode);
+  cli();
+  while (!timerExpired && !transmitter.isStopPending()) {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    cli();
+  }
+  bool expired = timerExpired;
+  sei();
+  return expired;
 }
 
-// Called when trigger released.
-// Invoked by interrupt routine; any global variables changed should be declared volatile.
-void triggerOff() {
+// The low bits of conversions of the temperature sensor, taken at CK/4 with
+// the 1.1 V reference still settling, folded together. Not much entropy per
+// sample, but enough across 32 of them to part two devices.
+uint32_t adcNoise() {
+  uint32_t noise = 0;
+  ADMUX = _BV(REFS1) | 0b1111;
+  ADCSRA = _BV(ADEN) | _BV(ADPS1);
+  for (uint8_t i = 0; i < 32; i++) {
+    ADCSRA |= _BV(ADSC);
+    while (ADCSRA & _BV(ADSC))
+      ;
+    noise = (noise << 3 | noise >> 29) ^ ADC;
+  }
+  ADCSRA = 0;
+  return noise;
+}
 
+// Stop whichever wait step is running, and drop any interrupt it has already
+// flagged so it can't end the next one.
+void cancelWait() {
+  cli();
+  WDTCR = (WDTCR & ~_BV(WDIE)) | _BV(WDIF);
+  TCCR1 = 0;
+  TIMSK &= ~_BV(OCIE1A);
+  TIFR = _BV(OCF1A);
+  sei();
 }
 
-void readTrigger() {
-  int pin = digitalRead(TRIGGER_PIN);
-  triggered = (pin == LOW);
+// Wait ms milliseconds asleep, as a series of watchdog and Timer1 steps.
+// Ends early if the trigger is released during a running gap.
+void waitFor(uint16_t ms) {
+  bool precise = ms <= TIMER1_MAX_MS;
+  while (ms > 0) {
+    WaitStep step = nextWaitStep(ms, precise);
+    timerExpired = false;
 
-  if (triggered) {
-    triggerOn();
-  }
-  else {
-    triggerOff();
+    if (step.watchdog) {
+      // Interrupt-only watchdog mode; the ISR turns it off again.
+      uint8_t wdp = (step.setting & 0b0111) | ((step.setting & 0b1000) ? _BV(WDP3) : 0);
+      cli();
+      wdt_reset();
+      WDTCR = _BV(WDCE) | _BV(WDE);
+      WDTCR = _BV(WDIE) | wdp;
+      sei();
+      if (!sleepUntilExpired(SLEEP_MODE_DEEPEST))
+        break;
+    }
+    else {
+      // Timer1 in CTC mode at CK/4096. Timer1 stops in power down, so idle.
+      TCCR1 = 0;
+      TCNT1 = 0;
+      OCR1A = step.setting;
+      OCR1C = step.setting;
+      GTCCR |= _BV(PSR1);
+      TIFR = _BV(OCF1A);
+      TIMSK |= _BV(OCIE1A);
+      TCCR1 = _BV(CTC1) | _BV(CS13) | _BV(CS12) | _BV(CS10);
+      if (!sleepUntilExpired(SLEEP_MODE_IDLE))
+        break;
+    }
   }
+  if (!timerExpired)
+    cancelWait();
+}
+
+// Watchdog interrupt: end of a power-down wait step.
+ISR(WDT_vect) {
+  WDTCR &= ~_BV(WDIE);
+  timerExpired = true;
+}
 
+// Timer1 compare: end of an idle wait step.
+ISR(TIMER1_COMPA_vect) {
+  TCCR1 = 0;
+  TIMSK &= ~_BV(OCIE1A);
+  timerExpired = true;
 }
 
+#if defined(TRIGGER_RMS)
+// ADC conversion complete: one sample into the RMS window. The trigger
+// changes, like a pin change, only at the end of a window.
+ISR(ADC_vect) {
+  if (rms.add(ADC))
+    transmitter.setTrigger(rms.on);
+}
+#else
 // Pin change interrupt
 ISR(PCINT0_vect) {
-  readTrigger();
-}
\ No newline at end of file
+  transmitter.readTrigger();
+}
+#endif
@@ -0,0 +1,84 @@
+/*
+ * Host-side benchmark of the transmitter's sleeping frame scheduler.
+ *
+ * Runs Transmitter::step() with the trigger held, and splits every wait into
+ * the same watchdog and Timer1 steps the firmware uses (nextWaitStep()). Each
+ * step ends in a wakeup; while idling on Timer1, timer0's millis() tick also
+ * wakes the core every 2.048 ms. Awake time is estimated from assumed cycle
+ * costs per wakeup.
+ *
+ * Reported per transmitted frame: wakeups, time awake, idle and powered
+ * down, and the resulting duty cycle (fraction of time awake). The blocking
+ * delay() loop this replaced was awake 100% of the time. Also reports the
+ * frame hold Timer1 actually produces against BIT_ON_TIME.
+ *
+ * Usage: program [frames] [stepWakeCycles] [tickWakeCycles]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "hal.h"
+#include "transmitter.h"
+
+const double F_CPU_HZ = 8000000.0;
+const double TIMER0_TICK_MICROS = 2048;
+
+static Transmitter transmitter;
+
+int main(int argc, char **argv) {
+  unsigned long frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+  double stepWakeCycles = argc > 2 ? atof(argv[2]) : 300;
+  double tickWakeCycles = argc > 3 ? atof(argv[3]) : 100;
+
+  double powerDownMicros = 0, idleMicros = 0;
+  double stepWakes = 0, tickWakes = 0;
+  double frameHoldMicros = 0;
+
+  halSimSetTrigger(true);
+  transmitter.readTrigger();
+
+  unsigned long sent = 0;
+  while (sent < frames) {
+    bool frame = transmitter.state != TxState::FRAME;
+    uint16_t ms = transmitter.step();
+    if (ms == 0)
+      break;
+    if (frame)
+      sent++;
+
+    bool precise = ms <= TIMER1_MAX_MS;
+    while (ms > 0) {
+      WaitStep step = nextWaitStep(ms, precise);
+      stepWakes++;
+      if (step.watchdog) {
+        powerDownMicros += step.ms * 1000.0;
+      }
+      else {
+        double micros = step.setting * (double)TIMER1_TICK_MICROS;
+        idleMicros += micros;
+        tickWakes += micros / TIMER0_TICK_MICROS;
+        if (frame)
+          frameHoldMicros += micros;
+      }
+    }
+  }
+
+  double awakeMicros = (stepWakes * stepWakeCycles + tickWakes * tickWakeCycles) / F_CPU_HZ * 1e6;
+  double totalMicros = powerDownMicros + idleMicros + awakeMicros;
+
+  printf("frames %lu, mean frame period %.1f ms\n", sent, totalMicros / sent / 1000);
+  printf("  frame hold           %10.3f ms (BIT_ON_TIME %u ms)\n",
+    frameHoldMicros / sent / 1000, BIT_ON_TIME);
+  printf("  wakeups/frame        %10.2f (wait steps %.2f, timer0 ticks %.2f)\n",
+    (stepWakes + tickWakes) / sent, stepWakes / sent, tickWakes / sent);
+  printf("  awake/frame          %10.1f us (assuming %.0f cycles/step, %.0f cycles/tick)\n",
+    awakeMicros / sent, stepWakeCycles, tickWakeCycles);
+  printf("  idle/frame           %10.1f ms\n", idleMicros / sent / 1000);
+  printf("  power down/frame     %10.1f ms\n", powerDownMicros / sent / 1000);
+  printf("  duty cycle           %10.4f %% awake, %.2f %% idle, %.2f %% powered down\n",
+    100 * awakeMicros / totalMicros, 100 * idleMicros / totalMicros,
+    100 * powerDownMicros / totalMicros);
+  return 0;
+}
@@ -0,0 +1,273 @@
+#include "receiver.h"
+#include "hal.h"
+
+void Receiver::begin() {
+  uint32_t now = halMillis();
+  runningCodeReceivedTime = now;
+  anyCodeReceivedTime = now;
+}
+
+// Invoked from the pin change interrupt on each change to the inputs. Only
+// records the inputs; everything else happens in poll().
+void Receiver::onPinChange() {
+  queue.push(halReadCodeInputs(), halMillis());
+}
+
+// Invoked from a timer interrupt on each tick, in place of onPinChange(), in
+// debounced builds. Queues each code the debouncer lets through; a glitch or
+// a code still settling never reaches the queue.
+void Receiver::onTick() {
+  if (debouncer.sample(halReadCodeInputs()))
+    queue.push(debouncer.code, halMillis());
+}
+
+// Called from loop(). Advances the state machine with whatever the ISR has
+// queued, then handles timeouts.
+void Receiver::poll() {
+  CodeSample s;
+  while (queue.pop(s)) {
+    // A pin change read back as the same inputs doesn't end a code being
+    // timed for the pulse width check.
+    if (settling && frameTime != 0 && s.bits == pending.bits)
+      continue;
+    // A newer sample arriving ends the pending one. Decode it only if it held
+    // long enough; otherwise it was a glitch or a partial code.
+    settle(s.time, true);
+    if (settling)
+      stats.count(STAT_GLITCHES);
+    settling = true;
+    pending = s;
+  }
+  settle(halMillis(), false);
+
+  checkTimeouts();
+}
+
+// Decode the pending sample if it has been steady since before time now, and
+// it ended then if ended is set. With the pulse width check, a code must hold
+// for pulseWidthMin() first; one that ends sooner, such as two codes ORed
+// together where their frames overlap, counts as rejected.
+void Receiver::settle(uint32_t now, bool ended) {
+  if (!settling || now - pending.time < SETTLE_INTERVAL)
+    return;
+
+  if (frameTime != 0 && pending.bits != 0 && now - pending.time < pulseWidthMin()) {
+    if (ended) {
+      settling = false;
+      stats.count(STAT_REJECTED);
+    }
+    return;
+  }
+  settling = false;
+
+  decoded((Code) pending.bits, pending.time);
+}
+
+// A code read from the inputs, which started at time. With complement
+// frames, a STARTING or RUNNING code is held until its complement arrives;
+// if that doesn't happen within COMPLEMENT_WINDOW (a collision garbled one of
+// the pair), or another STARTING or RUNNING code takes its place, it is
+// dropped. Codes from other transmitters in between go through as usual.
+void Receiver::decoded(Code c, uint32_t time) {
+  if (complementFrames) {
+    if (unconfirmed != Code::NONE) {
+      if (time - unconfirmedTime > COMPLEMENT_WINDOW) {
+        unconfirmed = Code::NONE;
+        stats.count(STAT_REJECTED);
+      }
+      else if (c == complementOf(unconfirmed)) {
+        Code held = unconfirmed;
+        unconfirmed = Code::NONE;
+        newInput(held);
+        return;
+      }
+    }
+    if (isComplemented(c)) {
+      if (unconfirmed != Code::NONE)
+        stats.count(STAT_REJECTED);
+      unconfirmed = c;
+      unconfirmedTime = time;
+      return;
+    }
+  }
+  newInput(c);
+}
+
+static_assert(STAT_QUIET_TIMEOUTS - STAT_SEQ_TIMEOUTS == QUIET_TIMER &&
+              STAT_SHUTOFF_TIMEOUTS - STAT_SEQ_TIMEOUTS == SHUTOFF_TIMER,
+              "Timeout counters follow ReceiverTimer");
+
+// Process timeouts. When a timeout occurrs, insert a pseudocode into the
+// codestream. The timers are only armed while the motor is running.
+void Receiver::checkTimeouts() {
+
+  static const Code timeoutCodes[RECEIVER_TIMERS] = {
+    Code::CODE_SEQ_TIMEOUT,
+    Code::TOOL_QUIET_TIMEOUT,
+    Code::SHUTOFF_TIMEOUT,
+  };
+
+  uint32_t now = halMillis();
+  while (timers.isDue(now)) {
+    uint8_t id = timers.nextId();
+    timers.cancel(id);
+    stats.count((ReceiverStat)(STAT_SEQ_TIMEOUTS + id));
+    newInput(timeoutCodes[id]);
+  }
+}
+
+uint32_t Receiver::nextDeadline() const {
+  uint32_t now = halMillis();
+  if (!queue.isEmpty())
+    return now;
+
+  uint32_t next = now + UINT32_MAX / 2;
+  if (settling)
+    next = pending.time + (frameTime != 0 && pending.bits != 0 ? pulseWidthMin() : SETTLE_INTERVAL);
+  if (timers.isArmed() && timers.next() - now < next - now)
+    next = timers.next();
+  return next;
+}
+
+// Invoked on each input code, and on timeouts. Advances the receiver state
+// machine by one entry of the transition table; invalid codes are eaten.
+void Receiver::newInput(Code currentCode) {
+  if ((uint8_t)currentCode >= CODE_COUNT)
+    return;
+
+  uint8_t t = transitionFor(currentOutputState, currentCode);
+  if (!(t & T_VALID)) {
+    if (currentCode != Code::NONE)
+      stats.count(STAT_REJECTED);
+    return;
+  }
+
+  // Timeouts fire one tick after the interval has fully elapsed.
+  uint32_t now = halMillis();
+
+  // Tools not heard from within the quiet interval are no longer active.
+  tools.expire(now, QUIET_INTERVAL);
+
+  // Gaps between running codes within one run are what the quiet timeout
+  // has to outlast.
+  bool sameRun = isRunning() && (int32_t)(runningCodeReceivedTime - motorStartTime) >= 0;
+  newMotorState((MotorState)(t & T_STATE), currentCode);
+
+  if (t & T_RUNNING) {
+    if (sameRun) {
+      uint32_t gap = now - runningCodeReceivedTime;
+      cadence.add(gap < QUIET_INTERVAL ? gap : QUIET_INTERVAL);
+    }
+    runningCodeReceivedTime = now;
+  }
+  if (t & T_QUIET)
+    timers.arm(QUIET_TIMER, now + quietInterval() + 1);
+  if (t & T_STOPPED)
+    toolStopped(now);
+
+  uint8_t id = t & T_ID;
+  if (id == T_ID_SYMBOL) {
+    newIdSymbol(currentCode, now);
+  }
+  else {
+    idSequence = id == T_ID_RESET ? SEQ_NONE : SEQ_ID_HIGH;
+    idStopped = id == T_ID_STOPPED;
+  }
+
+  // Any real code (not a pseudo-code) restarts the code sequence timer.
+  if (((uint8_t)currentCode & ~(uint8_t)Code::MASK) == 0) {
+    stats.count(STAT_CODES);
+    if (stats.counters[STAT_CODES] > 1)
+      stats.addGap(now - anyCodeReceivedTime);
+    anyCodeReceivedTime = now;
+    if (isRunning() || idSequence != SEQ_NONE)
+      timers.arm(CODE_SEQ_TIMER, now + CODE_SEQ_INTERVAL + 1);
+  }
+}
+
+// A complete transmitter ID after a STARTING or RUNNING code; the codes
+// themselves do the same through T_RUNNING and T_QUIET. The collector
+// stops once every tool, identified or not, has been quiet for the quiet
+// interval; with one interval for all of them, that is the interval after the
+// newest.
+// A STOPPED code can bring that forward (toolStopped()).
+void Receiver::toolRunning(uint32_t now) {
+  runningCodeReceivedTime = now;
+  if (isRunning())
+    timers.arm(QUIET_TIMER, now + quietInterval() + 1);
+}
+
+// A tool switched off. Unless another identified tool is still active, bring
+// the quiet timeout forward to stoppedRunOn from now; a STARTING or RUNNING
+// code from a tool still on pushes it back out again. The stopping tool itself
+// is still in the table until its ID arrives, so an identified tool takes the
+// fast path on the ID, and an anonymous one on the code.
+void Receiver::toolStopped(uint32_t now) {
+  if (!isRunning() || tools.activeCount() > 0)
+    return;
+
+  uint32_t when = now + stoppedRunOn + 1;
+  if (!timers.isArmed(QUIET_TIMER) || (int32_t)(when - timers.deadline(QUIET_TIMER)) < 0)
+    timers.arm(QUIET_TIMER, when);
+}
+
+// Collect the two ID symbols that follow a STARTING, RUNNING or STOPPED code.
+void Receiver::newIdSymbol(Code c, uint32_t now) {
+  signed char value = idSymbolValue(c);
+  if (value < 0) {
+    idSequence = SEQ_NONE;
+    return;
+  }
+
+  switch (idSequence) {
+    case SEQ_ID_HIGH:
+      idHigh = value;
+      idSequence = SEQ_ID_LOW;
+      break;
+
+    case SEQ_ID_LOW:
+      if (idStopped) {
+        tools.remove((idHigh << 3) | value);
+        toolStopped(now);
+      }
+      else {
+        tools.seen((idHigh << 3) | value, now);
+        toolRunning(now);
+      }
+      idSequence = SEQ_NONE;
+      break;
+
+    default:
+      break;
+  }
+}
+
+// Switch the output. cause is the code behind the change, for the run log.
+void Receiver::newMotorState(MotorState s, Code cause) {
+
+  if (s == currentOutputState)
+    return;
+
+  priorOutputState = currentOutputState;
+  currentOutputState = s;
+
+  switch (s) {
+    case MotorState::OFF:
+      timers.cancelAll();
+      halOutputOff();
+      stats.addRunTime(halMillis() - motorStartTime);
+      runLog.stopped(cause, halMillis());
+      break;
+
+    case MotorState::AUTO_RUN:
+    case MotorState::MANUAL_RUN:
+      if (priorOutputState == MotorState::OFF) {
+        motorStartTime = halMillis();
+        timers.arm(SHUTOFF_TIMER, motorStartTime + SHUTOFF_INTERVAL + 1);
+        halOutputOn();
+        stats.count(STAT_STARTS);
+        runLog.started(cause, motorStartTime);
+      }
+      break;
+  }
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <stdint.h>
+#include "cadence.h"
+#include "codes.h"
+#include "codequeue.h"
+#include "debounce.h"
+#include "runlog.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "tooltable.h"
+#include "transitions.h"
+#include "transmitter.h"
+
+// Transition from MANUAL_RUN to OFF after this interval;
+const uint32_t SHUTOFF_INTERVAL = 180000;  // 3 minutes for testing // 1200000; 20 minutes, in milliseconds
+
+// Max interval allowed between codes in a multi-code sequnce
+const uint32_t CODE_SEQ_INTERVAL = 1000;
+
+// Interval after hearing no activity from tool transmitters. With the
+// adaptive quiet timeout this is the longest it gets.
+const uint32_t QUIET_INTERVAL = 5000;
+
+// Shortest adaptive quiet timeout: a single transmitter's longest gap between
+// codes with one RUNNING frame lost in it, so a quiet timeout learned while
+// several tools kept the channel busy can't stop the collector under the one
+// tool left running, nor can a single missed frame.
+const uint32_t QUIET_MIN_INTERVAL = 2 * INTERVAL_MAX + BIT_ON_TIME;
+
+// Default run-on after a TOOL_STOPPED code when no other identified tool is
+// active (Receiver::stoppedRunOn). Long enough for any other (anonymous)
+// running tool to send a code.
+const uint16_t STOPPED_RUN_ON = 2500;
+
+// Inputs must hold steady this long before they are decoded, to let all bits
+// settle if the receiver doesn't set them all at once. millis() can step by
+// 2 ms at a time at 8 MHz, so 3 guarantees at least 1 ms.
+const uint32_t SETTLE_INTERVAL = 3;
+
+// With complement frames, how long after a STARTING or RUNNING code its
+// complement may start. The transmitter sends it a frame and a gap (90 ms)
+// later; the rest is for the RC oscillators disagreeing.
+const uint32_t COMPLEMENT_WINDOW = 120;
+
+// With the pulse width check, how much shorter than the transmitters' frame
+// time a code may be: an eighth of it for the RC oscillators disagreeing,
+// and this much for millis() stepping 2 ms at each edge, or in debounced
+// builds, the lines settling a tick apart.
+const uint32_t PULSE_WIDTH_SLACK = 4;
+
+// Timers behind the timeout pseudo-codes.
+enum ReceiverTimer : uint8_t { CODE_SEQ_TIMER, QUIET_TIMER, SHUTOFF_TIMER, RECEIVER_TIMERS };
+
+// Progress through the ID symbols that follow a STARTING, RUNNING or STOPPED
+// code.
+enum IdSequence : uint8_t { SEQ_NONE, SEQ_ID_HIGH, SEQ_ID_LOW };
+
+// Input samples buffered between the ISR and loop().
+const uint8_t CODE_QUEUE_SIZE = 8;
+
+/*
+ * Receiver state machine, independent of the hardware. The pin change ISR
+ * only records the inputs with a timestamp (onPinChange()); poll(), called
+ * from loop(), drains those samples, decodes the ones that held steady for
+ * SETTLE_INTERVAL (or with the pulse width check, most of a frame), and
+ * turns timeouts into pseudo-codes. Debounced builds
+ * sample the inputs on a timer tick instead (onTick()), and queue only the
+ * codes that got through the debouncer. Only the earliest
+ * timeout is checked on each pass, so loop() can sleep until it is due or an
+ * input changes. Transmitters that send an ID after each code are tracked
+ * individually in a ToolTable. What each code does in each state comes from
+ * the transition table in transitions.h. Time and the output pin go through
+ * the HAL. Counts and timings of what it sees are kept in stats, and each
+ * run of the collector goes to runLog.
+ */
+struct Receiver {
+  CodeQueue<CODE_QUEUE_SIZE> queue;
+  DeadlineScheduler<RECEIVER_TIMERS> timers;
+
+  MotorState currentOutputState = MotorState::OFF;
+  MotorState priorOutputState = MotorState::OFF;
+
+  uint32_t motorStartTime = 0;
+  uint32_t runningCodeReceivedTime = 0;
+  uint32_t anyCodeReceivedTime = 0;
+
+  // Identified transmitters, and the ID sequence being received.
+  ToolTable tools;
+  IdSequence idSequence = SEQ_NONE;
+  uint8_t idHigh = 0;
+  bool idStopped = false;  // The ID being received follows a STOPPED code
+
+  // Run-on after a TOOL_STOPPED code when no other identified tool is active:
+  // the collector stops this long after it, unless a STARTING or RUNNING code
+  // arrives first. 0 stops at once, which suits an installation where every
+  // transmitter has an ID.
+  uint16_t stoppedRunOn = STOPPED_RUN_ON;
+
+  ReceiverStats stats = {};
+
+  // Each run, when and why it stopped, for the EEPROM log. The firmware
+  // begins it and polls it from loop().
+  RunLog runLog;
+
+  // Adaptive quiet timeout: QUIET_INTERVAL, or when set, what cadence has
+  // learned of the gaps between running codes, within QUIET_MIN_INTERVAL and
+  // QUIET_INTERVAL. Off by default: with any frame loss it stops the
+  // collector under a running tool more often than the fixed timeout, for
+  // seconds less run-on a day (env:channel frameLoss).
+  bool adaptiveQuiet = false;
+  CadenceEstimator cadence;
+
+  // Complement frames (codes.h): a STARTING or RUNNING code only counts once
+  // its complement follows within COMPLEMENT_WINDOW, and is held in
+  // unconfirmed until then. Off by default; every transmitter must send them
+  // when on.
+  bool complementFrames = false;
+  Code unconfirmed = Code::NONE;
+  uint32_t unconfirmedTime = 0;
+
+  // Pulse width check: when set, the frame time the transmitters use, and a
+  // code only counts once it has held for pulseWidthMin(), near enough a
+  // whole frame. Where frames of two codes overlap, the inputs show both ORed
+  // together for less than a frame, so the code neither sent goes no further
+  // unless they started within the slack of each other; what shows of each
+  // frame alone still counts if it is long enough. There is no upper bound:
+  // frames of one code that overlap run together into one longer code, and
+  // are as good as either. 0, the default, decodes each code once it settles.
+  uint16_t frameTime = 0;
+
+  // Tick sampling, in place of pin changes (onTick()).
+  InputDebouncer debouncer;
+
+  // Most recent input sample, waiting to settle.
+  bool settling = false;
+  CodeSample pending = {0, 0};
+
+  void begin();
+  void onPinChange();
+  void onTick();
+  void poll();
+  void checkTimeouts();
+  void newInput(Code);
+  void newMotorState(MotorState, Code cause = Code::NONE);
+
+  // Earliest time poll() may have something to do. Only meaningful when
+  // hasDeadline() is true.
+  uint32_t nextDeadline() const;
+  bool hasDeadline() const { return timers.isArmed() || settling || !queue.isEmpty(); }
+
+  bool isRunning() const { return currentOutputState != MotorState::OFF; }
+
+  uint32_t pulseWidthMin() const { return frameTime - frameTime / 8 - PULSE_WIDTH_SLACK; }
+
+  uint32_t quietInterval() const {
+    return adaptiveQuiet ? cadence.timeout(QUIET_MIN_INTERVAL, QUIET_INTERVAL) : QUIET_INTERVAL;
+  }
+
+  private:
+    void settle(uint32_t now, bool ended);
+    void decoded(Code c, uint32_t time);
+    void toolRunning(uint32_t now);
+    void toolStopped(uint32_t now);
+    void newIdSymbol(Code c, uint32_t now);
+};
@@ -0,0 +1,58 @@
+#include "rms.h"
+
+// Bit by bit, one result bit per step.
+uint16_t rmsSqrt(uint32_t x) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > x)
+    bit >>= 2;
+  while (bit != 0) {
+    if (x >= root + bit) {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Milliamps as RMS counts times the window length, squared.
+static uint32_t limit(uint16_t milliamps) {
+  uint32_t scaled = ((uint32_t)milliamps * RMS_COUNTS_PER_AMP * RMS_WINDOW + 500) / 1000;
+  return scaled * scaled;
+}
+
+void RmsTrigger::configure(uint16_t onMilliamps, uint16_t hysteresisMilliamps) {
+  if (onMilliamps < RMS_MIN_MA || onMilliamps > RMS_MAX_MA)
+    onMilliamps = RMS_DEFAULT_ON_MA;
+  if (hysteresisMilliamps >= onMilliamps) {
+    hysteresisMilliamps = RMS_DEFAULT_HYSTERESIS_MA;
+    if (hysteresisMilliamps > onMilliamps / 2)
+      hysteresisMilliamps = onMilliamps / 2;
+  }
+  onLimit = limit(onMilliamps);
+  offLimit = limit(onMilliamps - hysteresisMilliamps);
+}
+
+bool RmsTrigger::endWindow() {
+  uint32_t a = sum < 0 ? -sum : sum;
+  last = RMS_WINDOW * sumSquares - a * a;
+  count = 0;
+  sum = 0;
+  sumSquares = 0;
+
+  bool was = on;
+  if (last >= onLimit)
+    on = true;
+  else if (last < offLimit)
+    on = false;
+  return on != was;
+}
+
+uint16_t RmsTrigger::milliamps() const {
+  const uint32_t scale = (uint32_t)RMS_COUNTS_PER_AMP * RMS_WINDOW;
+  return ((uint32_t)rmsSqrt(last) * 1000 + scale / 2) / scale;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * True-RMS current trigger for the transmitter, an alternative to the analog
+ * rectifier and comparator in transmitter/LTSpice/AutoVac1.asc. The
+ * conditioned current signal, biased at mid-rail, is sampled by the ADC
+ * free-running with an interrupt per sample; each interrupt adds one sample
+ * with add(), and every mains cycle's worth of samples is one window.
+ *
+ * The kernel is integer only: add() takes the deviation from RMS_BIAS, and
+ * accumulates it and its square. At the end of a window N * sum(d^2) -
+ * sum(d)^2 is N^2 times the variance, which is the square of the AC RMS
+ * with any DC offset in the front end removed. That is compared with the
+ * squared thresholds, scaled the same way, so the decision needs no square
+ * root or division; only reporting (milliamps()) takes one.
+ *
+ * The trigger turns on at or above the on threshold and off below the on
+ * threshold less the hysteresis. Thresholds are in milliamps, from
+ * RMS_MIN_MA to RMS_MAX_MA.
+ */
+
+// The transmitter's clock, and the ADC at CK/128 taking 13 ADC clocks a
+// conversion: 4808 samples/s, 1664 CPU cycles between interrupts.
+const uint32_t RMS_F_CPU = 8000000;
+const uint8_t RMS_ADC_PRESCALE = 128;
+const uint8_t RMS_ADC_CLOCKS = 13;
+const uint16_t RMS_SAMPLE_CYCLES = RMS_ADC_PRESCALE * RMS_ADC_CLOCKS;
+const uint16_t RMS_SAMPLE_HZ = RMS_F_CPU / RMS_SAMPLE_CYCLES;
+
+#ifndef RMS_MAINS_HZ
+#define RMS_MAINS_HZ 60
+#endif
+
+// Samples in one mains cycle, the RMS window.
+const uint8_t RMS_WINDOW = (RMS_SAMPLE_HZ + RMS_MAINS_HZ / 2) / RMS_MAINS_HZ;
+
+// Mid-rail ADC reading, and the front end's gain in RMS counts per amp. 5 A
+// RMS is then 320 counts RMS, 453 peak, inside the +-512 swing.
+const int16_t RMS_BIAS = 512;
+const uint16_t RMS_COUNTS_PER_AMP = 64;
+
+const uint16_t RMS_MIN_MA = 100;
+const uint16_t RMS_MAX_MA = 5000;
+
+// Used while the EEPROM settings are erased (0xFFFF).
+const uint16_t RMS_DEFAULT_ON_MA = 500;
+const uint16_t RMS_DEFAULT_HYSTERESIS_MA = 100;
+
+// N * sum(d^2) and sum(d)^2 both fit 32 bits.
+static_assert((uint64_t)RMS_WINDOW * RMS_WINDOW * 512 * 512 <= UINT32_MAX,
+              "RMS window too long for 32-bit sums");
+
+uint16_t rmsSqrt(uint32_t x);
+
+struct RmsTrigger {
+  bool on = false;
+
+  // Thresholds as N^2 * counts^2, from configure().
+  uint32_t onLimit = 0;
+  uint32_t offLimit = 0;
+
+  // The window being accumulated.
+  uint8_t count = 0;
+  int32_t sum = 0;
+  uint32_t sumSquares = 0;
+
+  // N^2 times the mean square of the last whole window.
+  uint32_t last = 0;
+
+  // Set the thresholds, replacing erased or out of range values.
+  void configure(uint16_t onMilliamps, uint16_t hysteresisMilliamps);
+
+  // Add one ADC sample. True when it ends a window that changed on.
+  bool add(uint16_t sample) {
+    int16_t d = (int16_t)sample - RMS_BIAS;
+    uint16_t m = d < 0 ? -d : d;
+    sum += d;
+    sumSquares += (uint32_t)m * m;
+    if (++count < RMS_WINDOW)
+      return false;
+    return endWindow();
+  }
+
+  bool endWindow();
+
+  // RMS of the last window.
+  uint16_t milliamps() const;
+};
@@ -0,0 +1,119 @@
+#include "runlog.h"
+#include "hal.h"
+
+RunStop runStopFor(Code c) {
+  switch (c) {
+    case Code::STOP:               return RUN_STOP_KEYFOB;
+    case Code::TOOL_QUIET_TIMEOUT: return RUN_STOP_QUIET;
+    case Code::SHUTOFF_TIMEOUT:    return RUN_STOP_SHUTOFF;
+    default:                       return RUN_STOP_OTHER;
+  }
+}
+
+uint16_t runLogCheck(const uint8_t *p, uint8_t length) {
+  uint8_t sum1 = 0, sum2 = 0;
+  for (uint8_t i = 0; i < length - 2; i++) {
+    sum1 += p[i];
+    sum2 += sum1;
+  }
+  return ~(sum1 | sum2 << 8);
+}
+
+bool runLogValid(const uint8_t *p, uint8_t length) {
+  return (p[length - 2] | p[length - 1] << 8) == runLogCheck(p, length);
+}
+
+void RunTotals::add(const RunRecord &r) {
+  seq = r.seq;
+  runSeconds += r.runSeconds();
+  if (r.runSeconds() < SHORT_RUN_SECONDS && shortRuns != UINT16_MAX)
+    shortRuns++;
+  RunStop stop = (RunStop)(r.flags() & RUN_FLAG_STOP);
+  if (stop < RUN_STOP_OTHER && stops[stop] != UINT16_MAX)
+    stops[stop]++;
+  check = runLogCheck((const uint8_t *)this, sizeof(*this));
+}
+
+static uint16_t seconds(uint32_t ms, uint16_t max) {
+  ms /= 1000;
+  return ms < max ? ms : max;
+}
+
+void RunLog::begin() {
+  RunLogScan s;
+  s.scan(halEepromRead);
+  totals = s.totals;
+  slot = s.anyRecord ? s.newestRecord : RUNLOG_RECORDS - 1;
+  // Totals torn by a power cut are written again from the record.
+  if (s.totalsBehind) {
+    writing = true;
+    offset = sizeof(RunRecord);
+  }
+  enabled = true;
+}
+
+void RunLog::started(Code cause, uint32_t now) {
+  keyfobStart = cause == Code::START;
+  startTime = now;
+}
+
+// Fill in the record of the run that just ended, and start writing it, or
+// queue it behind the one being written.
+void RunLog::stopped(Code cause, uint32_t now) {
+  if (!enabled)
+    return;
+  RunRecord &r = writing ? queued : record;
+  uint8_t flags = runStopFor(cause) | (keyfobStart ? RUN_FLAG_KEYFOB : 0);
+  r.run = seconds(now - startTime, RUN_SECONDS_MAX) | flags << RUN_FLAGS_SHIFT;
+  r.offSeconds = stoppedOnce ? seconds(startTime - stopTime, RUN_OFF_UNKNOWN) : RUN_OFF_UNKNOWN;
+  stopTime = now;
+  stoppedOnce = true;
+  if (writing)
+    hasQueued = true;
+  else
+    next();
+}
+
+// Number the record, fold it into the totals and start on it in the next
+// slot round the ring.
+void RunLog::next() {
+  record.seq = totals.seq + 1;
+  record.check = runLogCheck((const uint8_t *)&record, sizeof(record));
+  totals.add(record);
+  slot = slot + 1 < RUNLOG_RECORDS ? slot + 1 : 0;
+  offset = 0;
+  writing = true;
+}
+
+// The record goes first and its totals after, so the newest valid record is
+// never older than the newest valid totals. Bytes already holding the right
+// value are skipped, which costs a read but spares the cell.
+void RunLog::poll() {
+  if (!writing || !halEepromReady())
+    return;
+  while (offset < sizeof(RunRecord) + sizeof(RunTotals)) {
+    uint16_t addr;
+    uint8_t b;
+    if (offset < sizeof(RunRecord)) {
+      addr = RUNLOG_RECORD_BASE + slot * sizeof(RunRecord) + offset;
+      b = ((const uint8_t *)&record)[offset];
+    }
+    else {
+      uint8_t i = offset - sizeof(RunRecord);
+      addr = RUNLOG_BASE + (totals.seq % RUNLOG_TOTAL_SLOTS) * sizeof(RunTotals) + i;
+      b = ((const uint8_t *)&totals)[i];
+    }
+    offset++;
+    if (halEepromRead(addr) != b) {
+      halEepromWrite(addr, b);
+      return;
+    }
+  }
+
+  writing = false;
+  if (hasQueued) {
+    hasQueued = false;
+    record = queued;
+    next();
+  }
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stdint.h>
+#include "codes.h"
+
+// Why a run ended, from the code that switched the collector off.
+enum RunStop : uint8_t {
+  RUN_STOP_KEYFOB,    // STOP
+  RUN_STOP_QUIET,     // TOOL_QUIET_TIMEOUT
+  RUN_STOP_SHUTOFF,   // SHUTOFF_TIMEOUT
+  RUN_STOP_OTHER,     // Anything else; only host programs do this
+  RUN_STOPS
+};
+
+RunStop runStopFor(Code c);
+
+// Record flags: the stop cause in the low bits, then how the run started.
+const uint8_t RUN_FLAG_STOP   = 0b0011;  // RunStop
+const uint8_t RUN_FLAG_KEYFOB = 0b0100;  // Started by START, not a tool
+
+// Run times share a word with the flags. SHUTOFF_INTERVAL ends every run
+// long before this.
+const uint16_t RUN_SECONDS_MAX = 0x0FFF;
+const uint8_t RUN_FLAGS_SHIFT = 12;
+
+// Off time of the first run after power-up, or of one after more than 18 h.
+const uint16_t RUN_OFF_UNKNOWN = 0xFFFF;
+
+// Runs shorter than this count as short cycles in the totals.
+const uint16_t SHORT_RUN_SECONDS = 60;
+
+/*
+ * One run of the collector, as logged: 8 bytes. seq counts runs from 1 since
+ * the log was erased, and only ever goes up, so the newest record in the ring
+ * is the one with the highest seq, allowing for wraparound. Times are whole
+ * seconds, saturating. check is a Fletcher checksum that neither erased
+ * (0xFF) nor zeroed cells pass, so a record torn by a power cut reads as no
+ * record at all, but for one chance in 65536.
+ */
+struct RunRecord {
+  uint16_t seq;
+  uint16_t run;         // Seconds on, up to RUN_SECONDS_MAX, and the flags
+  uint16_t offSeconds;  // Collector off before this run, or RUN_OFF_UNKNOWN
+  uint16_t check;
+
+  uint16_t runSeconds() const { return run & RUN_SECONDS_MAX; }
+  uint8_t flags() const { return run >> RUN_FLAGS_SHIFT; }
+};
+
+/*
+ * Totals over every run logged, kept alongside the ring so they outlive the
+ * records that made them: 16 bytes. seq is that of the last run folded in,
+ * and runs stopped other ways are seq less the three stop counts.
+ */
+struct RunTotals {
+  uint32_t runSeconds;
+  uint16_t seq;
+  uint16_t shortRuns;
+  uint16_t stops[RUN_STOP_OTHER];
+  uint16_t check;
+
+  void add(const RunRecord &r);
+};
+
+static_assert(sizeof(RunRecord) == 8 && sizeof(RunTotals) == 16,
+  "Run log entries are stored as is and must not have padding");
+
+/*
+ * EEPROM layout, above the receiver's settings, which the linker places from
+ * address 0 (main-receiver.cpp checks they end below RUNLOG_BASE). Totals go
+ * round RUNLOG_TOTAL_SLOTS slots and records round RUNLOG_RECORDS, a slot
+ * further on each run, so a power cut mid-write only ever tears the entry
+ * being written and each cell is written once per lap: at 100,000 writes a
+ * cell, the totals last 800,000 runs and the records 4 million. hfuse 0xD7
+ * sets EESAVE, so the log survives reprogramming.
+ */
+const uint16_t RUNLOG_EEPROM_SIZE = 512;  // ATtiny84
+const uint16_t RUNLOG_BASE = 0x40;
+const uint8_t RUNLOG_TOTAL_SLOTS = 8;
+const uint8_t RUNLOG_RECORDS = 40;
+const uint16_t RUNLOG_RECORD_BASE = RUNLOG_BASE + RUNLOG_TOTAL_SLOTS * sizeof(RunTotals);
+const uint16_t RUNLOG_END = RUNLOG_RECORD_BASE + RUNLOG_RECORDS * sizeof(RunRecord);
+
+static_assert(RUNLOG_END <= RUNLOG_EEPROM_SIZE, "Run log must fit the EEPROM");
+
+// Checksum of an entry of length bytes, over all but its last two: the
+// complemented mod-256 Fletcher sums, as for the statistics frames.
+uint16_t runLogCheck(const uint8_t *p, uint8_t length);
+bool runLogValid(const uint8_t *p, uint8_t length);
+
+/*
+ * The newest valid entries in an EEPROM image, with the totals brought up to
+ * date if the power went between a record and its totals. Shared by the
+ * firmware at boot, through the HAL, and the host parser, on a dump.
+ */
+struct RunLogScan {
+  RunTotals totals;
+  uint16_t newestSeq;
+  uint8_t newestRecord;   // Index in the ring, if any
+  bool anyRecord;
+  bool totalsBehind;      // totals needed the newest record folded in
+
+  // read(addr) returns the EEPROM byte at addr.
+  template <typename Read> void scan(Read read);
+};
+
+/*
+ * Persistent log of collector runs in EEPROM. The receiver calls started()
+ * and stopped() as the output switches; they only note the run in RAM.
+ * poll(), from loop(), writes it out a byte at a time, and only while the
+ * EEPROM is idle, so neither the ISRs nor a state change ever wait on a
+ * write. A run takes 24 bytes, a tenth of a second. There is room for one
+ * more run to end while one is being written, which no sequence of codes
+ * can outpace; a run cut short by a power cut isn't logged. 47 bytes.
+ */
+class RunLog {
+  public:
+    // Picks up where the log in EEPROM left off. Without it nothing is
+    // written, so simulations can run receivers freely.
+    void begin();
+
+    void started(Code cause, uint32_t now);
+    void stopped(Code cause, uint32_t now);
+
+    // Write the next byte, if there is one and the EEPROM is free.
+    void poll();
+    bool isWriting() const { return writing; }
+
+    const RunTotals &currentTotals() const { return totals; }
+
+  private:
+    void next();
+
+    RunTotals totals = {};
+    RunRecord record = {};   // Being written
+    RunRecord queued = {};
+    bool enabled = false;
+    bool writing = false;
+    bool hasQueued = false;
+    bool keyfobStart = false;
+    bool stoppedOnce = false;
+    uint8_t slot = 0;        // Ring index of the record being written
+    uint8_t offset = 0;      // Bytes of it and then of its totals written
+    uint32_t startTime = 0;
+    uint32_t stopTime = 0;
+};
+
+template <typename Read> void RunLogScan::scan(Read read) {
+  totals = {};
+  anyRecord = false;
+  totalsBehind = false;
+  newestSeq = 0;
+  newestRecord = 0;
+
+  bool anyTotals = false;
+  for (uint8_t i = 0; i < RUNLOG_TOTAL_SLOTS; i++) {
+    RunTotals t;
+    uint8_t *p = (uint8_t *)&t;
+    for (uint8_t j = 0; j < sizeof(t); j++)
+      p[j] = read(RUNLOG_BASE + i * sizeof(t) + j);
+    if (runLogValid(p, sizeof(t)) && (!anyTotals || (int16_t)(t.seq - totals.seq) > 0)) {
+      totals = t;
+      anyTotals = true;
+    }
+  }
+
+  RunRecord newest = {};
+  for (uint8_t i = 0; i < RUNLOG_RECORDS; i++) {
+    RunRecord r;
+    uint8_t *p = (uint8_t *)&r;
+    for (uint8_t j = 0; j < sizeof(r); j++)
+      p[j] = read(RUNLOG_RECORD_BASE + i * sizeof(r) + j);
+    if (runLogValid(p, sizeof(r)) && (!anyRecord || (int16_t)(r.seq - newest.seq) > 0)) {
+      newest = r;
+      newestSeq = r.seq;
+      newestRecord = i;
+      anyRecord = true;
+    }
+  }
+
+  if (anyRecord && (uint16_t)(newest.seq - totals.seq) == 1) {
+    totals.add(newest);
+    totalsBehind = true;
+  }
+}
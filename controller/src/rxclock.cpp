@@ -0,0 +1,112 @@
+#include "rxclock.h"
+
+#if defined(__AVR_ATtiny84__)
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "hal.h"
+
+// A count is 16/125 ms, so the time is kept as whole milliseconds at the last
+// wrap and the remainder in 125ths; a wrap of 65536 counts is 8388 76/125 ms.
+static const uint8_t FRAC_PER_MS = 125;
+static const uint32_t WRAP_MS = 8388;
+static const uint8_t WRAP_FRAC = 76;
+
+static volatile uint32_t baseMs = 0;
+static volatile uint8_t baseFrac = 0;
+
+static void addWrap(uint32_t &ms, uint8_t &frac) {
+  ms += WRAP_MS;
+  frac += WRAP_FRAC;
+  if (frac >= FRAC_PER_MS) {
+    frac -= FRAC_PER_MS;
+    ms++;
+  }
+}
+
+void rxClockBegin() {
+  TIMSK0 &= ~_BV(TOIE0);
+
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  TIFR1 = _BV(TOV1) | _BV(OCF1A) | _BV(OCF1B);
+  TIMSK1 = _BV(TOIE1);
+  TCCR1B = _BV(CS12) | _BV(CS10);  // Normal mode, CK/1024
+}
+
+uint32_t rxClockMillis() {
+  InterruptLock lock;
+  uint32_t ms = baseMs;
+  uint8_t frac = baseFrac;
+  uint16_t count = TCNT1;
+  // A wrap whose interrupt hasn't run yet: interrupts are off, or this is
+  // another ISR.
+  if ((TIFR1 & _BV(TOV1)) && count < 0x8000)
+    addWrap(ms, frac);
+  return ms + ((uint32_t)count * 16 + frac) / FRAC_PER_MS;
+}
+
+void rxClockDelay(uint16_t ms) {
+  uint32_t start = rxClockMillis();
+  while (rxClockMillis() - start < ms)
+    ;
+}
+
+bool rxClockWakeAt(uint32_t ms) {
+  TIMSK1 &= ~_BV(OCIE1B);
+  // The overflow ISR has a wrap to catch up on first.
+  if (TIFR1 & _BV(TOV1))
+    return false;
+
+  int32_t since = ms - baseMs;
+  if (since < 0)
+    return false;
+  // Beyond this wrap; the overflow interrupt wakes us on the way.
+  if ((uint32_t)since > WRAP_MS)
+    return true;
+
+  // First count at which rxClockMillis() reads ms.
+  uint32_t units = (uint32_t)since * FRAC_PER_MS;
+  units = units > baseFrac ? units - baseFrac : 0;
+  uint32_t target = (units + 15) / 16;
+  if (target > 0xFFFF)
+    return true;
+
+  if (TCNT1 >= target)
+    return false;
+  OCR1B = target;
+  TIFR1 = _BV(OCF1B);
+  TIMSK1 |= _BV(OCIE1B);
+  // The count may have reached it while it was being set.
+  return TCNT1 < target;
+}
+
+void rxClockTickStart() {
+  InterruptLock lock;
+  if (TIMSK1 & _BV(OCIE1A))
+    return;
+  OCR1A = TCNT1 + RX_CLOCK_TICK_COUNTS;
+  TIFR1 = _BV(OCF1A);
+  TIMSK1 |= _BV(OCIE1A);
+}
+
+void rxClockTickStop() {
+  InterruptLock lock;
+  TIMSK1 &= ~_BV(OCIE1A);
+}
+
+ISR(TIM1_OVF_vect) {
+  uint32_t ms = baseMs;
+  uint8_t frac = baseFrac;
+  addWrap(ms, frac);
+  baseMs = ms;
+  baseFrac = frac;
+}
+
+// Only there to wake the core; one deadline at a time.
+ISR(TIM1_COMPB_vect) {
+  TIMSK1 &= ~_BV(OCIE1B);
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+/*
+ * Millisecond clock and deadline wakeup for the receiver on Timer1, in place
+ * of the Arduino core's millis(). The core keeps millis() with timer0's
+ * overflow interrupt, which wakes the receiver every 2.048 ms whether or not
+ * anything is due. Timer1 instead runs free at CK/1024, 128 us a count, and
+ * only interrupts when it wraps, every 8.39 s, and on compare B, set for the
+ * next deadline (rxClockWakeAt()). Compare A times the debounced builds'
+ * input sampling tick, and only while the debouncer has something to settle.
+ * Timer0's overflow interrupt is switched off, so the core's millis(),
+ * micros() and delay() stop; timer0 itself goes to the USI transmitter.
+ *
+ * Converting counts to milliseconds takes a 32-bit division, several hundred
+ * cycles without a hardware multiplier, but only a handful of times a wakeup.
+ *
+ * Receiver firmware only.
+ */
+
+#include <stdint.h>
+
+#if defined(__AVR_ATtiny84__)
+
+// Timer1 counts in each sampling tick: 2.048 ms, timer0's old tick.
+const uint8_t RX_CLOCK_TICK_COUNTS = 16;
+
+// Take over Timer1 and stop timer0's overflow interrupt. Call first thing in
+// setup(), before anything that needs the time.
+void rxClockBegin();
+
+// Milliseconds since rxClockBegin(), wrapping like millis(). Safe from ISRs.
+uint32_t rxClockMillis();
+
+// Busy wait, for the self-test.
+void rxClockDelay(uint16_t ms);
+
+// Wake the core by time ms, or at the next wrap if that comes first, for
+// loop() to look again. Returns false if ms has already come, when the caller
+// mustn't sleep. Call with interrupts off, just before sleeping.
+bool rxClockWakeAt(uint32_t ms);
+
+// Sampling tick on compare A, every RX_CLOCK_TICK_COUNTS. Starting it while
+// it runs leaves it alone; its ISR moves OCR1A on by RX_CLOCK_TICK_COUNTS.
+void rxClockTickStart();
+void rxClockTickStop();
+
+#endif
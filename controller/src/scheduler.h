@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * A handful of one-shot millisecond timers, with the earliest one cached so
+ * the main loop can check for work with a single comparison. Arming or
+ * cancelling a timer rescans the set, which only happens on state changes.
+ */
+template <uint8_t N>
+class DeadlineScheduler {
+    static_assert(N <= 8, "DeadlineScheduler tracks armed timers in a byte");
+
+  public:
+    void arm(uint8_t id, uint32_t when) {
+      times[id] = when;
+      armed |= 1 << id;
+      rescan();
+    }
+
+    void cancel(uint8_t id) {
+      armed &= ~(1 << id);
+      rescan();
+    }
+
+    void cancelAll() {
+      armed = 0;
+    }
+
+    bool isArmed() const { return armed != 0; }
+    bool isArmed(uint8_t id) const { return armed & (1 << id); }
+
+    // Deadline of timer id. Only meaningful when isArmed(id).
+    uint32_t deadline(uint8_t id) const { return times[id]; }
+
+    // Earliest armed deadline. Only meaningful when isArmed().
+    uint32_t next() const { return nextTime; }
+    uint8_t nextId() const { return nextTimer; }
+
+    // True if the earliest armed deadline has been reached at time now.
+    bool isDue(uint32_t now) const {
+      return armed != 0 && (int32_t)(now - nextTime) >= 0;
+    }
+
+  private:
+    uint32_t times[N];
+    uint8_t armed = 0;
+    uint8_t nextTimer = 0;
+    uint32_t nextTime = 0;
+
+    void rescan() {
+      bool found = false;
+      for (uint8_t i = 0; i < N; i++) {
+        if ((armed & (1 << i)) && (!found || (int32_t)(times[i] - nextTime) < 0)) {
+          nextTime = times[i];
+          nextTimer = i;
+          found = true;
+        }
+      }
+    }
+};
@@ -0,0 +1,21 @@
+#include "sim.h"
+#include "hal.h"
+
+void simAdvanceTo(Receiver &receiver, uint32_t t) {
+  while (receiver.hasDeadline()) {
+    uint32_t deadline = receiver.nextDeadline();
+    if (!simAtOrBefore(deadline, t))
+      break;
+    if (!simAtOrBefore(deadline, halMillis()))
+      halSimSetMillis(deadline);
+    receiver.poll();
+  }
+  if (!simAtOrBefore(t, halMillis()))
+    halSimSetMillis(t);
+}
+
+void simSetInputs(Receiver &receiver, uint32_t t, uint8_t bits) {
+  simAdvanceTo(receiver, t);
+  halSimSetCodeInputs(bits);
+  receiver.onPinChange();
+}
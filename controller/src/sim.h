@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+ * Helpers shared by the host-side simulations. Native only.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "receiver.h"
+
+// Comparisons on the 32-bit millisecond clock, allowing for wraparound.
+inline bool simBefore(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+inline bool simAtOrBefore(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) <= 0;
+}
+
+// Running min/mean/max of a millisecond quantity.
+struct SimStat {
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint32_t min = UINT32_MAX;
+  uint32_t max = 0;
+
+  void add(uint32_t v) {
+    count++;
+    sum += v;
+    if (v < min) min = v;
+    if (v > max) max = v;
+  }
+
+  void print(const char *name) const {
+    if (count == 0) {
+      printf("  %-22s (none)\n", name);
+      return;
+    }
+    printf("  %-22s min %6u  mean %9.1f  max %6u ms\n",
+      name, min, (double)sum / count, max);
+  }
+};
+
+// Run the receiver's loop at each of its deadlines up to time t, then set the
+// clock to t. The clock never moves backwards.
+void simAdvanceTo(Receiver &receiver, uint32_t t);
+
+// Present new inputs to the receiver at time t and run its pin change handler.
+// They take effect once they have settled, in a later simAdvanceTo().
+void simSetInputs(Receiver &receiver, uint32_t t, uint8_t bits);
@@ -0,0 +1,37 @@
+#include "stats.h"
+
+uint8_t statsBucket(uint32_t value) {
+  uint8_t b = 0;
+  while (value != 0 && b < STATS_BUCKETS - 1) {
+    value >>= 1;
+    b++;
+  }
+  return b;
+}
+
+bool StatsFrameWriter::next(uint8_t &b) {
+  uint8_t i = index;
+  if (i >= STATS_FRAME_SIZE)
+    return false;
+  index = i + 1;
+
+  if (i == 0)
+    b = STATS_SYNC_0;
+  else if (i == 1)
+    b = STATS_SYNC_1;
+  else if (i == STATS_FRAME_SIZE - 2)
+    b = sum1;
+  else if (i == STATS_FRAME_SIZE - 1)
+    b = sum2;
+  else {
+    if (i == 2)
+      b = STATS_FRAME_TYPE;
+    else if (i == 3)
+      b = STATS_PAYLOAD_SIZE;
+    else
+      b = stats[i - 4];
+    sum1 += b;
+    sum2 += sum1;
+  }
+  return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+
+// Event counters kept by the receiver. The three timeouts are in the same
+// order as ReceiverTimer, so a timer ID maps straight onto its counter.
+enum ReceiverStat : uint8_t {
+  STAT_CODES,             // Valid codes decoded from the inputs
+  STAT_REJECTED,          // Nonzero codes isValidCode() turned away, tool
+                          // codes whose complement frame didn't follow, and
+                          // codes that failed the pulse width check
+  STAT_GLITCHES,          // Samples replaced before they settled
+  STAT_OVERFLOWS,         // Samples the code queue dropped (copied in when sent)
+  STAT_SEQ_TIMEOUTS,      // CODE_SEQ_TIMEOUT fired
+  STAT_QUIET_TIMEOUTS,    // TOOL_QUIET_TIMEOUT fired
+  STAT_SHUTOFF_TIMEOUTS,  // SHUTOFF_TIMEOUT fired
+  STAT_STARTS,            // Collector switched on
+  RECEIVER_STATS
+};
+
+// Histogram buckets are powers of two: bucket 0 holds 0, bucket b holds
+// [2^(b-1), 2^b) units, and the last bucket everything above.
+const uint8_t STATS_BUCKETS = 16;
+
+// Gap between valid codes, in milliseconds; last bucket from 16.4 s.
+const uint8_t GAP_UNIT_SHIFT = 0;
+// Collector on time per start, in units of 256 ms; last bucket from 70 min.
+const uint8_t RUN_UNIT_SHIFT = 8;
+
+uint8_t statsBucket(uint32_t value);
+
+/*
+ * Saturating counters and log-bucketed histograms of what the receiver sees.
+ * Everything is a 16-bit count, updated with interrupts off, so the serial
+ * interrupt can stream the block out byte by byte while loop() keeps
+ * counting. A frame sent that way isn't a snapshot, but every count in it is
+ * whole. 80 bytes.
+ */
+struct ReceiverStats {
+  uint16_t counters[RECEIVER_STATS];
+  uint16_t gaps[STATS_BUCKETS];
+  uint16_t runTimes[STATS_BUCKETS];
+
+  void count(ReceiverStat s) { increment(counters[s]); }
+  void set(ReceiverStat s, uint16_t value) {
+    InterruptLock lock;
+    counters[s] = value;
+  }
+  void addGap(uint32_t ms) { increment(gaps[statsBucket(ms >> GAP_UNIT_SHIFT)]); }
+  void addRunTime(uint32_t ms) { increment(runTimes[statsBucket(ms >> RUN_UNIT_SHIFT)]); }
+
+  private:
+    static void increment(uint16_t &c) {
+      InterruptLock lock;
+      if (c != UINT16_MAX)
+        c++;
+    }
+};
+
+static_assert(sizeof(ReceiverStats) == 2 * (RECEIVER_STATS + 2 * STATS_BUCKETS),
+  "ReceiverStats is sent as is and must not have padding");
+
+/*
+ * Statistics frame on the serial link:
+ *
+ *   'A' 'V' type length payload sum1 sum2
+ *
+ * The payload is the ReceiverStats block, little-endian 16-bit counts.
+ * sum1 is the 8-bit sum of the type, length and payload bytes, and sum2 the
+ * 8-bit sum of the running sum1 (a mod-256 Fletcher checksum).
+ */
+const uint8_t STATS_SYNC_0 = 'A';
+const uint8_t STATS_SYNC_1 = 'V';
+const uint8_t STATS_FRAME_TYPE = 1;
+const uint8_t STATS_PAYLOAD_SIZE = sizeof(ReceiverStats);
+const uint8_t STATS_FRAME_SIZE = STATS_PAYLOAD_SIZE + 6;
+
+// Produces the bytes of one frame, one at a time. next() is cheap enough to
+// call from the transmit interrupt.
+class StatsFrameWriter {
+  public:
+    void begin(const ReceiverStats *s) {
+      stats = (const uint8_t *)s;
+      index = 0;
+      sum1 = 0;
+      sum2 = 0;
+    }
+
+    // Next byte of the frame; false once it has all been sent.
+    bool next(uint8_t &b);
+
+  private:
+    const uint8_t *stats = 0;
+    uint8_t index = STATS_FRAME_SIZE;
+    uint8_t sum1 = 0;
+    uint8_t sum2 = 0;
+};
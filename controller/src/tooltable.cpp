@@ -0,0 +1,61 @@
+#include "tooltable.h"
+
+ToolTable::ToolTable() {
+  clear();
+}
+
+void ToolTable::clear() {
+  for (uint8_t i = 0; i < MAX_TOOLS; i++)
+    entries[i].active = 0;
+  head = NO_TOOL;
+  tail = NO_TOOL;
+  count = 0;
+}
+
+void ToolTable::unlink(uint8_t id) {
+  Entry &e = entries[id];
+  if (e.prev == NO_TOOL)
+    head = e.next;
+  else
+    entries[e.prev].next = e.next;
+  if (e.next == NO_TOOL)
+    tail = e.prev;
+  else
+    entries[e.next].prev = e.prev;
+  e.active = 0;
+  count--;
+}
+
+void ToolTable::seen(uint8_t id, uint32_t now) {
+  if (id >= MAX_TOOLS)
+    return;
+  Entry &e = entries[id];
+  if (e.active)
+    unlink(id);
+
+  e.lastSeen = (uint16_t)now;
+  e.active = 1;
+  e.prev = tail;
+  e.next = NO_TOOL;
+  if (tail == NO_TOOL)
+    head = id;
+  else
+    entries[tail].next = id;
+  tail = id;
+  count++;
+}
+
+void ToolTable::remove(uint8_t id) {
+  if (isActive(id))
+    unlink(id);
+}
+
+void ToolTable::expire(uint32_t now, uint16_t interval) {
+  // Every entry was within interval at the last call, so after this long all
+  // are past it, and their 16-bit ages may have wrapped to look fresh.
+  if (now - expiredTime > (uint16_t)~interval)
+    clear();
+  expiredTime = now;
+  while (head != NO_TOOL && (uint16_t)((uint16_t)now - entries[head].lastSeen) > interval)
+    unlink(head);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include "codes.h"
+
+// Transmitter IDs run from 0 to MAX_TOOLS - 1.
+const uint8_t NO_TOOL = 0x7F;  // Fits the 7-bit list links
+
+/*
+ * Last-seen times of the identified transmitters that are currently active.
+ *
+ * Every tool ages out after the same interval, so expiry order is the order
+ * in which tools were last seen. The active tools are kept in a doubly linked
+ * list in that order, threaded through a table indexed by ID: marking a tool
+ * seen moves it to the tail, and aging only ever looks at the head. Both are
+ * O(1) per received code. Times are the low 16 bits of millis(). That is
+ * plenty while expire() runs within 65.5 s less the aging interval of its
+ * last call, as it does on every code and timeout while the collector runs.
+ * Codes can stop for longer, such as after a STOP or a shutoff with the
+ * tools quiet, so expire() also keeps the full time of its last call and
+ * drops every entry once that is too long ago for their ages to be trusted.
+ *
+ * Size is 4 bytes per tool plus 7, 135 bytes for 32 tools.
+ */
+class ToolTable {
+  public:
+    ToolTable();
+
+    // Record a code from tool id at time now.
+    void seen(uint8_t id, uint32_t now);
+
+    // Drop tool id, if it's active.
+    void remove(uint8_t id);
+
+    // Drop every tool not seen within interval of now. Call it before
+    // seen() with each new time.
+    void expire(uint32_t now, uint16_t interval);
+
+    void clear();
+
+    uint8_t activeCount() const { return count; }
+    bool isActive(uint8_t id) const { return id < MAX_TOOLS && entries[id].active; }
+
+    // Most recently seen tool, or NO_TOOL.
+    uint8_t newest() const { return tail; }
+    uint8_t oldest() const { return head; }
+
+    // Full millis() time tool id was last seen, given the current time.
+    uint32_t lastSeen(uint8_t id, uint32_t now) const {
+      return now - (uint16_t)((uint16_t)now - entries[id].lastSeen);
+    }
+
+  private:
+    struct Entry {
+      uint16_t lastSeen;
+      uint8_t prev : 7;
+      uint8_t active : 1;
+      uint8_t next;
+    };
+
+    Entry entries[MAX_TOOLS];
+    uint8_t head;
+    uint8_t tail;
+    uint8_t count;
+    uint32_t expiredTime = 0;  // Last call of expire()
+
+    void unlink(uint8_t id);
+};
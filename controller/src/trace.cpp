@@ -0,0 +1,312 @@
+#include "trace.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+PinTraceReader::~PinTraceReader() {
+  if (file)
+    fclose(file);
+}
+
+bool PinTraceReader::open(const char *path, std::string &err) {
+  file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+  if (!file) {
+    err = std::string(path) + ": " + strerror(errno);
+    return false;
+  }
+  int c;
+  while ((c = getc(file)) != EOF && isspace(c))
+    ;
+  if (c != EOF)
+    ungetc(c, file);
+  vcd = c == '$';
+  if (vcd && !readHeader()) {
+    err = error;
+    return false;
+  }
+  return true;
+}
+
+bool PinTraceReader::next(PinEdge &e) {
+  return vcd ? nextVcd(e) : nextCsv(e);
+}
+
+// The next whitespace-separated token, false at the end of the file.
+bool PinTraceReader::token(std::string &t) {
+  t.clear();
+  for (;;) {
+    if (pos == length) {
+      length = fread(buffer, 1, sizeof(buffer), file);
+      pos = 0;
+      if (length == 0)
+        return !t.empty();
+    }
+    char c = buffer[pos++];
+    if (isspace((unsigned char)c)) {
+      if (c == '\n')
+        lines++;
+      if (!t.empty())
+        return true;
+    }
+    else {
+      t += c;
+    }
+  }
+}
+
+// Up to and including the next $end.
+bool PinTraceReader::skipSection() {
+  std::string t;
+  while (token(t)) {
+    if (t == "$end")
+      return true;
+  }
+  error = "unterminated section";
+  return false;
+}
+
+static bool endsWithPin(const std::string &name, int &bit) {
+  size_t n = name.size();
+  if (n < 3 || toupper(name[n - 3]) != 'P' || toupper(name[n - 2]) != 'A' ||
+      name[n - 1] < '0' || name[n - 1] > '3')
+    return false;
+  bit = name[n - 1] - '0';
+  return true;
+}
+
+// Definitions, up to $enddefinitions.
+bool PinTraceReader::readHeader() {
+  struct Var {
+    std::string id;
+    unsigned size;
+    std::string name;
+  };
+  std::vector<Var> vars;
+  std::string t;
+
+  while (token(t)) {
+    if (t == "$enddefinitions")
+      break;
+    if (t == "$timescale") {
+      std::string scale, part;
+      while (token(part) && part != "$end")
+        scale += part;
+      char *unit;
+      unsigned long n = strtoul(scale.c_str(), &unit, 10);
+      const struct { const char *name; uint64_t mul, div; } units[] = {
+        {"s", 1000000000, 1}, {"ms", 1000000, 1}, {"us", 1000, 1},
+        {"ns", 1, 1}, {"ps", 1, 1000}, {"fs", 1, 1000000},
+      };
+      bool found = false;
+      for (auto &u : units) {
+        if (n > 0 && strcmp(unit, u.name) == 0) {
+          scaleMul = n * u.mul;
+          scaleDiv = u.div;
+          found = true;
+        }
+      }
+      if (!found) {
+        error = "unknown timescale " + scale;
+        return false;
+      }
+    }
+    else if (t == "$var") {
+      Var v;
+      std::string type, size;
+      if (!token(type) || !token(size) || !token(v.id) || !token(v.name)) {
+        error = "truncated $var";
+        return false;
+      }
+      v.size = strtoul(size.c_str(), NULL, 10);
+      vars.push_back(v);
+      if (!skipSection())
+        return false;
+    }
+    else if (t[0] == '$' && t != "$end") {
+      if (!skipSection())
+        return false;
+    }
+  }
+  if (!skipSection())
+    return false;
+
+  // Named pins first, then the first four scalars, then a vector.
+  for (const Var &v : vars) {
+    int bit;
+    if (v.size == 1 && endsWithPin(v.name, bit))
+      signals.push_back(Signal{v.id, bit});
+  }
+  if (signals.empty()) {
+    for (const Var &v : vars) {
+      if (v.size == 1 && signals.size() < 4)
+        signals.push_back(Signal{v.id, (int)signals.size()});
+    }
+  }
+  if (signals.empty()) {
+    for (const Var &v : vars) {
+      if (v.size >= 4) {
+        signals.push_back(Signal{v.id, -1});
+        break;
+      }
+    }
+  }
+  if (signals.empty()) {
+    error = "no PA0-PA3 signals";
+    return false;
+  }
+  return true;
+}
+
+void PinTraceReader::assign(const std::string &id, uint64_t value, bool vector) {
+  for (const Signal &s : signals) {
+    if (s.id != id)
+      continue;
+    if (s.bit < 0 && vector)
+      bits = value & 0b1111;
+    else if (s.bit >= 0 && !vector)
+      bits = (bits & ~(1 << s.bit)) | ((value & 1) << s.bit);
+  }
+}
+
+bool PinTraceReader::nextVcd(PinEdge &e) {
+  std::string t;
+  while (token(t)) {
+    switch (t[0]) {
+      case '#': {
+        uint64_t at = time;
+        time = strtoull(t.c_str() + 1, NULL, 10);
+        if (bits != emitted) {
+          emitted = bits;
+          e = PinEdge{at * scaleMul / scaleDiv, bits};
+          return true;
+        }
+        break;
+      }
+
+      case '0': case '1':
+      case 'x': case 'X': case 'z': case 'Z':
+        assign(t.substr(1), t[0] == '1', false);
+        break;
+
+      case 'b': case 'B': {
+        uint64_t value = 0;
+        for (size_t i = 1; i < t.size(); i++)
+          value = (value << 1) | (t[i] == '1');
+        std::string id;
+        if (!token(id)) {
+          error = "truncated vector change";
+          return false;
+        }
+        assign(id, value, true);
+        break;
+      }
+
+      case 'r': case 'R': {
+        std::string id;
+        token(id);
+        break;
+      }
+
+      case '$':
+        // $dumpvars and the like hold ordinary changes; only comments need
+        // skipping.
+        if (t == "$comment" && !skipSection())
+          return false;
+        break;
+
+      default:
+        error = "line " + std::to_string(lines + 1) + ": unexpected " + t;
+        return false;
+    }
+  }
+  if (bits != emitted) {
+    emitted = bits;
+    e = PinEdge{time * scaleMul / scaleDiv, bits};
+    return true;
+  }
+  return false;
+}
+
+// The unit of a header's time field: what is in brackets, or its last word.
+static double headerUnitNs(std::string field) {
+  size_t open = field.find_first_of("[(");
+  if (open != std::string::npos) {
+    size_t close = field.find_first_of("])", open);
+    field = field.substr(open + 1, close == std::string::npos ? std::string::npos : close - open - 1);
+  }
+  else {
+    size_t space = field.find_last_of(" _");
+    if (space != std::string::npos)
+      field = field.substr(space + 1);
+  }
+  for (char &c : field)
+    c = tolower(c);
+  if (field == "ns")
+    return 1;
+  if (field == "us" || field == "\xc2\xb5s")
+    return 1e3;
+  if (field == "ms")
+    return 1e6;
+  return 1e9;
+}
+
+bool PinTraceReader::nextCsv(PinEdge &e) {
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    lines++;
+    if (!strchr(line, '\n') && !feof(file)) {
+      error = "line " + std::to_string(lines) + ": too long";
+      return false;
+    }
+    char *p = line;
+    while (isspace((unsigned char)*p))
+      p++;
+    if (*p == '\0' || *p == '#' || *p == ';')
+      continue;
+
+    std::vector<std::string> fields;
+    for (char *f = strtok(p, ",\r\n"); f; f = strtok(NULL, ",\r\n"))
+      fields.push_back(f);
+
+    char *end;
+    double t = strtod(fields[0].c_str(), &end);
+    if (end == fields[0].c_str()) {
+      if (started) {
+        error = "line " + std::to_string(lines) + ": bad time";
+        return false;
+      }
+      unitNs = headerUnitNs(fields[0]);
+      continue;
+    }
+
+    uint8_t value = 0;
+    if (fields.size() >= 5) {
+      for (int b = 0; b < 4; b++)
+        if (strtoul(fields[b + 1].c_str(), NULL, 0))
+          value |= 1 << b;
+    }
+    else if (fields.size() == 2) {
+      value = strtoul(fields[1].c_str(), NULL, 0) & 0b1111;
+    }
+    else {
+      error = "line " + std::to_string(lines) + ": expected 4 channel columns or one value column";
+      return false;
+    }
+
+    if (!started) {
+      started = true;
+      origin = t;
+    }
+    bits = value;
+    if (bits != emitted) {
+      emitted = bits;
+      double ns = (t - origin) * unitNs;
+      e = PinEdge{ns > 0 ? (uint64_t)llround(ns) : 0, bits};
+      return true;
+    }
+  }
+  return false;
+}
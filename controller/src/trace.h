@@ -0,0 +1,76 @@
+#pragma once
+
+/*
+ * Logic analyzer captures of the receiver's PA0-PA3 inputs, read as a stream
+ * of changes to the four bits. Host only.
+ *
+ * VCD: signals whose names end in PA0 to PA3 (any case) are those pins;
+ * otherwise the first four 1-bit signals declared are PA0 to PA3 in order. A
+ * vector signal of four or more bits, when there are no scalars, is all four
+ * with PA0 its low bit. x and z read as 0. Changes at one timestamp are one
+ * edge.
+ *
+ * CSV: a time column, then either four 0/1 columns PA0 to PA3 or one column
+ * holding the four bits as a number (0-15, or 0x0-0xF). A header line is
+ * skipped, and sets the time unit if its first field mentions ns, us or ms;
+ * times are in seconds otherwise, as logic analyzer exports write them.
+ * Lines starting with # or ; are comments. Times in a CSV are from its first
+ * row.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct PinEdge {
+  uint64_t ns;    // From time 0 of the capture
+  uint8_t bits;   // PA3..PA0 from this time on
+};
+
+class PinTraceReader {
+  public:
+    ~PinTraceReader();
+
+    // Open a capture, VCD if it starts with $ and CSV otherwise.
+    bool open(const char *path, std::string &error);
+
+    // The next time the inputs change. False at the end, or on a parse error
+    // with error set.
+    bool next(PinEdge &e);
+
+    std::string error;
+
+  private:
+    FILE *file = NULL;
+    bool vcd = false;
+    uint8_t bits = 0;       // The inputs as read so far
+    uint8_t emitted = 0;    // and as last returned by next()
+    uint64_t lines = 0;
+
+    // VCD: times are scaled to ns by scaleMul / scaleDiv.
+    struct Signal {
+      std::string id;
+      int bit;      // PA bit for a scalar, or -1 for a vector
+    };
+    std::vector<Signal> signals;
+    uint64_t scaleMul = 1;
+    uint64_t scaleDiv = 1;
+    uint64_t time = 0;
+    char buffer[1 << 16];
+    size_t length = 0;
+    size_t pos = 0;
+
+    // CSV: times are relative to the first row, as exports from a triggered
+    // capture start before time 0.
+    double unitNs = 1e9;
+    bool started = false;
+    double origin = 0;
+
+    bool token(std::string &t);
+    bool skipSection();
+    bool readHeader();
+    void assign(const std::string &id, uint64_t value, bool vector);
+    bool nextVcd(PinEdge &e);
+    bool nextCsv(PinEdge &e);
+};
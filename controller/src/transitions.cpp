@@ -0,0 +1,17 @@
+#include "transitions.h"
+
+// One row per MotorState, one entry per code value. The rows are spelled out
+// because the firmware is built as C++11; keep them in step with CODE_COUNT.
+static_assert(CODE_COUNT == 19, "TRANSITION_ROW lists every code value");
+
+#define T(s, c) transition(MotorState::s, (Code)(c))
+#define TRANSITION_ROW(s) { \
+  T(s,  0), T(s,  1), T(s,  2), T(s,  3), T(s,  4), T(s,  5), T(s,  6), T(s,  7), \
+  T(s,  8), T(s,  9), T(s, 10), T(s, 11), T(s, 12), T(s, 13), T(s, 14), T(s, 15), \
+  T(s, 16), T(s, 17), T(s, 18) }
+
+const uint8_t TRANSITIONS[MOTOR_STATES][CODE_COUNT] HAL_FLASH = {
+  TRANSITION_ROW(OFF),
+  TRANSITION_ROW(MANUAL_RUN),
+  TRANSITION_ROW(AUTO_RUN),
+};
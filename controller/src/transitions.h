@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include "codes.h"
+#include "hal.h"
+
+// Output state machine.
+enum class MotorState : unsigned char { OFF, MANUAL_RUN, AUTO_RUN };
+const uint8_t MOTOR_STATES = 3;
+
+/*
+ * The receiver state machine as one table of (state, code) -> transition,
+ * built at compile time from transition() below, which is the only place the
+ * behaviour is written down. Receiver::newInput() looks up one byte and runs
+ * the actions it flags; the firmware keeps the table in flash.
+ *
+ * A transition byte holds the next state in its low bits, then what to do
+ * with the ID sequence, then one bit per action. The actions are only set
+ * where they apply, so newInput() doesn't have to test the state again.
+ */
+const uint8_t T_STATE       = 0b00000011;  // Next MotorState
+
+const uint8_t T_ID          = 0b00001100;  // What the code means for the ID sequence:
+const uint8_t T_ID_RESET    = 0b00000000;  //   abandon it
+const uint8_t T_ID_FOLLOWS  = 0b00000100;  //   start one; the ID names a running tool
+const uint8_t T_ID_STOPPED  = 0b00001000;  //   start one; the ID names a stopped tool
+const uint8_t T_ID_SYMBOL   = 0b00001100;  //   the code is the next symbol
+
+const uint8_t T_RUNNING     = 0b00010000;  // A tool is running: note the time
+const uint8_t T_QUIET       = 0b00100000;  // Restart the quiet timeout
+const uint8_t T_STOPPED     = 0b01000000;  // A tool stopped: maybe end early
+const uint8_t T_VALID       = 0b10000000;  // Code is acted on at all
+
+constexpr bool isMotorRunning(MotorState s) { return s != MotorState::OFF; }
+
+constexpr MotorState stateAfter(MotorState s, Code c) {
+  return c == Code::START || c == Code::TOOL_STARTING ? MotorState::MANUAL_RUN
+       : c == Code::STOP || c == Code::TOOL_QUIET_TIMEOUT || c == Code::SHUTOFF_TIMEOUT ? MotorState::OFF
+       : s;
+}
+
+constexpr bool isToolRunningCode(Code c) {
+  return c == Code::START || c == Code::TOOL_STARTING || c == Code::TOOL_RUNNING;
+}
+
+constexpr uint8_t idActionFor(Code c) {
+  return c == Code::TOOL_STARTING || c == Code::TOOL_RUNNING ? T_ID_FOLLOWS
+       : c == Code::TOOL_STOPPED ? T_ID_STOPPED
+       : isIdSymbol(c) ? T_ID_SYMBOL
+       : T_ID_RESET;
+}
+
+// Transition for code c in state s. Invalid codes leave everything alone.
+constexpr uint8_t transition(MotorState s, Code c) {
+  return !isValidCode(c) ? (uint8_t)s
+    : T_VALID
+      | (uint8_t)stateAfter(s, c)
+      | idActionFor(c)
+      | (isToolRunningCode(c) ? T_RUNNING : 0)
+      | (isToolRunningCode(c) && isMotorRunning(stateAfter(s, c)) ? T_QUIET : 0)
+      | (c == Code::TOOL_STOPPED && isMotorRunning(s) ? T_STOPPED : 0);
+}
+
+extern const uint8_t TRANSITIONS[MOTOR_STATES][CODE_COUNT] HAL_FLASH;
+
+inline uint8_t transitionFor(MotorState s, Code c) {
+  return halReadFlashByte(&TRANSITIONS[(uint8_t)s][(uint8_t)c]);
+}
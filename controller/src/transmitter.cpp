@@ -0,0 +1,170 @@
+#include "transmitter.h"
+#include "hal.h"
+
+const uint16_t WDT_PERIOD_MS[WDT_PERIODS] = {16, 32, 64, 125, 250, 500, 1000, 2000};
+
+// Called when first triggered to prepare for triggerOn.
+// Invoked by interrupt routine; any global variables changed should be declared volatile.
+void Transmitter::triggerOn() {
+  startupCodeCounter = STARTUP_CODE_COUNT;
+  backoffFrames = BACKOFF_FRAMES;
+}
+
+// Called when trigger released.
+// Invoked by interrupt routine; any global variables changed should be declared volatile.
+// step() sends the STOPPED codes once it sees the trigger released, and the
+// main loop ends the current gap early (isStopPending()). They back off like
+// the first frames after a start: tools switched off together stop together.
+void Transmitter::triggerOff() {
+  backoffFrames = BACKOFF_FRAMES;
+}
+
+void Transmitter::readTrigger() {
+  setTrigger(halReadTrigger());
+}
+
+void Transmitter::setTrigger(bool on) {
+  triggered = on;
+
+  if (triggered) {
+    triggerOn();
+  }
+  else {
+    triggerOff();
+  }
+
+}
+
+Code Transmitter::nextCode() {
+  if (startupCodeCounter > 0) {
+    startupCodeCounter--;
+    return Code::TOOL_STARTING;
+  }
+  return Code::TOOL_RUNNING;
+}
+
+uint16_t Transmitter::nextInterval(uint16_t min, uint16_t max) {
+  uint16_t width = max - min;
+  return (uint16_t)(txRandom(rngState) >> 16) % width + min;
+}
+
+void Transmitter::seed(uint32_t entropy) {
+  rngState = entropy != 0 ? entropy : TX_DEFAULT_SEED;
+  txRandom(rngState);
+}
+
+// Slots are one frame's airtime, the code and any complement and ID symbols
+// with their gaps, plus an eighth for the RC oscillators disagreeing.
+uint16_t Transmitter::backoffDelay() {
+  uint8_t frames = 1 + (complement ? 1 : 0) + (id == NO_ID ? 0 : 2);
+  uint16_t airtime = frames * frameTime + (frames - 1) * ID_GAP_TIME;
+  uint8_t window = BACKOFF_SLOTS << (BACKOFF_FRAMES - backoffFrames);
+  uint8_t slots = (uint8_t)(txRandom(rngState) >> 24) % window;
+  return slots * (airtime + airtime / 8);
+}
+
+void Transmitter::codeOn(Code c) {
+  // Assume all bits are currently zero.
+
+  // Turn on code bits. Active low.
+  uint8_t bits = ((uint8_t)c & (uint8_t)Code::MASK) << 1;
+  uint8_t invBits = ~bits;
+  halWriteCodeOutputs(invBits);
+}
+
+void Transmitter::codeOff() {
+  // Turn off (HIGH) all code bits.
+  halWriteCodeOutputs((uint8_t)Code::MASK << 1);
+}
+
+// Each frame holds a code for frameTime, followed by a random gap. With an
+// ID, the code is followed by the two ID symbols, ID_GAP_TIME apart, before
+// the gap; with complement frames, a STARTING or RUNNING code is followed by
+// its complement the same way, before any ID symbols. The trigger is checked
+// at the end of each gap, as the blocking loop did. Once it is released,
+// STOPPED_CODE_COUNT STOPPED codes go out (each with the ID) a short gap
+// apart, and then we idle. With backoff, each
+// of the first frames after a trigger change waits backoffDelay() first.
+uint16_t Transmitter::step() {
+  switch (state) {
+    case TxState::FRAME:
+      codeOff();
+      if (complementCode != Code::NONE || (id != NO_ID && idSymbolsSent < 2)) {
+        state = TxState::ID_GAP;
+        return ID_GAP_TIME;
+      }
+      state = TxState::GAP;
+      runningGap = triggered;
+      if (!runningGap)
+        return nextInterval(STOPPED_INTERVAL_MIN, STOPPED_INTERVAL_MAX);
+      return nextInterval(INTERVAL_MIN, INTERVAL_MAX);
+
+    case TxState::ID_GAP:
+      if (complementCode != Code::NONE) {
+        codeOn(complementCode);
+        complementCode = Code::NONE;
+      }
+      else {
+        codeOn(idSymbol(idSymbolsSent == 0 ? id >> 3 : id));
+        idSymbolsSent++;
+      }
+      state = TxState::FRAME;
+      return frameTime;
+
+    case TxState::IDLE:
+    case TxState::GAP:
+      if (backoff && backoffFrames > 0 && (triggered || stoppedCodeCounter > 0)) {
+        uint16_t ms = backoffDelay();
+        if (ms > 0) {
+          state = TxState::BACKOFF;
+          return ms;
+        }
+      }
+      // Fall through
+
+    case TxState::BACKOFF:
+      if (triggered) {
+        Code c = nextCode();
+        codeOn(c);
+        if (complement && isComplemented(c))
+          complementCode = complementOf(c);
+        stoppedCodeCounter = STOPPED_CODE_COUNT;
+      }
+      else if (stoppedCodeCounter > 0) {
+        codeOn(Code::TOOL_STOPPED);
+        stoppedCodeCounter--;
+      }
+      else {
+        state = TxState::IDLE;
+        return 0;
+      }
+      if (backoffFrames > 0)
+        backoffFrames--;
+      idSymbolsSent = 0;
+      state = TxState::FRAME;
+      return frameTime;
+  }
+  return 0;
+}
+
+WaitStep nextWaitStep(uint16_t &remaining, bool precise) {
+  WaitStep s;
+  if (precise || remaining < WDT_PERIOD_MS[0]) {
+    uint16_t ticks = ((uint32_t)remaining * 1000 + TIMER1_TICK_MICROS / 2) / TIMER1_TICK_MICROS;
+    s.watchdog = false;
+    s.setting = ticks == 0 ? 1 : (ticks > 255 ? 255 : ticks);
+    s.ms = remaining;
+    remaining = 0;
+    return s;
+  }
+
+  // Largest watchdog period that fits.
+  uint8_t wdp = WDT_PERIODS - 1;
+  while (WDT_PERIOD_MS[wdp] > remaining)
+    wdp--;
+  s.watchdog = true;
+  s.setting = wdp;
+  s.ms = WDT_PERIOD_MS[wdp];
+  remaining -= s.ms;
+  return s;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdint.h>
+#include "codes.h"
+
+// Transmit interval is 1500ms +- 500ms
+const uint16_t INTERVAL_MIN = 1000; // milliseconds
+const uint16_t INTERVAL_MAX = 2000; // milliseconds
+const uint16_t BIT_ON_TIME = 45; // milliseconds
+// Shortest frame hold: the RF module takes about 18 ms to send one word, so
+// a shorter frame may not get a word through at all.
+const uint16_t BIT_ON_TIME_MIN = 18; // milliseconds
+const uint16_t INTERBIT_INTERVAL = 265;
+const int STARTUP_CODE_COUNT = 3;
+
+// TOOL_STOPPED is sent this many times when the trigger is released, with a
+// short random gap between repeats so a collision doesn't take them all out.
+const uint8_t STOPPED_CODE_COUNT = 3;
+const uint16_t STOPPED_INTERVAL_MIN = 100; // milliseconds
+const uint16_t STOPPED_INTERVAL_MAX = 300; // milliseconds
+
+// Off time between the frames of a code, its complement and its ID symbols.
+// It stays the same with shorter frames: off time costs no airtime.
+const uint16_t ID_GAP_TIME = BIT_ON_TIME;
+
+// No ID: send codes alone. Also the erased EEPROM value.
+const uint8_t NO_ID = 0xFF;
+
+// Slotted backoff: each of the BACKOFF_FRAMES frames after a trigger change
+// waits a random number of slots first, one frame's airtime each, from a
+// window of BACKOFF_SLOTS that doubles frame by frame.
+const uint8_t BACKOFF_FRAMES = 3;
+const uint8_t BACKOFF_SLOTS = 2;
+
+// Interval generator seed while none is set, and in place of 0, which
+// xorshift never leaves.
+const uint32_t TX_DEFAULT_SEED = 2463534242UL;
+
+// Marsaglia's xorshift32: full period over the nonzero states, and shifts
+// and XORs only, for the ATtiny85 with no multiplier.
+inline uint32_t txRandom(uint32_t &state) {
+  uint32_t x = state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  state = x;
+  return x;
+}
+
+// Transmit state machine.
+enum class TxState : uint8_t { IDLE, FRAME, ID_GAP, GAP, BACKOFF };
+
+// Waits are timed by the watchdog while powered down, in its fixed periods,
+// with Timer1 at CK/4096 in idle mode for the remainder. Waits short enough
+// for Timer1 alone (the frame hold) use it throughout, for accuracy.
+const uint16_t TIMER1_TICK_MICROS = 512;
+const uint16_t TIMER1_MAX_MS = 130;   // 255 ticks
+
+// Nominal watchdog periods, indexed by the WDP3..0 prescaler setting.
+const uint8_t WDT_PERIODS = 8;
+extern const uint16_t WDT_PERIOD_MS[WDT_PERIODS];
+
+// One piece of a wait: a watchdog period, or a number of Timer1 ticks.
+struct WaitStep {
+  bool watchdog;
+  uint8_t setting;  // WDP value, or Timer1 ticks
+  uint16_t ms;      // Nominal length
+};
+
+// Take the next step off a wait with remaining milliseconds left. precise is
+// whether the whole wait fits in Timer1.
+WaitStep nextWaitStep(uint16_t &remaining, bool precise);
+
+/*
+ * Transmitter code generation, independent of the hardware. Decides which
+ * code goes out next and how long to wait before the one after it. step()
+ * runs the frame/gap state machine and says how long to wait before calling
+ * it again; the firmware does the waiting asleep, and the host simulations
+ * call the same methods against a simulated clock.
+ */
+struct Transmitter {
+  volatile bool triggered = false;
+  volatile int startupCodeCounter = 0;
+  TxState state = TxState::IDLE;
+
+  // STOPPED codes still to send. Held at STOPPED_CODE_COUNT while running, so
+  // only a tool that has sent a code follows it with a stop.
+  uint8_t stoppedCodeCounter = 0;
+
+  // The current gap follows a frame sent with the trigger held.
+  bool runningGap = false;
+
+  // ID sent as two symbols after each code, or NO_ID.
+  uint8_t id = NO_ID;
+  uint8_t idSymbolsSent = 0;
+
+  // Complement frames (codes.h): each STARTING or RUNNING code is followed by
+  // its complement, ahead of the ID symbols. Off by default; the receiver
+  // must be set to match. complementCode is the one still to send, or NONE.
+  bool complement = false;
+  Code complementCode = Code::NONE;
+
+  // How long each frame holds its code: BIT_ON_TIME, or less, down to
+  // BIT_ON_TIME_MIN, to cut each frame's airtime and so the chance of it
+  // colliding. Receivers checking pulse width must be set to match.
+  uint16_t frameTime = BIT_ON_TIME;
+
+  // Interval generator state, per device from seed(). Never 0.
+  uint32_t rngState = TX_DEFAULT_SEED;
+
+  // Slotted backoff after trigger changes, for tools switched on or off
+  // together (on one power strip, say), whose first frames would otherwise
+  // collide. Off by default.
+  bool backoff = false;
+  volatile uint8_t backoffFrames = 0;
+
+  void readTrigger();
+  // As readTrigger(), for a trigger decided elsewhere (the RMS trigger).
+  void setTrigger(bool on);
+  void triggerOn();
+  void triggerOff();
+
+  void codeOn(Code c);
+  void codeOff();
+
+  // Advance the state machine. Returns how many milliseconds to wait before
+  // the next call, or 0 to sleep until the trigger changes.
+  uint16_t step();
+
+  // True while waiting out a running gap with the trigger released. The wait
+  // may be cut short to send the STOPPED codes at once.
+  bool isStopPending() const {
+    return state == TxState::GAP && runningGap && !triggered;
+  }
+
+  // Code for the next frame. Consumes one of the startup codes if any remain.
+  Code nextCode();
+
+  // Random length of time between min and max milliseconds.
+  uint16_t nextInterval(uint16_t min, uint16_t max);
+
+  // Start the interval generator from entropy: what was saved in EEPROM,
+  // ADC noise, the ID. Leaves rngState one step on, to be saved for the
+  // next boot.
+  void seed(uint32_t entropy);
+
+  // Random wait before a frame that follows a trigger change, in whole slots.
+  uint16_t backoffDelay();
+};
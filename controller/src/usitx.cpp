@@ -0,0 +1,90 @@
+#include "usitx.h"
+
+#if defined(__AVR_ATtiny84__)
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// A UART byte is ten bits and the USI shifts eight, MSB first, so each byte
+// goes out in two loads of USIDR. DO shows bit 7 of USIDR as soon as it is
+// loaded, and each timer0 compare match shifts the next bit up. The first
+// load is the start bit and data bits 0-6, and overflows as bit 6 comes up;
+// the second starts with bit 6 again, so reloading changes nothing on the
+// line, then bit 7 and the stop bit padded with ones, and overflows as the
+// stop bit's period ends. DI's bits never reach DO.
+static const uint8_t FIRST_LOAD_SHIFTS = 7;
+static const uint8_t SECOND_LOAD_SHIFTS = 3;
+
+static volatile UsiTxSource source = 0;
+static volatile bool secondHalf = false;
+static volatile uint8_t reversedByte = 0;
+
+// Load the start bit and data bits 0-6 of the next byte from source, or
+// return false when there are no more.
+static bool loadFirstHalf() {
+  uint8_t b;
+  if (!source(b))
+    return false;
+  uint8_t reversed = 0;
+  for (uint8_t i = 0; i < 8; i++) {
+    reversed = (reversed << 1) | (b & 1);
+    b >>= 1;
+  }
+  reversedByte = reversed;
+  USIDR = reversed >> 1;
+  USISR = _BV(USIOIF) | (16 - FIRST_LOAD_SHIFTS);
+  secondHalf = true;
+  return true;
+}
+
+void usiTxBegin() {
+  USIDR = 0xFF;
+  USISR = _BV(USIOIF);
+  // Three-wire mode, shift register and counter clocked by timer0 compare
+  // match, interrupt on counter overflow.
+  USICR = _BV(USIOIE) | _BV(USIWM0) | _BV(USICS0);
+  DDRA |= _BV(DDA5);
+
+  TCCR0A = _BV(WGM01);    // CTC on OCR0A, stopped until there is a byte
+  TCCR0B = 0;
+  TIMSK0 &= ~_BV(OCIE0A);
+  OCR0A = (F_CPU / 8 + USI_TX_BAUD / 2) / USI_TX_BAUD - 1;
+}
+
+bool usiTxBusy() {
+  return source != 0;
+}
+
+void usiTxStart(UsiTxSource s) {
+  if (source != 0)
+    return;
+  source = s;
+  if (!loadFirstHalf()) {
+    source = 0;
+    return;
+  }
+
+  // The start bit is on DO now; the first compare ends its period.
+  TCNT0 = 0;
+  TCCR0B = _BV(CS01);     // CK/8
+}
+
+// USI counter overflow, twice per byte.
+ISR(USI_OVF_vect) {
+  if (secondHalf) {
+    USIDR = (uint8_t)(reversedByte << 6) | 0x3F;
+    USISR = _BV(USIOIF) | (16 - SECOND_LOAD_SHIFTS);
+    secondHalf = false;
+    return;
+  }
+
+  if (!loadFirstHalf()) {
+    // The stop bit has had its full period; leave the line idle.
+    TCCR0B = 0;
+    USIDR = 0xFF;
+    USISR = _BV(USIOIF);
+    source = 0;
+  }
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+/*
+ * Transmit-only UART on the ATtiny84's USI, output on DO (PA5), 8N1.
+ *
+ * The USI does the shifting and drives the pin, clocked in hardware by
+ * timer0's compare match: timer0 in CTC mode at CK/8 (19231 baud, 0.16%
+ * fast) shifts one bit per bit period with no interrupt. The USI counter's
+ * overflow interrupt reloads the data register, twice per byte. Timer0 is
+ * free for this because the receiver keeps time on Timer1 (rxclock.h).
+ * Nothing waits on the line: bytes are pulled from a source as they are
+ * needed, and timer0 is stopped whenever nothing is being sent, so the
+ * receiver still sleeps between its own wakeups.
+ *
+ * Receiver firmware only.
+ */
+
+#include <stdint.h>
+
+#if defined(__AVR_ATtiny84__)
+
+const uint32_t USI_TX_BAUD = 19200;
+
+// Next byte to send; false when there are no more.
+typedef bool (*UsiTxSource)(uint8_t &b);
+
+// Set up DO as an idle (high) output.
+void usiTxBegin();
+
+// Start sending bytes from source. Ignored while a transmission is running.
+void usiTxStart(UsiTxSource source);
+
+bool usiTxBusy();
+
+#endif